@@ -0,0 +1,69 @@
+/** \file alloccount.cpp
+ * \brief Optional counting of heap allocations
+ *
+ * \author Copyright (C) 2014 samplemaker
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1
+ * of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free
+ * Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA
+ *
+ * @{
+ */
+
+#include <new>
+#include <atomic>
+#include "alloccount.h"
+
+
+#ifdef WAV2PHH_COUNT_ALLOCS
+
+static std::atomic<size_t> numAllocs(0);
+static std::atomic<size_t> numBytes(0);
+
+/* all other forms of new (array, nothrow) end up here by default */
+void * operator new (size_t size)
+{
+  numAllocs.fetch_add(1, std::memory_order_relaxed);
+  numBytes.fetch_add(size, std::memory_order_relaxed);
+  void * ptr = malloc(size ? size : 1);
+  if (ptr == NULL){
+    throw std::bad_alloc();
+  }
+  return(ptr);
+}
+
+
+void operator delete (void * ptr) noexcept
+{
+  free(ptr);
+}
+
+
+void operator delete (void * ptr, size_t) noexcept
+{
+  free(ptr);
+}
+
+
+bool AllocCounter::isEnabled() { return(true); }
+size_t AllocCounter::count() { return(numAllocs.load(std::memory_order_relaxed)); }
+size_t AllocCounter::bytes() { return(numBytes.load(std::memory_order_relaxed)); }
+
+#else
+
+bool AllocCounter::isEnabled() { return(false); }
+size_t AllocCounter::count() { return(0); }
+size_t AllocCounter::bytes() { return(0); }
+
+#endif
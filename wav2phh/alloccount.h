@@ -0,0 +1,49 @@
+/** \file alloccount.h
+ * \brief Optional counting of heap allocations
+ *
+ * \author Copyright (C) 2014 samplemaker
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1
+ * of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free
+ * Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA
+ *
+ * @{
+ */
+
+#ifndef ALLOCCOUNT_H
+#define ALLOCCOUNT_H
+
+#include <cstdlib>
+
+
+/**
+ *  Counts the calls to the global operator new of the whole process. Only
+ *  active if the program is built with WAV2PHH_COUNT_ALLOCS (qmake
+ *  CONFIG+=alloccount), otherwise all counters stay zero and there is no
+ *  overhead at all. Used to check that the decode -> analyze path does not
+ *  touch the heap once it runs: snapshot count() after the first block and
+ *  compare with the value at the end.
+ **/
+class AllocCounter
+{
+
+  public:
+    static bool isEnabled();
+    /* number of allocations and allocated bytes since program start */
+    static size_t count();
+    static size_t bytes();
+};
+
+
+#endif
@@ -31,26 +31,98 @@
 
 #define d2i(x) ((x)<0?(int)((x)-0.5):(int)((x)+0.5))
 
+/* the pre-scan kernel is compiled with a function level target attribute and
+ * selected at runtime, as in pcmconvert.cpp */
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define ANALYZER_HAVE_X86_KERNELS 1
+#include <immintrin.h>
+#endif
+
+/* relative safety margin on the baseline bound of the pre-scan: covers the
+ * rounding of the estimators (the legacy sum drifts) */
+#define PRESCAN_MARGIN 1e-9
+
 //#define WRITEDATATOFILE 1
 
+/* smallest of x[0 .. num) and largest of x[1 .. num]. nan never replaces a
+ * number: it can neither pass the baseline gate nor trigger */
+static void rangeScalar(const double *x, size_t num, double *low, double *high)
+{
+  double lo = x[0];
+  double hi = x[1];
+  for (size_t n = 0; n < num; n ++){
+    if (x[n] < lo) lo = x[n];
+    if (x[n + 1] > hi) hi = x[n + 1];
+  }
+  *low = lo;
+  *high = hi;
+}
+
+
+#ifdef ANALYZER_HAVE_X86_KERNELS
+
+/* num is a multiple of 8. min/max return the second operand for nan */
+__attribute__((target("avx")))
+static void rangeAvx(const double *x, size_t num, double *low, double *high)
+{
+  __m256d lo0 = _mm256_set1_pd(x[0]);
+  __m256d lo1 = lo0;
+  __m256d hi0 = _mm256_set1_pd(x[1]);
+  __m256d hi1 = hi0;
+  for (size_t n = 0; n < num; n += 8){
+    lo0 = _mm256_min_pd(_mm256_loadu_pd(x + n), lo0);
+    lo1 = _mm256_min_pd(_mm256_loadu_pd(x + n + 4), lo1);
+    hi0 = _mm256_max_pd(_mm256_loadu_pd(x + n + 1), hi0);
+    hi1 = _mm256_max_pd(_mm256_loadu_pd(x + n + 5), hi1);
+  }
+  double l[4], h[4];
+  _mm256_storeu_pd(l, _mm256_min_pd(lo0, lo1));
+  _mm256_storeu_pd(h, _mm256_max_pd(hi0, hi1));
+  *low = fmin(fmin(l[0], l[1]), fmin(l[2], l[3]));
+  *high = fmax(fmax(h[0], h[1]), fmax(h[2], h[3]));
+}
+
+#endif
+
+
 /* we need the QObject to implement signals and slots */
 /* extraSamples (repeated) accessed in the future and the past */
 Analyzer::Analyzer(unsigned int numBinsHist, size_t extraSamples,size_t bufLen_, BaseLine * baseline, PulseEvent * pulseEvent, QObject *parent) : QObject(parent){
    mBaseline = baseline;
    mPulseEvent = pulseEvent;
    histResolution = numBinsHist;
-   mAvrg = new MovingAverage(mBaseline->numMAvrg);
+   mEstimator = BaselineEstimator::create(mBaseline->estimator, mBaseline->numMAvrg);
    /* k-1 intermediate interpolation points with windowsize2 = 15 extra points used for interpolation */
    lti = new Interpolator(mPulseEvent->iplnFactor, mPulseEvent->windowSize);
    histogram = new unsigned int [histResolution + 1]();
+   peakBuffer = NULL;
+   peakBufLen = 0;
+   eventList = NULL;
+   timeSlices = NULL;
+   setupScratch();
    /* redundant extra samples in past & future as per configuration of the ringbuffer
     * you have to ensure that numExtra is larger than numPast and future samples which
     * may occur due to a pulse event */
    bufLen = bufLen_;
    numExtra = extraSamples;
    lastPos = (bufLen-numExtra); /* start m = 0 */
+   setCountWindow(0, 0, Q_INT64_C(0x7fffffffffffffff));
    mBaseline->value = 0;
-   percentOld = 0;
+   snapshot = new HistogramSnapshot(histResolution);
+   setPublishInterval(HIST_PUBLISH_MSECS);
+   pulseSink = NULL;
+   floorValid = false;
+   floorFresh = false;
+   floorBound = 0.0;
+   rangeKernel = rangeScalar;
+#ifdef ANALYZER_HAVE_X86_KERNELS
+   __builtin_cpu_init();
+   if (__builtin_cpu_supports("avx")){
+     rangeKernel = rangeAvx;
+   }
+#endif
+   setEngine(ENGINE_DEFAULT);
+   stageTimer.start();
 #ifdef WRITEDATATOFILE
    fp = fopen ("analyzer.txt", "w");
 #endif
@@ -59,6 +131,10 @@ Analyzer::Analyzer(unsigned int numBinsHist, size_t extraSamples,size_t bufLen_,
 Analyzer::~Analyzer()
 {
  delete[] histogram;
+ delete snapshot;
+ delete[] peakBuffer;
+ delete mEstimator;
+ delete lti;
  #ifdef WRITEDATATOFILE 
    fclose(fp);
  #endif
@@ -71,7 +147,14 @@ void Analyzer::doHistogram(const double *dataStream, size_t len, float percent)
   //so in the next cycle we have to adjust our pointer to
 
   //TODO ensure that only packest with NUM_ELEMENTS_RINGBUF length are coming
+  const qint64 blockBegin = stageTimer.nsecsElapsed();
   size_t m = lastPos - (bufLen-numExtra);
+  /* the scan runs numPast samples into the future part of the block. the
+   * next block resumes at m >= numPast, so the samples in front of a pulse
+   * are always part of the block (a copy of it has nothing in front) */
+  const size_t scanEnd = bufLen - numExtra + scanOverlap();
+  /* samples before scalarEnd go through the exact per sample loop */
+  size_t scalarEnd = prescan ? m : bufLen;
 
   /*qWarning() << "lastpos " << lastPos;
   qWarning() << "len " << len;
@@ -81,7 +164,30 @@ void Analyzer::doHistogram(const double *dataStream, size_t len, float percent)
   getchar();*/
 
 
-  while (m < bufLen - numExtra){
+  while (m < scanEnd){
+
+       /* trigger pre-scan: if no sample of the next PRESCAN_BLOCK can rise
+        * above the trigger threshold over the lowest baseline possible, the
+        * per sample loop would only feed the baseline. do that in bulk */
+       if (m >= scalarEnd){
+         if (m + PRESCAN_BLOCK <= scanEnd){
+           if (quietBlock(dataStream + m)){
+             stats.baselineUpdates += mEstimator->addBlock(dataStream + m, PRESCAN_BLOCK,
+                                                           mBaseline->diffThresh, mBaseline->relThresh,
+                                                           &mBaseline->value);
+             stats.quietSamples += PRESCAN_BLOCK;
+             m += PRESCAN_BLOCK;
+             continue;
+           }
+           scalarEnd = m + PRESCAN_BLOCK;
+         }
+         else{
+           /* the tail of the block goes through the per sample loop, which
+            * may pull the baseline below the floor: take a new one */
+           scalarEnd = bufLen;
+           floorValid = false;
+         }
+       }
 
 #ifdef WRITEDATATOFILE
   fprintf(fp, "%f\n", dataStream[m]);
@@ -92,11 +198,11 @@ void Analyzer::doHistogram(const double *dataStream, size_t len, float percent)
        const double baseline = doBaseline(n0, n1);
        /* rising edge above trigger threshold is found */
        if ((n0 < n1) && ((n1 - baseline) > mPulseEvent->trigThresh)){
-         /* get the pulse start position plus some extra samples in the past */
-         const size_t start = m - mPulseEvent->numPast;
-         /* until peak is reached */
-         /* \todo: if the program segfaults here we could implement a checke against
-          * mPulseEvent->maxGlitchFilter  */
+         const size_t trigM = m;
+         bool truncated = false;
+         /* until peak is reached. a rise past the end of the block takes
+          * its last sample as the peak: a block may be a copy without
+          * anything behind it */
          while ((dataStream[m] < dataStream[m + 1])){
             m ++;
 #ifdef WRITEDATATOFILE
@@ -104,75 +210,18 @@ void Analyzer::doHistogram(const double *dataStream, size_t len, float percent)
 #endif
             if (m >= bufLen - 1){
               qWarning() << "input buffer to small due to search peak " << m;
-              //exit(1);
+              truncated = true;
+              break;
             }
          }
-         /* get stop position := start+2*(peakpos-start) */
-// \todo increase stop + 1
-         const size_t stop = m + m - start;
-         if (stop >= bufLen - 1){
-           qWarning() << "input buffer to small due to stop pos" << stop;
-           //exit(1);
-         }
-         const size_t numSrc = stop - start;
-         /* the pulse width without extra samples (past & future) is */
-         size_t pulseWidth = numSrc - mPulseEvent->numPast - mPulseEvent->numPast;
-
-         /* skip glitches */
-         if ((pulseWidth > mPulseEvent->minGlitchFilter) &&
-            (pulseWidth < mPulseEvent->maxGlitchFilter)) {
- //            m = stop;
-             unsigned int numDst = mPulseEvent->iplnFactor * (numSrc - 1) + 1;
-             double * peakBuffer = new double[numDst + 1];
-             lti->upsample(dataStream + start, peakBuffer, numSrc, 0);
-             //lti->upsample(dataStream + start, peakBuffer, numSrc, baseline);
-
-             /* get the peak maximum and minimum */
-             double searchMax = -1.0;
-             double searchMin = 1.0;
-             for (unsigned int n = 0; n < numDst; n ++){
-                if (searchMax < peakBuffer[n]) {
-                   searchMax = peakBuffer[n];
-                }
-                if (searchMin > peakBuffer[n]) {
-                   searchMin = peakBuffer[n];
-                }
-             }
-             /* cancel pile up: output max - min
-              * note: in noisy environments it might be better to trust in
-              * the baseline: search_max = search_max - baseline->act_value;
-              * 31.Jul.2014: Call Upsample with baseline as offset
-              */
-             searchMax = searchMax - searchMin;
-             /* count the peak value into a pulse height histogram */
-             /* if we compare linux vs. windows (mingw) histogram results
-              * they are somewhat different due to rounding issues. an extra
-              * float cast is spent to get the results identical */
-             const int index = (int)(d2i((float)(histResolution * searchMax)));
-             if ((index < (int)(histResolution)) && (index >= 0)){
-                histogram[index] ++;
-             }
-             //qWarning() << "height:" << searchMax << "baseLine:" << baseline;
-             //#define PRINT_VERBOSE 1
-             #ifdef PRINT_VERBOSE
-                qWarning() << "start:" << start << "stop:" << stop << "width:" << pulseWidth;
-                qWarning() << "height:" << searchMax << "baseLine:" << baseline;
-                qWarning() << "press <enter> to print data dump";
-                getchar();
-                qWarning() << "source:";
-                for (int a = start; a < stop; a++){
-                   qWarning() << "m:" << a << "\t raw:" << dataStream[a];
-                }
-                qWarning() << "interpolation:";
-                for (unsigned int a = 0; a < numDst;a++){
-                   qWarning() << "\t" << peakBuffer[a];
-                }
-                printf("press <enter> to continue ...\n\r");
-                getchar();
-             #endif
-             delete[] peakBuffer;
+         const qint64 trigPos = windowOrigin + (qint64)(trigM);
+         const bool accepted = countPulse(dataStream, trigM, m, trigPos, baseline, truncated);
+         /* the same pulse, other height settings */
+         for (int f = 0; f < followers.size(); f ++){
+           followers[f]->countPulse(dataStream, trigM, m, trigPos, baseline, truncated);
          }
-         else{
+         /* an accepted pulse continues at its peak */
+         if (!accepted){
            m ++;
          }
        }    
@@ -180,12 +229,189 @@ void Analyzer::doHistogram(const double *dataStream, size_t len, float percent)
          m ++;
        }
     }
+  for (int f = 0; f < followers.size(); f ++){
+    followers[f]->followBlock(bufLen - numExtra, percent);
+  }
   lastPos = m;
-    /* only update on each percent */
-    if (percent - percentOld > 1.0){
-        percentOld = percent;
-        emit histogramReady(histogram, histResolution, percent);
+  windowOrigin += (qint64)(bufLen - numExtra);
+  stats.blocksAnalyzed ++;
+  stats.samplesAnalyzed += bufLen - numExtra;
+    /* hand a copy to the gui now and then. the copy is cheap compared to a
+     * block of samples and nobody is waited for */
+    if (publishTimer.elapsed() >= publishInterval){
+        const qint64 publishBegin = stageTimer.nsecsElapsed();
+        publishTimer.start();
+        snapshot->publish(histogram, percent);
+        stats.nsPublish += stageTimer.nsecsElapsed() - publishBegin;
+        stats.nsAnalyze += stageTimer.nsecsElapsed() - blockBegin;
+        statsBoard.publish(stats);
     }
+    else{
+        stats.nsAnalyze += stageTimer.nsecsElapsed() - blockBegin;
+    }
+}
+
+
+/* the largest numPast of this analyzer and its followers, at most half the
+ * future part of the block */
+size_t Analyzer::scanOverlap(){
+  size_t past = mPulseEvent->numPast;
+  for (int f = 0; f < followers.size(); f ++){
+    past = qMax(past, followers[f]->mPulseEvent->numPast);
+  }
+  return((past < numExtra / 2) ? past : numExtra / 2);
+}
+
+
+/* block bookkeeping of a follower, its pulses come in through countPulse */
+void Analyzer::followBlock(size_t numSamples, float percent){
+  windowOrigin += (qint64)(numSamples);
+  stats.blocksAnalyzed ++;
+  stats.samplesAnalyzed += numSamples;
+  if (publishTimer.elapsed() >= publishInterval){
+    publishTimer.start();
+    snapshot->publish(histogram, percent);
+    statsBoard.publish(stats);
+  }
+}
+
+
+/* everything after the peak of a triggered pulse has been found: glitch
+ * filter, height and histogram. trigM is the index of the trigger sample,
+ * peak the index of the maximum. returns false if the pulse was rejected */
+bool Analyzer::countPulse(const double *dataStream, size_t trigM, size_t peak, qint64 trigPos,
+                          double baseline, bool truncated) {
+  const bool lazy = (mEngine == ENGINE_LAZY) ||
+                    ((mEngine == ENGINE_DEFAULT) && (mPulseEvent->peakMode == PEAK_LAZY));
+  stats.triggers ++;
+  /* get the pulse start position plus some extra samples in the past */
+  const size_t start = trigM - mPulseEvent->numPast;
+  /* get stop position := start+2*(peakpos-start) */
+// \todo increase stop + 1
+  const size_t stop = peak + peak - start;
+  if (stop >= bufLen - 1){
+    qWarning() << "input buffer to small due to stop pos" << stop;
+    truncated = true;
+    //exit(1);
+  }
+  /* the pulse width without extra samples (past & future) is */
+  size_t pulseWidth = stop - start - mPulseEvent->numPast - mPulseEvent->numPast;
+  /* a truncated pulse is read up to the end of the block only */
+  const size_t numSrc = qMin(stop, bufLen) - start;
+  if (truncated){
+    stats.truncated ++;
+  }
+
+  /* skip glitches */
+  if ((pulseWidth > mPulseEvent->minGlitchFilter) &&
+     (pulseWidth < mPulseEvent->maxGlitchFilter)) {
+//            m = stop;
+      stats.accepted ++;
+      const qint64 heightBegin = stageTimer.nsecsElapsed();
+      double searchMax = -1.0;
+      double searchMin = 1.0;
+      if (lazy){
+        /* discrete extrema first. the reconstruction runs through the
+         * samples, hence it can only be higher (lower) than these */
+        size_t posMax = 0;
+        size_t posMin = 0;
+        const double * pulse = dataStream + start;
+        for (size_t n = 1; n < numSrc; n ++){
+           if (pulse[n] > pulse[posMax]) posMax = n;
+           if (pulse[n] < pulse[posMin]) posMin = n;
+        }
+        /* pulses which are already out of range need no interpolation.
+         * the scan stays at the peak as for every processed pulse */
+        const double rawHeight = fmax(searchMax, pulse[posMax]) - fmin(searchMin, pulse[posMin]);
+        const int rawIndex = (int)(d2i((float)(histResolution * rawHeight)));
+        if (rawIndex >= (int)(histResolution)){
+          if (pulseSink != NULL){
+            const PulseRecord record = {trigPos, rawHeight, rawIndex};
+            pulseSink->append(record);
+          }
+          if (eventList != NULL){
+            eventList->append(trigPos, fmax(searchMax, pulse[posMax]), fmin(searchMin, pulse[posMin]),
+                              baseline, pulseWidth,
+                              EVENT_ACCEPTED | EVENT_DISCRETE | (truncated ? EVENT_TRUNCATED : 0));
+          }
+          stats.outOfRange ++;
+          stats.nsHeight += stageTimer.nsecsElapsed() - heightBegin;
+          return(true);
+        }
+        double valMax, valMin;
+        lti->refineExtrema(pulse, numSrc, posMax, posMin, 0, &valMax, &valMin);
+        searchMax = fmax(searchMax, valMax);
+        searchMin = fmin(searchMin, valMin);
+      }
+      else{
+        upsampledExtrema(dataStream + start, numSrc, &searchMax, &searchMin);
+      }
+      if (eventList != NULL){
+        eventList->append(trigPos, searchMax, searchMin, baseline, pulseWidth,
+                          EVENT_ACCEPTED | (truncated ? EVENT_TRUNCATED : 0));
+      }
+      /* cancel pile up: output max - min
+       * note: in noisy environments it might be better to trust in
+       * the baseline: search_max = search_max - baseline->act_value;
+       * 31.Jul.2014: Call Upsample with baseline as offset
+       */
+      searchMax = searchMax - searchMin;
+      stats.nsHeight += stageTimer.nsecsElapsed() - heightBegin;
+      /* count the peak value into a pulse height histogram */
+      /* if we compare linux vs. windows (mingw) histogram results
+       * they are somewhat different due to rounding issues. an extra
+       * float cast is spent to get the results identical */
+      const int index = (int)(d2i((float)(histResolution * searchMax)));
+      if (pulseSink != NULL){
+        const PulseRecord record = {trigPos, searchMax, index};
+        pulseSink->append(record);
+      }
+      if ((index >= (int)(histResolution)) || (index < 0)){
+         stats.outOfRange ++;
+      }
+      else if ((trigPos < countBegin) || (trigPos >= countEnd)){
+         stats.outsideWindow ++;
+      }
+      else{
+         histogram[index] ++;
+         if (timeSlices != NULL){
+           timeSlices->count(trigPos, index);
+         }
+         stats.counted ++;
+      }
+      //qWarning() << "height:" << searchMax << "baseLine:" << baseline;
+      //#define PRINT_VERBOSE 1
+      #ifdef PRINT_VERBOSE
+         qWarning() << "start:" << start << "stop:" << stop << "width:" << pulseWidth;
+         qWarning() << "height:" << searchMax << "baseLine:" << baseline;
+         qWarning() << "press <enter> to print data dump";
+         getchar();
+         qWarning() << "source:";
+         for (int a = start; a < stop; a++){
+            qWarning() << "m:" << a << "\t raw:" << dataStream[a];
+         }
+         qWarning() << "interpolation:";
+         for (unsigned int a = 0; !lazy && a < mPulseEvent->iplnFactor * (numSrc - 1) + 1;a++){
+            qWarning() << "\t" << peakBuffer[a];
+         }
+         printf("press <enter> to continue ...\n\r");
+         getchar();
+      #endif
+  }
+  else{
+    if (pulseWidth <= mPulseEvent->minGlitchFilter){
+      stats.glitchShort ++;
+    }
+    else{
+      stats.glitchLong ++;
+    }
+    if (eventList != NULL){
+      recordRejected(dataStream + start, numSrc, trigPos, baseline,
+                     pulseWidth, truncated, lazy);
+    }
+    return(false);
+  }
+  return(true);
 }
 
 
@@ -194,18 +420,250 @@ double Analyzer::doBaseline (double n0, double n1) {
   /* calculate moving average and extract baseline */
   const double delta = n0 - n1;
   if ((fabs(delta) < mBaseline->diffThresh) && (n0 < mBaseline->relThresh)){
-     mBaseline->value = mAvrg->doMovingAverage(n0);
+     mBaseline->value = mEstimator->add(n0);
+     stats.baselineUpdates ++;
   }
   return(mBaseline->value);
 }
 
+/* the longest pulse passing the glitch filter has maxGlitchFilter - 1 + 2 * numPast
+ * samples. allocate everything a pulse needs upfront, so that doHistogram
+ * runs without touching the heap. list mode interpolates rejected pulses up
+ * to EVENTLIST_IPLN_WIDTH as well */
+void Analyzer::setupScratch(void) {
+  size_t maxWidth = mPulseEvent->maxGlitchFilter;
+  if ((eventList != NULL) && (maxWidth < EVENTLIST_IPLN_WIDTH + 1)){
+    maxWidth = EVENTLIST_IPLN_WIDTH + 1;
+  }
+  const size_t maxSrc = maxWidth + 2 * mPulseEvent->numPast;
+  const size_t maxDst = mPulseEvent->iplnFactor * maxSrc + 1;
+  if (maxDst > peakBufLen){
+    delete[] peakBuffer;
+    peakBufLen = maxDst;
+    peakBuffer = new double[peakBufLen];
+  }
+  lti->reserve(maxSrc);
+}
+
+/* extrema of the upsampled pulse, merged into *searchMax and *searchMin */
+void Analyzer::upsampledExtrema(const double *pulse, size_t numSrc, double *searchMax, double *searchMin) {
+  const size_t numDst = mPulseEvent->iplnFactor * (numSrc - 1) + 1;
+  if (numDst + 1 > peakBufLen){
+    /* only if the glitch filter changed behind our back */
+    delete[] peakBuffer;
+    peakBufLen = numDst + 1;
+    peakBuffer = new double[peakBufLen];
+  }
+  if (mEngine == ENGINE_LEGACY){
+    lti->upsampleReference(pulse, peakBuffer, numSrc, 0);
+  }
+  else{
+    lti->upsample(pulse, peakBuffer, numSrc, 0);
+  }
+  //lti->upsample(pulse, peakBuffer, numSrc, baseline);
+
+  /* get the peak maximum and minimum */
+  double valMax = *searchMax;
+  double valMin = *searchMin;
+  for (size_t n = 0; n < numDst; n ++){
+     if (valMax < peakBuffer[n]) {
+        valMax = peakBuffer[n];
+     }
+     if (valMin > peakBuffer[n]) {
+        valMin = peakBuffer[n];
+     }
+  }
+  *searchMax = valMax;
+  *searchMin = valMin;
+}
+
+
+/* list mode: a rejected pulse gets its height as if it had been accepted,
+ * so that the events can be re-binned with other glitch limits. truncated
+ * and very long pulses keep the extrema of their samples */
+void Analyzer::recordRejected(const double *pulse, size_t numSrc, qint64 trigPos, double baseline,
+                              size_t pulseWidth, bool truncated, bool lazy) {
+  double searchMax = -1.0;
+  double searchMin = 1.0;
+  int flags = truncated ? EVENT_TRUNCATED : 0;
+  if (truncated || (pulseWidth > EVENTLIST_IPLN_WIDTH)){
+    for (size_t n = 0; n < numSrc; n ++){
+       searchMax = fmax(searchMax, pulse[n]);
+       searchMin = fmin(searchMin, pulse[n]);
+    }
+    flags |= EVENT_DISCRETE;
+  }
+  else if (lazy){
+    size_t posMax = 0;
+    size_t posMin = 0;
+    for (size_t n = 1; n < numSrc; n ++){
+       if (pulse[n] > pulse[posMax]) posMax = n;
+       if (pulse[n] < pulse[posMin]) posMin = n;
+    }
+    double valMax, valMin;
+    lti->refineExtrema(pulse, numSrc, posMax, posMin, 0, &valMax, &valMin);
+    searchMax = fmax(searchMax, valMax);
+    searchMin = fmin(searchMin, valMin);
+  }
+  else{
+    upsampledExtrema(pulse, numSrc, &searchMax, &searchMin);
+  }
+  eventList->append(trigPos, searchMax, searchMin, baseline, pulseWidth, flags);
+}
+
+
 void Analyzer::reset(void) {
-  delete (mAvrg);
-  mAvrg = new MovingAverage(mBaseline->numMAvrg);
-  delete (lti);
-  lti = new Interpolator(mPulseEvent->iplnFactor, mPulseEvent->windowSize);
+  /* the filters are reused and only their state is cleared. rebuild them only
+   * if the settings changed */
+  if ((mEstimator->size() != mBaseline->numMAvrg) ||
+      (mEstimator->kind() != mBaseline->estimator)){
+    delete (mEstimator);
+    mEstimator = BaselineEstimator::create(mBaseline->estimator, mBaseline->numMAvrg);
+  }
+  else{
+    mEstimator->reset();
+  }
+  if ((lti->factor() != mPulseEvent->iplnFactor) ||
+      (lti->kernelSize() != mPulseEvent->windowSize)){
+    delete (lti);
+    lti = new Interpolator(mPulseEvent->iplnFactor, mPulseEvent->windowSize);
+    lti->setSpecialized(mEngine != ENGINE_POLYPHASE);
+  }
+  setupScratch();
   memset (histogram, 0, sizeof(histogram[0])*(histResolution + 1) );
   mBaseline->value = 0;
-  percentOld = 0;
+  snapshot->publish(histogram, 0);
+  publishTimer.start();
+  floorValid = false;
+  stats.clear();
+  statsBoard.publish(stats);
   lastPos = (bufLen-numExtra); /* start m = 0 */
+  windowOrigin = (qint64)(streamOrigin) - (qint64)(numExtra);
+}
+
+
+/**
+ *  The baseline is either the held value or an estimate over gated samples.
+ *  An estimate never falls below the smallest sample in the estimator and
+ *  the samples added (BaselineEstimator::lowerBound). So the baseline over a
+ *  block is at least min(floorBound, smallest sample of the block), and if
+ *  even the largest sample of the block stays within trigThresh of that, no
+ *  sample triggers. The per sample loop would then just call doBaseline for
+ *  each sample, which addBlock() does identically: the histogram does not
+ *  change.
+ *
+ *  floorBound stays valid over quiet blocks (lowered by their samples) but
+ *  not across the per sample loop, which may feed the estimator with the
+ *  tail of a pulse. A stale bound is refreshed once before a block is
+ *  handed to the per sample loop.
+ **/
+bool Analyzer::quietBlock(const double *x){
+  double low, high;
+  rangeKernel(x, PRESCAN_BLOCK, &low, &high);
+  if (!floorValid){
+    refreshFloor();
+  }
+  for (;;){
+    double bound = fmin(floorBound, low);
+    bound -= PRESCAN_MARGIN * (1.0 + fabs(bound));
+    if (high - bound <= mPulseEvent->trigThresh){
+      floorBound = fmin(floorBound, low);
+      floorFresh = false;
+      return(true);
+    }
+    if (floorFresh){
+      break;
+    }
+    refreshFloor();
+  }
+  floorValid = false;
+  return(false);
+}
+
+
+void Analyzer::refreshFloor(void){
+  floorBound = fmin(mBaseline->value, mEstimator->lowerBound());
+  floorValid = true;
+  floorFresh = true;
+}
+
+
+/* ENGINE_DEFAULT follows the settings, the others override the peak mode and
+ * the choice of the interpolation kernel (see verifier.h). the legacy engine
+ * runs without the trigger pre-scan */
+void Analyzer::setPrescan(bool on){
+#ifdef WRITEDATATOFILE
+  Q_UNUSED(on);
+  prescan = false;
+#else
+  prescan = on;
+#endif
+  floorValid = false;
+}
+
+
+void Analyzer::setEngine(int engine){
+  mEngine = engine;
+  lti->setSpecialized(mEngine != ENGINE_POLYPHASE);
+#ifdef WRITEDATATOFILE
+  prescan = false;
+#else
+  prescan = (mEngine != ENGINE_LEGACY);
+#endif
+}
+
+
+const char * Analyzer::kernelName(){
+  return(lti->kernelName());
+}
+
+
+void Analyzer::setPulseSink(QVector<PulseRecord> *sink){
+  pulseSink = sink;
+}
+
+
+void Analyzer::setEventList(EventListWriter *list){
+  eventList = list;
+  setupScratch();
+}
+
+
+void Analyzer::setTimeSlices(TimeSlices *slices){
+  timeSlices = slices;
+}
+
+
+void Analyzer::addFollower(Analyzer *follower){
+  followers.append(follower);
+}
+
+
+PipelineStats Analyzer::statistics(){
+  return(statsBoard.read());
+}
+
+
+void Analyzer::publishStatistics(){
+  statsBoard.publish(stats);
+}
+
+
+void Analyzer::setPublishInterval(int msecs){
+  publishInterval = msecs;
+  publishTimer.start();
+}
+
+
+/* for segmented processing: streamOrigin is the absolute sample index of the
+ * first sample handed over by the decoder. pulses are analyzed as usual (the
+ * baseline keeps warming up) but only those triggered at an absolute sample
+ * index in [countBegin, countEnd) are counted. call it before the first block,
+ * it stays active across reset() */
+void Analyzer::setCountWindow(quint64 origin, quint64 begin, quint64 end){
+  streamOrigin = origin;
+  countBegin = (qint64)(begin);
+  countEnd = (qint64)(end);
+  /* the first block starts with numExtra presumed zeros */
+  windowOrigin = (qint64)(streamOrigin) - (qint64)(numExtra);
 }
@@ -24,9 +24,43 @@
 #ifndef ANALYZER_H
 #define ANALYZER_H
 
+#include "baselineestimator.h"
+#include "eventlist.h"
+#include "histsnapshot.h"
 #include "interpolate.h"
+#include "pipelinestats.h"
+#include "timeslices.h"
 #include <cstdlib>
 #include <QObject>
+#include <QElapsedTimer>
+#include <QVector>
+
+/* default setup (6 samples per pulse). shared by the settings dialog and the cli */
+#define B_DIFF_TRESH_DEFAULT 0.005
+#define B_REL_THRESH_DEFAULT 0.01
+#define B_NUM_AVRG_DEFAULT 20
+#define B_ESTIMATOR_DEFAULT BASELINE_LEGACY
+#define P_TRIG_THRESH_DEFAULT 0.015
+#define P_NUM_PAST_DEFAULT 5
+#define P_MIN_GLITCH_DEFAULT 1
+#define P_MAX_GLITCH_DEFAULT 10
+#define P_IPLN_FAC_DEFAULT IPLN_PRESET_FACTOR
+#define P_WINDOW_SIZE_DEFAULT IPLN_PRESET_WINDOW_6SPP
+#define P_PEAK_MODE_DEFAULT PEAK_UPSAMPLE
+#define G_SOFT_GAIN_DEFAULT 1.0
+#define G_NUM_BINS_HIST_DEFAULT 1024
+
+/* geometry of the audio ringbuffer: number of samples per block handed over
+ * to the analyzer and the number of samples repeated in the past & future */
+#define NUM_ELEMENTS_RINGBUF 4096
+#define NUM_FUTUREPAST_RINGBUF 1024
+
+/* the trigger pre-scan looks at blocks of this many samples (see doHistogram) */
+#define PRESCAN_BLOCK 64
+
+/* the analyzer publishes a histogram snapshot at most every ... ms. the gui
+ * polls for new snapshots at the same rate */
+#define HIST_PUBLISH_MSECS 40
 
 class BaseLine
 {
@@ -35,9 +69,33 @@ class BaseLine
     double diffThresh;
     double relThresh;
     int numMAvrg;
+    int estimator;      /* BASELINE_ESTIMATORS, window length numMAvrg */
   private:
 };
 
+/* how the pulse height is estimated from the samples of a pulse */
+enum PEAK_MODES {
+    PEAK_UPSAMPLE,  /* upsample the whole pulse and scan all points */
+    PEAK_LAZY       /* refine the discrete max / min by a local search only */
+};
+
+/* implementations of the pulse height estimation, see Analyzer::setEngine() */
+enum ANALYZER_ENGINES {
+    ENGINE_DEFAULT,     /* as configured by peakMode, specialized kernels for the presets */
+    ENGINE_LEGACY,      /* direct cardinal series of the whole pulse (the original code) */
+    ENGINE_POLYPHASE,   /* polyphase upsampling with the runtime parameter kernels */
+    ENGINE_FIXED,       /* polyphase upsampling with the specialized kernels if possible */
+    ENGINE_LAZY         /* local refinement of the discrete extrema (PEAK_LAZY) */
+};
+
+/* a pulse which passed the glitch filter, see Analyzer::setPulseSink() */
+struct PulseRecord
+{
+    qint64 trigPos;     /* absolute sample index of the trigger */
+    double height;      /* max - min of the reconstructed pulse */
+    int bin;            /* histogram bin, even if outside of the histogram */
+};
+
 class PulseEvent
 {
   public:
@@ -47,6 +105,7 @@ class PulseEvent
     size_t maxGlitchFilter;
     size_t iplnFactor;
     size_t windowSize;
+    int peakMode;
   private:
 };
 
@@ -60,12 +119,37 @@ public:
    explicit Analyzer(unsigned int histResolution, size_t extraSamples, size_t bufLen,  BaseLine * baseline, PulseEvent * pulseEvent, QObject *parent = 0);
    ~Analyzer();
    void reset(void);
+   void setCountWindow(quint64 streamOrigin, quint64 countBegin, quint64 countEnd);
+   /* live histogram: only to be read while no analysis is running */
    unsigned int * histogram;
    unsigned int histResolution;
-   float percentOld;
-
-signals:
-   void histogramReady(unsigned int * histogram, const unsigned int numBins, float percent);
+   /* consistent copies of the histogram for other threads, see doHistogram */
+   HistogramSnapshot * snapshot;
+   void setPublishInterval(int msecs);
+   void setEngine(int engine);
+   /* the interpolation kernel the current engine and settings run on */
+   const char * kernelName();
+   /* the trigger pre-scan is on by default for every engine but the legacy
+    * one. off: every sample goes through the per sample loop (verification) */
+   void setPrescan(bool on);
+   /* every pulse passing the glitch filter is appended to sink (NULL: off).
+    * for verification only: the vector grows on the heap */
+   void setPulseSink(QVector<PulseRecord> *sink);
+   /* list mode: every pulse, accepted or rejected, is appended to list
+    * (NULL: off). rejected pulses are interpolated as well, see eventlist.h */
+   void setEventList(EventListWriter *list);
+   /* every counted pulse also goes into its time slice (NULL: off). the
+    * slices are reset and finished by the owner */
+   void setTimeSlices(TimeSlices *slices);
+   /* the follower gets every pulse found by this analyzer and does the glitch
+    * filter, height and histogram with its own settings. it has to use the
+    * same baseline, trigger threshold and glitch filter (see sweeper.h) */
+   void addFollower(Analyzer *follower);
+   /* counters and timings as of the last snapshot, safe from any thread */
+   PipelineStats statistics();
+   /* the analyzer thread publishes along with the snapshots. call this once
+    * the analysis has finished to get the final numbers */
+   void publishStatistics();
 
 public slots:
    void doHistogram(const double *dataStream, size_t len, float percent);
@@ -76,10 +160,49 @@ private:
    size_t numExtra;
    size_t bufLen;
    signed long lastPos;
-   MovingAverage * mAvrg;
+   QElapsedTimer publishTimer;
+   qint64 publishInterval;
+   /* absolute sample index of dataStream[0] of the current block. only
+    * pulses triggered within [countBegin, countEnd) go into the histogram */
+   qint64 windowOrigin;
+   quint64 streamOrigin;
+   qint64 countBegin;
+   qint64 countEnd;
+   BaselineEstimator * mEstimator;
    BaseLine * mBaseline;
    PulseEvent * mPulseEvent;
    Interpolator * lti;
+   /* scratch memory for the upsampled pulse, sized for the longest pulse
+    * which passes the glitch filter. only grows, never freed while running */
+   double * peakBuffer;
+   size_t peakBufLen;
+   void setupScratch(void);
+   void upsampledExtrema(const double *pulse, size_t numSrc, double *searchMax, double *searchMin);
+   void recordRejected(const double *pulse, size_t numSrc, qint64 trigPos, double baseline,
+                       size_t pulseWidth, bool truncated, bool lazy);
+   bool countPulse(const double *dataStream, size_t trigM, size_t peak, qint64 trigPos,
+                   double baseline, bool truncated);
+   void followBlock(size_t numSamples, float percent);
+   size_t scanOverlap(void);
+   QVector<Analyzer *> followers;
+   /* trigger pre-scan: floorBound is a lower bound of the baseline while
+    * floorValid, floorFresh if it was just taken from the estimator */
+   bool prescan;
+   bool floorValid;
+   bool floorFresh;
+   double floorBound;
+   typedef void (*RangeKernel)(const double *x, size_t num, double *low, double *high);
+   RangeKernel rangeKernel;
+   bool quietBlock(const double *x);
+   void refreshFloor(void);
+   int mEngine;
+   QVector<PulseRecord> * pulseSink;
+   EventListWriter * eventList;
+   TimeSlices * timeSlices;
+   /* written by the analyzer thread only */
+   PipelineStats stats;
+   StatsBoard statsBoard;
+   QElapsedTimer stageTimer;
    FILE * fp;
 };
 
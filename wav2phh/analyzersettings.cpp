@@ -25,18 +25,6 @@
 #include "ui_analyzersettings.h"
 #include <QDebug>
 
-#define B_DIFF_TRESH_DEFAULT 0.005
-#define B_REL_THRESH_DEFAULT 0.01
-#define B_NUM_AVRG_DEFAULT 20
-#define P_TRIG_THRESH_DEFAULT 0.015
-#define P_NUM_PAST_DEFAULT 5
-#define P_MIN_GLITCH_DEFAULT 1
-#define P_MAX_GLITCH_DEFAULT 10
-#define P_IPLN_FAC_DEFAULT 7
-#define P_WINDOW_SIZE_DEFAULT 15
-#define G_SOFT_GAIN_DEFAULT 1.0
-#define G_NUM_BINS_HIST_DEFAULT 1024
-
 
 enum USE_CASES {
     LOAD,
@@ -60,12 +48,14 @@ AnalyzerSettings::AnalyzerSettings(QWidget *parent) :
     mBaseline->diffThresh = B_DIFF_TRESH_DEFAULT;
     mBaseline->relThresh = B_REL_THRESH_DEFAULT;
     mBaseline->numMAvrg = B_NUM_AVRG_DEFAULT;
+    mBaseline->estimator = B_ESTIMATOR_DEFAULT;
     mPulseEvent->trigThresh = P_TRIG_THRESH_DEFAULT;
     mPulseEvent->numPast = P_NUM_PAST_DEFAULT;
     mPulseEvent->minGlitchFilter = P_MIN_GLITCH_DEFAULT;
     mPulseEvent->maxGlitchFilter = P_MAX_GLITCH_DEFAULT;
     mPulseEvent->iplnFactor = P_IPLN_FAC_DEFAULT;
     mPulseEvent->windowSize = P_WINDOW_SIZE_DEFAULT;
+    mPulseEvent->peakMode = P_PEAK_MODE_DEFAULT;
     mSoftGain = G_SOFT_GAIN_DEFAULT;
     mNumBinsHist = G_NUM_BINS_HIST_DEFAULT;
 
@@ -82,6 +72,16 @@ AnalyzerSettings::AnalyzerSettings(QWidget *parent) :
     ui->GenSoftGainSpinBox->setValue(mSoftGain);
     ui->GenNumBinsHistSpinBox->setValue(mNumBinsHist);
 
+    ui->BLEstimatorComboBox->addItem(QString("Moving average (legacy)"), QVariant(BASELINE_LEGACY));
+    ui->BLEstimatorComboBox->addItem(QString("Sliding mean"), QVariant(BASELINE_MEAN));
+    ui->BLEstimatorComboBox->addItem(QString("Exponential average"), QVariant(BASELINE_EMA));
+    ui->BLEstimatorComboBox->addItem(QString("Sliding median"), QVariant(BASELINE_MEDIAN));
+    ui->BLEstimatorComboBox->setCurrentIndex(mBaseline->estimator);
+
+    ui->PPeakModeComboBox->addItem(QString("Upsample pulse"), QVariant(PEAK_UPSAMPLE));
+    ui->PPeakModeComboBox->addItem(QString("Lazy (refine extrema)"), QVariant(PEAK_LAZY));
+    ui->PPeakModeComboBox->setCurrentIndex(mPulseEvent->peakMode);
+
     ui->SpPcomboBox->addItem(QString("Load Config #"), QVariant(LOAD));
     ui->SpPcomboBox->addItem(QString("6 Samples/Pulse (default)"), QVariant(USE_6_SPP));
     ui->SpPcomboBox->addItem(QString("6 Samples/Pulse (high supression)"), QVariant(USE_6_SPP_HI_SUPR));
@@ -102,12 +102,14 @@ void AnalyzerSettings::on_buttonBox_accepted()
     mBaseline->diffThresh = ui->BLdiffThreshSpinBox->value(); /* differential threshold to supress volatile signals */
     mBaseline->relThresh = ui->BLabsThreshSpinBox->value();   /* absolute threshold */
     mBaseline->numMAvrg = ui->BLnumAvrgSpinBox->value();
+    mBaseline->estimator = ui->BLEstimatorComboBox->currentIndex(); /* filter behind the baseline gate */
     mPulseEvent->trigThresh = ui->PTrigThreshSpinBox->value();     /* trigger threshold */
     mPulseEvent->numPast = ui->PnumPastSpinBox->value();           /* samples taken from the past */
     mPulseEvent->minGlitchFilter = ui->PminGlitchSpinBox->value(); /* glitch filter: minimum samplepoints per pulse */
     mPulseEvent->maxGlitchFilter = ui->PmaxGlitchSpinBox->value(); /* glitch filter: max */
     mPulseEvent->iplnFactor = ui->PIntrplntSpinBox->value();       /* number - 1 of intermediate interpolation points */
     mPulseEvent->windowSize = ui->PNumKernelSpinBox->value();      /* half the window size / convolution length of low pass filter */
+    mPulseEvent->peakMode = ui->PPeakModeComboBox->currentIndex(); /* pulse height estimation */
     mSoftGain = ui->GenSoftGainSpinBox->value();              /* amplification factor */
     mNumBinsHist = ui->GenNumBinsHistSpinBox->value();        /* number of bins in the Histogram */
 
@@ -122,12 +124,14 @@ void AnalyzerSettings::on_buttonBox_rejected()
     ui->BLdiffThreshSpinBox->setValue(mBaseline->diffThresh);
     ui->BLabsThreshSpinBox->setValue(mBaseline->relThresh);
     ui->BLnumAvrgSpinBox->setValue(mBaseline->numMAvrg);
+    ui->BLEstimatorComboBox->setCurrentIndex(mBaseline->estimator);
     ui->PTrigThreshSpinBox->setValue(mPulseEvent->trigThresh);
     ui->PnumPastSpinBox->setValue(mPulseEvent->numPast);
     ui->PminGlitchSpinBox->setValue(mPulseEvent->minGlitchFilter);
     ui->PmaxGlitchSpinBox->setValue(mPulseEvent->maxGlitchFilter);
     ui->PIntrplntSpinBox->setValue(mPulseEvent->iplnFactor);
     ui->PNumKernelSpinBox->setValue(mPulseEvent->windowSize);
+    ui->PPeakModeComboBox->setCurrentIndex(mPulseEvent->peakMode);
     ui->GenSoftGainSpinBox->setValue(mSoftGain);
     ui->GenNumBinsHistSpinBox->setValue(mNumBinsHist);
 
@@ -188,8 +192,8 @@ void AnalyzerSettings::onSpPcomboBoxNewSettings(int index)
                 ui->PnumPastSpinBox->setValue(8);
                 ui->PminGlitchSpinBox->setValue(P_MIN_GLITCH_DEFAULT);
                 ui->PmaxGlitchSpinBox->setValue(25);
-                ui->PIntrplntSpinBox->setValue(7);
-                ui->PNumKernelSpinBox->setValue(22);
+                ui->PIntrplntSpinBox->setValue(IPLN_PRESET_FACTOR);
+                ui->PNumKernelSpinBox->setValue(IPLN_PRESET_WINDOW_10SPP);
                 ui->GenSoftGainSpinBox->setValue(G_SOFT_GAIN_DEFAULT);
                 ui->GenNumBinsHistSpinBox->setValue(G_NUM_BINS_HIST_DEFAULT);
         break;
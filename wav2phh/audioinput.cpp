@@ -22,16 +22,44 @@
  */
 
 #include <stdlib.h>
+#include <cstring>
 #include <cmath>
 #include <QDebug>
 #include <QtCore/qendian.h>
-#include <QMessageBox>
 #include <QVector>
 
 #include "audioinput.h"
+#include "contenthash.h"
+#include "pcmconvert.h"
+
+#ifdef Q_OS_UNIX
+#include <unistd.h>
+#include <sys/mman.h>
+#endif
 
 //#define WRITEDATATOFILE 1
 
+/* the pcm data is walked in chunks of this size, either directly in the
+ * memory mapped file or through a buffer if the file can not be mapped */
+#define READ_BLOCK_BYTES (1 << 20)
+/* number of samples converted to double in one go (stays in the l1 cache) */
+#define CONVERT_BLOCK_SAMPLES 2048
+
+#define NSECS_PER_SEC 1000000000ULL
+
+/* samples recorded in ns at rate. whole seconds first: ns * rate alone
+ * overflows after a day or so of a live run */
+static quint64 samplesIn(quint64 ns, int rate)
+{
+    return((ns / NSECS_PER_SEC) * rate + (ns % NSECS_PER_SEC) * rate / NSECS_PER_SEC);
+}
+
+/* the time at which sample n was recorded at rate, split the same way */
+static qint64 nsecsOf(quint64 n, int rate)
+{
+    return((qint64)((n / rate) * NSECS_PER_SEC + (n % rate) * NSECS_PER_SEC / rate));
+}
+
 /* Gets audio info, puts it into a ringbuffer and organizes the output (see below)
  * numElements: The number of values sent per incident to the output signal
  * numPast: Number of extra values (which are repeated) in the past and future
@@ -44,8 +72,45 @@ AudioInfo::AudioInfo(size_t numElements, size_t numPast, QObject *parent) :
     maxBufPos = numElements - 1;
     numExtra = numPast;
     // todo: dont use heap allocated variables in a thread constructor. create it rather in run()
-    ringBufData = new double[maxBufPos + 1]();
+    for (int c = 0; c < WAV_MAX_CHANNELS; c++){
+        ringBuf[c] = NULL;
+        chanQueue[c] = NULL;
+        chanConsumer[c] = NULL;
+    }
+    /* the others are created on demand by selectChannel() */
+    ringBuf[0] = new MirrorBuffer(maxBufPos + 1);
+    m_channel = 0;
+    m_numStreams = 1;
+    convBuf = new double[CONVERT_BLOCK_SAMPLES * WAV_MAX_CHANNELS];
+    /* only needed if the file can not be mapped, see decode() */
+    readBuf = NULL;
     softGain = 1.0;
+    m_abort = false;
+    m_map = NULL;
+    m_headerLength = 0;
+    m_dataLength = 0;
+    m_decodeRate = 0.0;
+    m_firstSample = 0;
+    m_numSamples = 0;
+    m_pipelined = false;
+    blockQueue = NULL;
+    consumer = NULL;
+    converter = NULL;
+    m_sidecarMode = SIDECAR_OFF;
+    m_usedSidecar = false;
+    sidecar = new SampleSidecar();
+    m_hashWanted = false;
+    m_hashValid = false;
+    m_hash = 0;
+    normalizer = NULL;
+    normBuf = new double[CONVERT_BLOCK_SAMPLES];
+    floatBuf = new float[CONVERT_BLOCK_SAMPLES];
+    window = new double[maxBufPos + 1];
+    m_source = SOURCE_FILE;
+    latency = new LatencyStats();
+    m_overruns = 0;
+    blockCapture = 0;
+    stageClock.start();
 }
 
 
@@ -56,6 +121,23 @@ AudioInfo::~AudioInfo()
     this->m_abort = true;
     mutex.unlock();
     wait();
+    unmapDataRegion();
+    for (int c = 0; c < WAV_MAX_CHANNELS; c++){
+        delete chanConsumer[c];
+        delete chanQueue[c];
+        delete ringBuf[c];
+    }
+    delete [] convBuf;
+    delete [] readBuf;
+    delete consumer;
+    delete blockQueue;
+    delete converter;
+    delete latency;
+    delete sidecar;
+    delete normalizer;
+    delete [] normBuf;
+    delete [] floatBuf;
+    delete [] window;
 }
 
 
@@ -67,13 +149,13 @@ struct chunk
 
 struct RIFFHeader
 {
-    chunk       descriptor;     // "RIFF"
+    chunk       descriptor;     // "RIFF" or "RIFX"
     char        type[4];        // "WAVE"
 };
 
-struct WAVEHeader
+/* the start of the "fmt " chunk body */
+struct WAVEFormat
 {
-    chunk       descriptor;
     quint16     audioFormat;
     quint16     numChannels;
     quint32     sampleRate;
@@ -82,16 +164,25 @@ struct WAVEHeader
     quint16     bitsPerSample;
 };
 
-struct DATAHeader
+/* wave format tags */
+#define WAVE_FORMAT_PCM 0x0001
+#define WAVE_FORMAT_IEEE_FLOAT 0x0003
+#define WAVE_FORMAT_EXTENSIBLE 0xFFFE
+/* extensible: the format tag is the first word of the sub format guid */
+#define WAVE_EXTENSIBLE_GUID_OFFSET 24
+
+
+/* all fields of a RIFF file are little endian, of a RIFX file big endian */
+static quint16 fileWord(quint16 value, bool bigEndian)
 {
-    chunk       descriptor;
-};
+    return bigEndian ? qFromBigEndian<quint16>(value) : qFromLittleEndian<quint16>(value);
+}
+
 
-struct CombinedHeader
+static quint32 fileLong(quint32 value, bool bigEndian)
 {
-    RIFFHeader  riff;
-    WAVEHeader  wave;
-};
+    return bigEndian ? qFromBigEndian<quint32>(value) : qFromLittleEndian<quint32>(value);
+}
 
 
 const QAudioFormat &AudioInfo::fileFormat()
@@ -106,74 +197,306 @@ qint64 AudioInfo::headerLength()
 }
 
 
+/* the pcm data behind the header as one contiguous span. NULL if the file
+ * could not be mapped (decode() falls back to buffered reads then) */
+const uchar * AudioInfo::dataRegion()
+{
+    return m_map;
+}
+
+
+quint64 AudioInfo::dataLength()
+{
+    return m_dataLength;
+}
+
+
+/* throughput of the last decode() run in MB/s */
+double AudioInfo::decodeRate()
+{
+    return m_decodeRate;
+}
+
+
+PipelineStats AudioInfo::statistics()
+{
+    return m_statsBoard.read();
+}
+
+
+quint64 AudioInfo::totalSamples()
+{
+    const int sampleBytes = m_fileFormat.channelCount() * m_fileFormat.sampleSize() / 8;
+    if (sampleBytes <= 0)
+        return 0;
+    return m_dataLength / sampleBytes;
+}
+
+
+/* restrict the next decode() to numSamples samples starting at firstSample.
+ * numSamples = 0 decodes up to the end of the file. open() resets the range */
+void AudioInfo::setRange(quint64 firstSample, quint64 numSamples)
+{
+    m_firstSample = firstSample;
+    m_numSamples = numSamples;
+}
+
+
+/* decode and analysis on two threads: decode() only converts and queues the
+ * blocks, audioDataReady (and therefore a DirectConnection-ed analyzer) runs
+ * on a consumer thread. decode() returns after the last block was processed */
+void AudioInfo::setPipelined(bool enable)
+{
+    m_pipelined = enable;
+    if (m_pipelined && (blockQueue == NULL)){
+        blockQueue = new BlockQueue(maxBufPos + 1);
+        consumer = new BlockConsumer(blockQueue);
+        connect(consumer,
+                SIGNAL( blockReady(const double *, size_t, float) ),
+                this,
+                SIGNAL( audioDataReady(const double *, size_t, float) ),
+                Qt::DirectConnection);
+    }
+}
+
+
+/* channel n of the file is decoded and emitted by audioDataReady (default 0,
+ * reset by open()). ALL_CHANNELS deinterleaves all channels in one pass over
+ * the file: channel c is emitted by channelOutput(c) on a thread of its own,
+ * so one analyzer per channel runs on its own core. call after open() */
+bool AudioInfo::selectChannel(int channel)
+{
+    const int numChannels = m_fileFormat.channelCount();
+    if ((channel != ALL_CHANNELS) && ((channel < 0) || (channel >= numChannels)))
+        return false;
+    m_channel = channel;
+    m_numStreams = (channel == ALL_CHANNELS) ? numChannels : 1;
+    for (int c = 0; c < m_numStreams; c++){
+        if (ringBuf[c] == NULL){
+            ringBuf[c] = new MirrorBuffer(maxBufPos + 1);
+        }
+    }
+    if (channel == ALL_CHANNELS){
+        for (int c = 0; c < numChannels; c++){
+            if (chanQueue[c] == NULL){
+                chanQueue[c] = new BlockQueue(maxBufPos + 1);
+                chanConsumer[c] = new BlockConsumer(chanQueue[c]);
+            }
+        }
+    }
+    return true;
+}
+
+
+/* ALL_CHANNELS: connect blockReady of channel c to its analyzer (Qt::DirectConnection) */
+BlockConsumer * AudioInfo::channelOutput(int channel)
+{
+    if ((channel < 0) || (channel >= WAV_MAX_CHANNELS))
+        return NULL;
+    return chanConsumer[channel];
+}
+
+
+/* fill level and stalls of the queue in the last pipelined decode() */
+BlockQueueStats AudioInfo::queueStats()
+{
+    if (blockQueue == NULL){
+        BlockQueueStats none;
+        memset(&none, 0, sizeof(none));
+        return none;
+    }
+    return blockQueue->stats();
+}
+
+
+/* SIDECAR_FILE writes <wav>.<channel>.f32 next to the wav file (or keeps the
+ * samples in memory if it cannot), SIDECAR_MEMORY keeps them until the next
+ * open(). only single channels of integers up to 24 bit or float */
+void AudioInfo::setSidecar(int mode)
+{
+    m_sidecarMode = mode;
+    if (mode == SIDECAR_OFF){
+        sidecar->clear();
+    }
+}
+
+
+/* the last decode() read the sidecar instead of the wav file */
+bool AudioInfo::usedSidecar()
+{
+    return m_usedSidecar;
+}
+
+
+void AudioInfo::setContentHash(bool enable)
+{
+    m_hashWanted = enable;
+}
+
+
+/* valid after decode() has returned */
+bool AudioInfo::contentHash(quint64 *hash)
+{
+    if (m_hashValid)
+        *hash = m_hash;
+    return m_hashValid;
+}
+
+
+/* what the sidecar of the selected channel of the open file has to match */
+SidecarHeader AudioInfo::sidecarHeader()
+{
+    const QFileInfo info(fileName.fileName());
+    SidecarHeader header;
+    memset(&header, 0, sizeof(header));
+    header.channel = m_channel;
+    header.numSamples = totalSamples();
+    header.sourceSize = (quint64)(info.size());
+    header.sourceModified = info.lastModified().toMSecsSinceEpoch();
+    header.dataOffset = m_headerLength;
+    header.dataLength = m_dataLength;
+    header.sampleBits = m_fileFormat.sampleSize();
+    return header;
+}
+
+
 void AudioInfo::resetSoftGain(double gain){
     softGain = gain;
 }
 
+/**
+ *  Walks the chunks of the file up to "data". Unknown chunks in between
+ *  (LIST, fact, ...) are skipped. Accepted are 8, 16, 24 and 32 bit integer
+ *  and 32 bit float samples with 1 .. WAV_MAX_CHANNELS channels, either as
+ *  RIFF (little endian) or RIFX (big endian).
+ **/
 bool AudioInfo::readHeader()
 {
     fileName.seek(0);
-    CombinedHeader header;
-    bool result = fileName.read(reinterpret_cast<char *>(&header), sizeof(CombinedHeader)) == sizeof(CombinedHeader);
-
-    if (result) {
-        if ((memcmp(&header.riff.descriptor.id, "RIFF", 4) == 0
-            || memcmp(&header.riff.descriptor.id, "RIFX", 4) == 0)
-            && memcmp(&header.riff.type, "WAVE", 4) == 0
-            && memcmp(&header.wave.descriptor.id, "fmt ", 4) == 0
-            && (header.wave.audioFormat == 1 || header.wave.audioFormat == 0)) {
-
-            // Read off remaining header information
-            DATAHeader dataHeader;
-
-            if (qFromLittleEndian<quint32>(header.wave.descriptor.size) > sizeof(WAVEHeader)) {
-                // Extended data available
-                quint16 extraFormatBytes;
-                if (fileName.peek((char*)&extraFormatBytes, sizeof(quint16)) != sizeof(quint16))
-                    return false;
-                const qint64 throwAwayBytes = sizeof(quint16) + qFromLittleEndian<quint16>(extraFormatBytes);
-                if (fileName.read(throwAwayBytes).size() != throwAwayBytes)
-                    return false;
-            }
+    m_headerLength = 0;
+    m_dataLength = 0;
+    RIFFHeader riff;
+    if (fileName.read(reinterpret_cast<char *>(&riff), sizeof(RIFFHeader)) != sizeof(RIFFHeader))
+        return false;
+    bool bigEndian;
+    if (memcmp(&riff.descriptor.id, "RIFF", 4) == 0)
+        bigEndian = false;
+    else if (memcmp(&riff.descriptor.id, "RIFX", 4) == 0)
+        bigEndian = true;
+    else
+        return false;
+    if (memcmp(&riff.type, "WAVE", 4) != 0)
+        return false;
 
-            if (fileName.read((char*)&dataHeader, sizeof(DATAHeader)) != sizeof(DATAHeader))
+    bool haveFormat = false;
+    int formatTag = 0;
+    int bps = 0;
+    int numChannels = 0;
+    for (;;){
+        chunk header;
+        if (fileName.read(reinterpret_cast<char *>(&header), sizeof(chunk)) != sizeof(chunk))
+            return false;
+        const quint32 size = fileLong(header.size, bigEndian);
+        if (memcmp(&header.id, "fmt ", 4) == 0){
+            const QByteArray body = fileName.read(size);
+            if ((size < sizeof(WAVEFormat)) || (body.size() != (int)(size)))
+                return false;
+            WAVEFormat format;
+            memcpy(&format, body.constData(), sizeof(WAVEFormat));
+            formatTag = fileWord(format.audioFormat, bigEndian);
+            if ((formatTag == WAVE_FORMAT_EXTENSIBLE) && (size >= WAVE_EXTENSIBLE_GUID_OFFSET + 2)){
+                quint16 subFormat;
+                memcpy(&subFormat, body.constData() + WAVE_EXTENSIBLE_GUID_OFFSET, 2);
+                formatTag = fileWord(subFormat, bigEndian);
+            }
+            bps = fileWord(format.bitsPerSample, bigEndian);
+            numChannels = fileWord(format.numChannels, bigEndian);
+            m_fileFormat.setSampleRate(fileLong(format.sampleRate, bigEndian));
+            haveFormat = true;
+        }
+        else if (memcmp(&header.id, "data", 4) == 0){
+            m_headerLength = fileName.pos();
+            /* streamed files have no valid length. so do files with a chunk behind the data */
+            const quint64 remaining = fileName.size() - m_headerLength;
+            m_dataLength = ((size == 0) || (size > remaining)) ? remaining : size;
+            break;
+        }
+        else{
+            /* chunks are padded to an even length */
+            if (!fileName.seek(fileName.pos() + size + (size & 1)))
                 return false;
-
-            // Establish format
-            if (memcmp(&header.riff.descriptor.id, "RIFF", 4) == 0)
-                m_fileFormat.setByteOrder(QAudioFormat::LittleEndian);
-            else
-                m_fileFormat.setByteOrder(QAudioFormat::BigEndian);
-
-            int bps = qFromLittleEndian<quint16>(header.wave.bitsPerSample);
-            m_fileFormat.setChannelCount(qFromLittleEndian<quint16>(header.wave.numChannels));
-            m_fileFormat.setCodec("audio/pcm");
-            m_fileFormat.setSampleRate(qFromLittleEndian<quint32>(header.wave.sampleRate));
-            m_fileFormat.setSampleSize(qFromLittleEndian<quint16>(header.wave.bitsPerSample));
-            m_fileFormat.setSampleType(bps == 8 ? QAudioFormat::UnSignedInt : QAudioFormat::SignedInt);
-        } else {
-            result = false;
         }
     }
-    m_headerLength = fileName.pos();
-    /* stop if we dont have exactly what we want */
+    if (!haveFormat)
+        return false;
+
+    // Establish format
+    m_fileFormat.setByteOrder(bigEndian ? QAudioFormat::BigEndian : QAudioFormat::LittleEndian);
+    m_fileFormat.setChannelCount(numChannels);
+    m_fileFormat.setCodec("audio/pcm");
+    m_fileFormat.setSampleSize(bps);
+    if (formatTag == WAVE_FORMAT_IEEE_FLOAT)
+        m_fileFormat.setSampleType(QAudioFormat::Float);
+    else
+        m_fileFormat.setSampleType(bps == 8 ? QAudioFormat::UnSignedInt : QAudioFormat::SignedInt);
+
     qWarning() << "Wav Header:";
     qWarning() << "sampleSize" << m_fileFormat.sampleSize();
     qWarning() << "sampleType" << m_fileFormat.sampleType();
+    qWarning() << "byteOrder" << m_fileFormat.byteOrder();
     qWarning() << "channels" << m_fileFormat.channelCount();
     qWarning() << "samplerate" << m_fileFormat.sampleRate();
-    if (!( (m_fileFormat.sampleSize() == 16) &&
-           (m_fileFormat.sampleType() == QAudioFormat::SignedInt) &&
-           (m_fileFormat.channelCount() == 1 ))) {
-        result = false;
-    }
-    return result;
+    /* stop if we dont have what we can decode */
+    if ((formatTag != WAVE_FORMAT_PCM) && (formatTag != WAVE_FORMAT_IEEE_FLOAT))
+        return false;
+    if ((numChannels < 1) || (numChannels > WAV_MAX_CHANNELS))
+        return false;
+    PcmConverter probe(bps, formatTag == WAVE_FORMAT_IEEE_FLOAT, bigEndian, numChannels);
+    return probe.isSupported();
 }
 
 bool AudioInfo::open(const QString &name)
 {
+    unmapDataRegion();
+    sidecar->clear();
+    setRange(0, 0);
+    m_channel = 0;
+    m_numStreams = 1;
+    m_source = SOURCE_FILE;
     fileName.setFileName(name);
-    return fileName.open(QIODevice::ReadOnly) && readHeader();
+    if (!(fileName.open(QIODevice::ReadOnly) && readHeader()))
+        return false;
+    mapDataRegion();
+    return true;
+}
+
+
+void AudioInfo::mapDataRegion()
+{
+    const qint64 len = dataLength();
+    if (len <= 0)
+        return;
+    m_map = fileName.map(m_headerLength, len);
+    if (m_map == NULL){
+        qWarning() << "cannot map wav file, using buffered reads:" << fileName.errorString();
+        return;
+    }
+#ifdef Q_OS_UNIX
+    /* the data is read exactly once from the front to the back. let the kernel
+     * read ahead aggressively and drop the pages behind us */
+    const quintptr pageSize = sysconf(_SC_PAGESIZE);
+    const quintptr start = (quintptr)(m_map) & ~(pageSize - 1);
+    posix_madvise((void *)(start), len + ((quintptr)(m_map) - start), POSIX_MADV_SEQUENTIAL);
+#endif
+}
+
+
+void AudioInfo::unmapDataRegion()
+{
+    if (m_map != NULL){
+        fileName.unmap(m_map);
+        m_map = NULL;
+    }
 }
 
 
@@ -188,11 +511,185 @@ void AudioInfo::stopProcess(){
 void AudioInfo::run(){
     m_abort = false;
     qWarning() << "Starting decode-thread ...";
-    decode();
+    if (m_source == SOURCE_FILE){
+        decode();
+    }
+    else{
+        runLive();
+    }
     emit decodeFinished();
 }
 
 
+bool AudioInfo::openDevice(const QAudioDeviceInfo &device, int sampleRate)
+{
+    unmapDataRegion();
+    if (fileName.isOpen()){
+        fileName.close();
+    }
+    setRange(0, 0);
+    m_channel = 0;
+    m_numStreams = 1;
+    m_fileFormat.setSampleRate(sampleRate);
+    m_fileFormat.setChannelCount(1);
+    m_fileFormat.setSampleSize(16);
+    m_fileFormat.setCodec("audio/pcm");
+    m_fileFormat.setByteOrder(QAudioFormat::LittleEndian);
+    m_fileFormat.setSampleType(QAudioFormat::SignedInt);
+    m_device = device;
+    m_source = SOURCE_DEVICE;
+    if (!device.isFormatSupported(m_fileFormat)){
+        qWarning() << "device" << device.deviceName() << "does not support 16bit mono at" << sampleRate << "Hz";
+        return false;
+    }
+    return true;
+}
+
+
+/* the file has to be open() already */
+void AudioInfo::setReplay(bool enable)
+{
+    if (m_source != SOURCE_DEVICE){
+        m_source = enable ? SOURCE_REPLAY : SOURCE_FILE;
+    }
+}
+
+
+const LatencyStats &AudioInfo::latencyStats()
+{
+    return *latency;
+}
+
+
+/* number of times the capture buffer ran full since the live run started */
+quint64 AudioInfo::overruns()
+{
+    return m_overruns;
+}
+
+
+/**
+ *  Live mode: the samples arrive in small portions in real time and are fed
+ *  into the same ringbuffer -> analyzer path as in decode(). Runs until
+ *  stopProcess() (or the end of a replayed file). The latency of a block is
+ *  measured from the capture of its oldest new sample until the analyzer has
+ *  returned, hence it is only available without the pipelined mode.
+ **/
+void AudioInfo::runLive()
+{
+    if (m_pipelined){
+        qWarning() << "live mode: latency is not measured in the pipelined mode";
+    }
+    latency->reset();
+    m_overruns = 0;
+    beginStream(m_source == SOURCE_REPLAY ? totalSamples() : 0);
+    liveClock.start();
+    if (m_source == SOURCE_REPLAY){
+        runReplay();
+    }
+    else{
+        runDevice();
+    }
+    endStream();
+    const double secs = (double)(liveClock.nsecsElapsed()) * 1e-9;
+    qWarning() << "live run:" << accuCounts << "samples in" << secs << "s," << m_overruns << "overruns";
+}
+
+
+/* replays the wav file paced by its sample rate. emulates a capture device
+ * with a buffer of LIVE_BUFFER_MSECS: if we fall behind by more than that,
+ * the oldest samples are lost and an overrun is counted */
+void AudioInfo::runReplay()
+{
+    const int frameBytes = m_fileFormat.bytesPerFrame();
+    const int rate = m_fileFormat.sampleRate();
+    const quint64 total = totalSamples();
+    const quint64 bufSamples = (quint64)(rate) * LIVE_BUFFER_MSECS / 1000;
+    const size_t maxChunk = READ_BLOCK_BYTES / frameBytes;
+    if ((m_map == NULL) && (readBuf == NULL)){
+        readBuf = new char[READ_BLOCK_BYTES];
+    }
+    quint64 consumed = 0;
+    while ((consumed < total) && !m_abort){
+        /* samples "recorded" until now */
+        quint64 avail = samplesIn((quint64)(liveClock.nsecsElapsed()), rate);
+        if (avail > total){
+            avail = total;
+        }
+        if (avail - consumed > bufSamples){
+            m_overruns ++;
+            consumed = avail - bufSamples;
+        }
+        size_t num = avail - consumed;
+        if (num == 0){
+            QThread::msleep(LIVE_POLL_MSECS);
+            continue;
+        }
+        if (num > maxChunk){
+            num = maxChunk;
+        }
+        const uchar * pcm;
+        if (m_map != NULL){
+            pcm = m_map + consumed * frameBytes;
+        }
+        else{
+            fileName.seek(m_headerLength + consumed * frameBytes);
+            if (fileName.read(readBuf, num * frameBytes) != (qint64)(num * frameBytes))
+                break;
+            pcm = (const uchar *)(readBuf);
+        }
+        /* sample n was recorded at n / rate on the live clock. from the index,
+         * a truncated period would drift away from the clock above */
+        pushPcm(pcm, num, nsecsOf(consumed, rate), rate);
+        consumed += num;
+    }
+}
+
+
+void AudioInfo::runDevice()
+{
+    const int channelBytes = m_fileFormat.sampleSize() / 8;
+    const int rate = m_fileFormat.sampleRate();
+    /* created in this thread: it belongs to the thread which reads from it */
+    QAudioInput input(m_device, m_fileFormat);
+    input.setBufferSize(rate * channelBytes * LIVE_BUFFER_MSECS / 1000);
+    QIODevice * io = input.start();
+    if (io == NULL){
+        qWarning() << "cannot start the capture device" << m_device.deviceName() << input.error();
+        return;
+    }
+    qWarning() << "capturing from" << m_device.deviceName() << "buffer" << input.bufferSize() << "bytes";
+    if (readBuf == NULL){
+        readBuf = new char[READ_BLOCK_BYTES];
+    }
+    while (!m_abort){
+        QCoreApplication::processEvents();
+        const qint64 ready = input.bytesReady();
+        if (ready <= 0){
+            QThread::msleep(LIVE_POLL_MSECS);
+            continue;
+        }
+        /* the device buffer was full: samples may have been dropped */
+        if (ready >= input.bufferSize()){
+            m_overruns ++;
+        }
+        /* whole frames only, as in decode() */
+        const qint64 most = ready < READ_BLOCK_BYTES ? ready : READ_BLOCK_BYTES;
+        const qint64 want = most - most % channelBytes;
+        const qint64 got = io->read(readBuf, want);
+        if (got <= 0){
+            QThread::msleep(LIVE_POLL_MSECS);
+            continue;
+        }
+        const size_t num = got / channelBytes;
+        /* the newest sample was recorded just now, the rest before */
+        const qint64 captureNs = liveClock.nsecsElapsed() - nsecsOf(num, rate);
+        pushPcm((const uchar *)(readBuf), num, captureNs, rate);
+    }
+    input.stop();
+}
+
+
 /**
  *
  * write into the ringbuffer until numElements - numExtra elements are written.
@@ -209,102 +706,351 @@ void AudioInfo::run(){
  **/
 void AudioInfo::decode()
 {
+    /* one frame holds one sample of every channel */
+    const int frameBytes = m_fileFormat.bytesPerFrame();
+
+    const quint64 fileSamples = this->totalSamples();
+    const quint64 firstSample = m_firstSample < fileSamples ? m_firstSample : fileSamples;
+    quint64 totalSamples = fileSamples - firstSample;
+    if ((m_numSamples > 0) && (m_numSamples < totalSamples)){
+        totalSamples = m_numSamples;
+    }
+    qWarning() << "have total samples:" << totalSamples << "from" << firstSample;
+    m_hashValid = false;
+
+    /* float32 holds integers of up to 24 bit exactly, see sidecar.h */
+    m_usedSidecar = false;
+    const bool sidecarUsable = (m_sidecarMode != SIDECAR_OFF) && (m_channel != ALL_CHANNELS) &&
+                               ((m_fileFormat.sampleType() == QAudioFormat::Float) ||
+                                (m_fileFormat.sampleSize() <= 24));
+    if (sidecarUsable){
+        const QString sidecarName = SampleSidecar::fileNameFor(fileName.fileName(), m_channel);
+        if (sidecar->isValid() && (sidecar->header().channel != m_channel)){
+            sidecar->clear();
+        }
+        if (!sidecar->isValid() && (m_sidecarMode == SIDECAR_FILE)){
+            sidecar->open(sidecarName, sidecarHeader());
+        }
+        if (sidecar->isValid()){
+            decodeSidecar(firstSample, totalSamples);
+            return;
+        }
+        /* only a run over the whole channel leaves a sidecar behind */
+        if (totalSamples == fileSamples){
+            const SidecarHeader header = sidecarHeader();
+            if (!((m_sidecarMode == SIDECAR_FILE) && sidecar->begin(sidecarName, header))){
+                sidecar->begin(QString(), header);
+            }
+        }
+    }
+    const quint64 firstByte = firstSample * frameBytes;
+
+    /* without a mapping the file is read in large blocks into this buffer */
+    if (m_map == NULL){
+        if (readBuf == NULL){
+            readBuf = new char[READ_BLOCK_BYTES];
+        }
+        fileName.seek(m_headerLength + firstByte);
+    }
+
+    const quint64 totalBytes = totalSamples * frameBytes;
+    quint64 bytesDone = 0;
+
+    QElapsedTimer timer;
+    timer.start();
+
+    /* whole frames per chunk: 3 and 6 byte frames do not divide READ_BLOCK_BYTES */
+    const size_t chunkBytes = (READ_BLOCK_BYTES / frameBytes) * frameBytes;
+    /* the content hash comes with the one read of the whole data region */
+    const bool hashing = m_hashWanted && (firstByte == 0) && (totalSamples == fileSamples);
+    ContentHash hash;
+    beginStream(totalSamples);
+    while(bytesDone < totalBytes){
+        const quint64 bytesLeft = totalBytes - bytesDone;
+        const size_t numBytes = bytesLeft < chunkBytes ? bytesLeft : chunkBytes;
+        const char *ptr;
+        if (m_map != NULL){
+            ptr = (const char *)(m_map) + firstByte + bytesDone;
+        }
+        else{
+            const qint64 readBegin = stageClock.nsecsElapsed();
+            if (fileName.read(readBuf, numBytes) != (qint64)(numBytes))
+                break;
+            m_stats.nsRead += stageClock.nsecsElapsed() - readBegin;
+            ptr = readBuf;
+        }
+        bytesDone += numBytes;
+        if (hashing)
+            hash.add((const uchar *)(ptr), numBytes);
+        pushPcm((const uchar *)(ptr), numBytes / frameBytes);
+        /* stop thread if requested */
+        if(this->m_abort) break;
+    }
+    endStream();
+    if (hashing && !m_abort && (bytesDone == totalBytes)){
+        /* a partial frame at the end of the data region */
+        const size_t rest = (size_t)(m_dataLength - totalBytes);
+        if ((m_map != NULL) || (fileName.read(readBuf, rest) == (qint64)(rest))){
+            hash.add((m_map != NULL) ? m_map + totalBytes : (const uchar *)(readBuf), rest);
+            m_hash = hash.result();
+            m_hashValid = true;
+        }
+    }
+    if (sidecar->isRecording()){
+        if (!m_abort && sidecar->commit()){
+            qWarning() << "sidecar of channel" << m_channel << "ready";
+        }
+        else{
+            sidecar->cancel();
+        }
+    }
+
+    const qint64 nsecs = timer.nsecsElapsed();
+    m_stats.nsDecode += nsecs;
+    m_statsBoard.publish(m_stats);
+    m_decodeRate = (nsecs > 0) ? (double)(bytesDone) * 1e3 / (double)(nsecs) : 0.0;
+    qWarning() << "decoded" << bytesDone << "bytes," << m_decodeRate << "MB/s"
+               << (m_map != NULL ? "(mapped)" : "(buffered)");
+}
+
+
+/* resets the ringbuffer for a new stream of numSamples samples (only used
+ * for the progress, 0 if unknown) */
+void AudioInfo::beginStream(quint64 numSamples)
+{
+    //these have to be reset not only during object initilizazion but also
+    //each time decode is called (e.g. the button is pressed twice)
+    headPos = 0;
+    numRecords = numExtra; //presume zeros for initialization
+    popPos = 1;
+    accuCounts = 0;
+    streamSamples = numSamples;
+    m_stats.clear();
+    m_statsBoard.publish(m_stats);
+    for (int c = 0; c < m_numStreams; c++){
+        ringBuf[c]->clear();
+    }
+
+    qRegisterMetaType<size_t>("size_t");
+
+    delete converter;
+    converter = new PcmConverter(m_fileFormat.sampleSize(),
+                                 m_fileFormat.sampleType() == QAudioFormat::Float,
+                                 m_fileFormat.byteOrder() == QAudioFormat::BigEndian,
+                                 m_fileFormat.channelCount());
+    converter->setGain(softGain);
+    qWarning() << "pcm conversion kernel:" << converter->kernelName();
+    delete normalizer;
+    normalizer = NULL;
+    if (sidecar->isRecording()){
+        normalizer = new PcmConverter(m_fileFormat.sampleSize(),
+                                      m_fileFormat.sampleType() == QAudioFormat::Float,
+                                      m_fileFormat.byteOrder() == QAudioFormat::BigEndian,
+                                      m_fileFormat.channelCount());
+        normalizer->setNormalized();
+    }
 
 #ifdef WRITEDATATOFILE
-    FILE * fp;
     fp = fopen ("audio.txt", "w");
 #endif
+    if (m_channel == ALL_CHANNELS){
+        for (int c = 0; c < m_numStreams; c++){
+            chanQueue[c]->clear();
+            chanConsumer[c]->start();
+        }
+    }
+    else if (m_pipelined){
+        blockQueue->clear();
+        consumer->start();
+    }
+}
 
-    //these are locals which have to be reset not only during object initilizazion but also
-    //each time decode is called (e.g. the button is pressed twice)
-    size_t headPos = 0;
-    size_t numRecords = numExtra; //presume zeros for initialization
-    size_t popPos = 1;
 
-    qRegisterMetaType<size_t>("size_t");
+void AudioInfo::endStream()
+{
+    m_statsBoard.publish(m_stats);
+    if (m_channel == ALL_CHANNELS){
+        for (int c = 0; c < m_numStreams; c++){
+            chanQueue[c]->close();
+        }
+        for (int c = 0; c < m_numStreams; c++){
+            chanConsumer[c]->wait();
+        }
+    }
+    else if (m_pipelined){
+        blockQueue->close();
+        consumer->wait();
+    }
+#ifdef WRITEDATATOFILE
+ fclose(fp);
+#endif
+}
 
-    const int channelBytes = m_fileFormat.sampleSize() / 8;
-    const int sampleBytes = m_fileFormat.channelCount() * channelBytes;
-
-    //size_t totalLen = fileName.size() - m_headerLength;
-    const size_t totalSamples = (fileName.size() - m_headerLength) / sampleBytes;
-    qWarning() << "have total samples:" << totalSamples;
-
-    size_t numBlockSamples = 1;
-    char *blckPtr = new char[channelBytes * numBlockSamples];
-
-    size_t accuCounts = 0;
-    fileName.seek(m_headerLength);
-    while(!fileName.atEnd()){
-        const double fact_16Bit_INT = 1.0 / (double)(32767);
-        double rawValue = 0.0;
-
-        fileName.read(blckPtr, channelBytes * numBlockSamples);
-        char *ptr = blckPtr;
-        for (size_t i = 0; i < numBlockSamples; i++){
-            accuCounts++;
-            //if (m_fileFormat.sampleSize() == 16) {
-            rawValue =  fact_16Bit_INT * (double)(qFromLittleEndian<qint16>((uchar*)ptr));
+
+/* converts numFrames raw frames and feeds them into the ringbuffer(s). a full
+ * ringbuffer is handed over to the analyzer right away. captureNs is the time
+ * on liveClock at which the first sample was recorded at sampleRate (live
+ * mode only, captureNs < 0 otherwise) */
+void AudioInfo::pushPcm(const uchar *pcm, size_t numFrames, qint64 captureNs, int sampleRate)
+{
+    const int frameBytes = m_fileFormat.bytesPerFrame();
+    const int firstChannel = (m_channel == ALL_CHANNELS) ? 0 : m_channel;
+    const bool trackLatency = (captureNs >= 0);
+    size_t numConv;
+    m_stats.bytesDecoded += numFrames * frameBytes;
+    m_stats.framesDecoded += numFrames;
+    for (size_t i = 0; i < numFrames; i += numConv){
+      numConv = (numFrames - i) < CONVERT_BLOCK_SAMPLES ?
+                (numFrames - i) : CONVERT_BLOCK_SAMPLES;
+      /* scale to full range and soft gain in one go for the whole block.
+       * deinterleaves: stream s lands at convBuf + s * CONVERT_BLOCK_SAMPLES */
+      const qint64 convertBegin = stageClock.nsecsElapsed();
+      for (int s = 0; s < m_numStreams; s++){
+        converter->convert(pcm, convBuf + s * CONVERT_BLOCK_SAMPLES, numConv, firstChannel + s);
+      }
+      if (normalizer != NULL){
+        normalizer->convert(pcm, normBuf, numConv, firstChannel);
+        for (size_t c = 0; c < numConv; c++){
+          floatBuf[c] = (float)(normBuf[c]);
+        }
+        sidecar->append(floatBuf, numConv);
+      }
+      m_stats.nsConvert += stageClock.nsecsElapsed() - convertBegin;
+      pcm += numConv * frameBytes;
+      for (size_t c = 0; c < numConv; c++){
+        accuCounts++;
 #ifdef WRITEDATATOFILE
-   fprintf(fp, "%f\n", rawValue);
+   fprintf(fp, "%f\n", convBuf[c]);
 #endif
-            ptr += channelBytes;
-            double value = softGain * rawValue;
-            //printf("%f,\n", rawValue);
-            /* write the sample into the ring buffer (insertValue) */
-            headPos++;
-            if (headPos > maxBufPos){
-                headPos = 0;
-                ringBufData[0] = value;
+        /* the oldest new sample of a block determines its latency */
+        if (trackLatency && (numRecords == numExtra)){
+            blockCapture = captureNs + nsecsOf(i + c, sampleRate);
+        }
+        /* write the sample into the ring buffer (insertValue) */
+        headPos++;
+        if (headPos > maxBufPos){
+            headPos = 0;
+        }
+        for (int s = 0; s < m_numStreams; s++){
+            ringBuf[s]->write(headPos, convBuf[s * CONVERT_BLOCK_SAMPLES + c]);
+        }
+        numRecords++;
+        //qWarning() << "pos:" << i ;
+        /* buffer is full */
+        if (numRecords > maxBufPos){
+            //qWarning() << "buffer full at pos:" << i ;
+            /* the window starts numExtra elements before popPos. due to the
+             * mirrored ringbuffer it is linear even across the wrap around */
+            int physPos = popPos - numExtra;
+            int startPos;
+            if (physPos < 0){
+               startPos = maxBufPos + physPos + 1;
             }
             else{
-                ringBufData[headPos] = value;
+               startPos = physPos;
             }
-            numRecords++;
-            //qWarning() << "pos:" << i ;
-            /* buffer is full */
-            if (numRecords > maxBufPos){
-                //qWarning() << "buffer full at pos:" << i ;
-                /* rearrange the buffer (copyArray) to have a linear output array */
-                int physPos = popPos - numExtra;
-                int startPos;
-                if (physPos < 0){
-                   startPos = maxBufPos + physPos + 1;
-                }
-                else{
-                   startPos = physPos;
-                }
-                const size_t numElements = maxBufPos + 1;
-                double * outBuffer = new double[numElements];
-                for (size_t j = 0; j < numElements; j++){
-                   outBuffer[j] = ringBufData[(j + startPos) % (maxBufPos + 1)];
-                }
-
-                //qWarning() << "Thread calling sequence 1 (has to be DirectConnection)";
-                const float percentAct = 100.0 * (float)(accuCounts)/(float)(totalSamples);
-                emit audioDataReady(outBuffer, numElements, percentAct);
-
-                //qWarning() << "Thread calling sequence 3 (has to be DirectConnection)";
-                delete [] outBuffer;
+            const size_t numElements = maxBufPos + 1;
 
-                /* data now processed. empty the ringbuffer. keep numExtra elements for
-                   the next cycle (numElements - numExtra to be deleted) */
-                numRecords = numExtra ;
-                /* adjust to the correct position */
-                const size_t newPos = popPos + numElements - numExtra;
-                if (newPos > maxBufPos){
-                    popPos = newPos - (maxBufPos + 1);
+            //qWarning() << "Thread calling sequence 1 (has to be DirectConnection)";
+            /* the window is only valid until the slot returns */
+            const float percentAct = streamSamples > 0 ?
+                                     100.0 * (float)(accuCounts)/(float)(streamSamples) : 0.0;
+            const qint64 handoverBegin = stageClock.nsecsElapsed();
+            if (m_channel == ALL_CHANNELS){
+                for (int s = 0; s < m_numStreams; s++){
+                    double * block = chanQueue[s]->beginWrite();
+                    memcpy(block, ringBuf[s]->data() + startPos, numElements * sizeof(double));
+                    chanQueue[s]->endWrite(numElements, percentAct);
                 }
-                else{
-                    popPos =  newPos;
+            }
+            else{
+                handOver(ringBuf[0]->data() + startPos, numElements, percentAct);
+                if (trackLatency && !m_pipelined){
+                    latency->add(liveClock.nsecsElapsed() - blockCapture);
                 }
             }
+            m_stats.nsHandover += stageClock.nsecsElapsed() - handoverBegin;
+            m_stats.blocksDecoded ++;
+            m_statsBoard.publish(m_stats);
+
+            /* data now processed. empty the ringbuffer. keep numExtra elements for
+               the next cycle (numElements - numExtra to be deleted) */
+            numRecords = numExtra ;
+            /* adjust to the correct position */
+            const size_t newPos = popPos + numElements - numExtra;
+            if (newPos > maxBufPos){
+                popPos = newPos - (maxBufPos + 1);
+            }
+            else{
+                popPos =  newPos;
+            }
         }
-        /* stop thread if requested */
+      }
+    }
+}
+
+
+/* hands a block of the selected channel over to the analyzer */
+void AudioInfo::handOver(const double *block, size_t numElements, float percent)
+{
+    if (m_pipelined){
+        /* waits if the analyzer is behind */
+        double * slot = blockQueue->beginWrite();
+        memcpy(slot, block, numElements * sizeof(double));
+        blockQueue->endWrite(numElements, percent);
+    }
+    else{
+        emit audioDataReady(block, numElements, percent);
+    }
+}
+
+
+/**
+ *  decode() from the sidecar: the blocks are cut straight out of the
+ *  normalized samples, the ringbuffer is not needed. They hold the same
+ *  doubles as the blocks of pushPcm(): numExtra zeros in front of the
+ *  first sample and full blocks only, the end of the last one is not
+ *  analyzed.
+ **/
+void AudioInfo::decodeSidecar(quint64 firstSample, quint64 numSamples)
+{
+    const size_t numElements = maxBufPos + 1;
+    const size_t step = numElements - numExtra;
+    const float * src = sidecar->data() + firstSample;
+    m_usedSidecar = true;
+
+    QElapsedTimer timer;
+    timer.start();
+
+    beginStream(numSamples);
+    memset(window, 0, numExtra * sizeof(double));
+    quint64 done = 0;
+    while (done + step <= numSamples){
+        const qint64 convertBegin = stageClock.nsecsElapsed();
+        converter->convertNormalized(src + done, window + numExtra, step);
+        m_stats.nsConvert += stageClock.nsecsElapsed() - convertBegin;
+        done += step;
+        m_stats.bytesDecoded += step * sizeof(float);
+        m_stats.framesDecoded += step;
+        const float percentAct = 100.0 * (float)(done)/(float)(numSamples);
+        const qint64 handoverBegin = stageClock.nsecsElapsed();
+        handOver(window, numElements, percentAct);
+        m_stats.nsHandover += stageClock.nsecsElapsed() - handoverBegin;
+        m_stats.blocksDecoded ++;
+        m_statsBoard.publish(m_stats);
+        /* the end of this block is the past of the next one */
+        memmove(window, window + step, numExtra * sizeof(double));
         if(this->m_abort) break;
     }
-    delete [] blckPtr;
-#ifdef WRITEDATATOFILE
- fclose(fp);
-#endif
+    if (!m_abort){
+        m_stats.bytesDecoded += (numSamples - done) * sizeof(float);
+        m_stats.framesDecoded += numSamples - done;
+    }
+    endStream();
+
+    const qint64 nsecs = timer.nsecsElapsed();
+    m_stats.nsDecode += nsecs;
+    m_statsBoard.publish(m_stats);
+    m_decodeRate = (nsecs > 0) ? (double)(m_stats.bytesDecoded) * 1e3 / (double)(nsecs) : 0.0;
+    qWarning() << "read" << m_stats.bytesDecoded << "bytes from the sidecar," << m_decodeRate << "MB/s";
 }
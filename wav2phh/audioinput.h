@@ -33,6 +33,24 @@
 #include <QThread>
 #include <QtCore>
 
+#include "blockqueue.h"
+#include "latencystats.h"
+#include "pcmconvert.h"
+#include "pipelinestats.h"
+#include "ringbuffer.h"
+#include "sidecar.h"
+
+/* live mode: ringbuffer geometry for short blocks (768 new samples, 16 ms
+ * at 48 kHz), the capture buffer of the device and the polling period */
+#define NUM_ELEMENTS_LIVE 1024
+#define NUM_FUTUREPAST_LIVE 256
+#define LIVE_BUFFER_MSECS 100
+#define LIVE_POLL_MSECS 2
+/* wav files with up to this number of channels are decoded */
+#define WAV_MAX_CHANNELS 8
+/* selectChannel(): deinterleave all channels, one output per channel */
+#define ALL_CHANNELS -1
+
 
 class AudioInfo : public QThread
 {
@@ -41,11 +59,41 @@ public:
    explicit AudioInfo(size_t numElements, size_t numExtras, QObject *parent = 0 );
    ~AudioInfo();
    bool open(const QString &name);
+   /* live mode: 16 bit mono from a capture device ... */
+   bool openDevice(const QAudioDeviceInfo &device, int sampleRate);
+   /* ... or the opened wav file replayed at the speed of its sample rate */
+   void setReplay(bool enable);
    bool readHeader();
    void decode();
    void run();
+   /* the building blocks of decode(), also used by the live mode */
+   void beginStream(quint64 numSamples);
+   void pushPcm(const uchar *pcm, size_t numFrames, qint64 captureNs = -1, int sampleRate = 0);
+   void endStream();
+   /* results of the last live run */
+   const LatencyStats &latencyStats();
+   quint64 overruns();
    const QAudioFormat &fileFormat();
    qint64 headerLength();
+   quint64 totalSamples();
+   void setRange(quint64 firstSample, quint64 numSamples);
+   void setPipelined(bool enable);
+   /* SIDECAR_MODES: a later decode() of the same channel reads the
+    * normalized samples of the first one instead of the wav file */
+   void setSidecar(int mode);
+   bool usedSidecar();
+   /* decode() hashes the data region as it reads it (ContentHash), for the
+    * result cache. only a complete run over the raw file yields the hash */
+   void setContentHash(bool enable);
+   bool contentHash(quint64 *hash);
+   bool selectChannel(int channel);
+   BlockConsumer * channelOutput(int channel);
+   BlockQueueStats queueStats();
+   const uchar * dataRegion();
+   quint64 dataLength();
+   double decodeRate();
+   /* decoder counters and timings, updated per block, safe from any thread */
+   PipelineStats statistics();
    void resetSoftGain(double gain);
    void stopProcess();
 
@@ -53,9 +101,70 @@ private:
    QFile fileName;
    QAudioFormat m_fileFormat;
    quint64 m_headerLength;
+   quint64 m_dataLength;
+   uchar * m_map;
+   double m_decodeRate;
+   quint64 m_firstSample;
+   quint64 m_numSamples;
+   void mapDataRegion();
+   void unmapDataRegion();
    size_t maxBufPos;
    size_t numExtra;
-   double * ringBufData;
+   /* one ring per decoded channel, the first m_numStreams are in use */
+   MirrorBuffer * ringBuf[WAV_MAX_CHANNELS];
+   int m_channel;
+   int m_numStreams;
+   /* scratch for decode(), owned by the object so that a run does not allocate.
+    * CONVERT_BLOCK_SAMPLES per stream */
+   double * convBuf;
+   char * readBuf;
+   /* pipelined mode: blocks are copied into the queue and audioDataReady is
+    * emitted from the consumer thread */
+   bool m_pipelined;
+   BlockQueue * blockQueue;
+   BlockConsumer * consumer;
+   /* ALL_CHANNELS: a queue and a consumer thread per channel */
+   BlockQueue * chanQueue[WAV_MAX_CHANNELS];
+   BlockConsumer * chanConsumer[WAV_MAX_CHANNELS];
+   /* state of the stream between beginStream() and endStream() */
+   size_t headPos;
+   size_t numRecords;
+   size_t popPos;
+   quint64 accuCounts;
+   quint64 streamSamples;
+   PcmConverter * converter;
+   /* sidecar: normalizer and its scratch write it, window is the block
+    * cut out of it by decodeSidecar() */
+   int m_sidecarMode;
+   bool m_usedSidecar;
+   SampleSidecar * sidecar;
+   bool m_hashWanted;
+   bool m_hashValid;
+   quint64 m_hash;
+   PcmConverter * normalizer;
+   double * normBuf;
+   float * floatBuf;
+   double * window;
+   SidecarHeader sidecarHeader();
+   void decodeSidecar(quint64 firstSample, quint64 numSamples);
+   void handOver(const double *block, size_t numElements, float percent);
+   /* written by the decoding thread only, published per block */
+   PipelineStats m_stats;
+   StatsBoard m_statsBoard;
+   QElapsedTimer stageClock;
+   /* live mode */
+   enum { SOURCE_FILE, SOURCE_REPLAY, SOURCE_DEVICE } m_source;
+   QAudioDeviceInfo m_device;
+   QElapsedTimer liveClock;
+   qint64 blockCapture;
+   LatencyStats * latency;
+   quint64 m_overruns;
+   void runLive();
+   void runReplay();
+   void runDevice();
+#ifdef WRITEDATATOFILE
+   FILE * fp;
+#endif
    double softGain;
    size_t numProcessed;
    bool m_abort;
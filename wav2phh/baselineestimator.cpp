@@ -0,0 +1,387 @@
+/** \file baselineestimator.cpp
+ * \brief Baseline estimators: moving averages and a sliding median
+ *
+ * \author Copyright (C) 2014 samplemaker
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1
+ * of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free
+ * Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA
+ *
+ * @{
+ */
+
+#include <cstring>
+#include <cmath>
+#include "baselineestimator.h"
+
+
+BaselineEstimator * BaselineEstimator::create(int estimator, int numElements){
+  if (numElements < 1){
+    numElements = 1;
+  }
+  switch (estimator){
+    case BASELINE_MEAN:
+      return(new SlidingMean(numElements));
+    case BASELINE_EMA:
+      return(new ExponentialAverage(numElements));
+    case BASELINE_MEDIAN:
+      return(new SlidingMedian(numElements));
+    default:
+      return(new MovingAverage(numElements));
+  }
+}
+
+
+const char * BaselineEstimator::name(int estimator){
+  switch (estimator){
+    case BASELINE_MEAN:
+      return("mean");
+    case BASELINE_EMA:
+      return("ema");
+    case BASELINE_MEDIAN:
+      return("median");
+    default:
+      return("legacy");
+  }
+}
+
+
+/* the gate of Analyzer::doBaseline, instantiated per estimator so that push()
+ * is inlined */
+template <class E>
+static size_t gatedBlock(E *estimator, const double *x, size_t num, double diffThresh,
+                         double relThresh, double *value, double *out){
+  size_t numAdded = 0;
+  double v = *value;
+  for (size_t n = 0; n < num; n ++){
+    const double n0 = x[n];
+    if ((fabs(n0 - x[n + 1]) < diffThresh) && (n0 < relThresh)){
+      v = estimator->push(n0);
+      numAdded ++;
+    }
+    if (out != NULL){
+      out[n] = v;
+    }
+  }
+  *value = v;
+  return(numAdded);
+}
+
+
+MovingAverage::MovingAverage (int numElements) {
+  maxBufPos = numElements - 1;
+  ringBufData = new double[maxBufPos + 1]();
+  headPos = 0;
+  numRecords = 0;
+  ringBufSum = 0.0;
+}
+
+/* destructor */
+MovingAverage::~MovingAverage () {
+  delete[] ringBufData;
+}
+
+
+void MovingAverage::reset() {
+  memset(ringBufData, 0, sizeof(double) * (maxBufPos + 1));
+  headPos = 0;
+  numRecords = 0;
+  ringBufSum = 0.0;
+}
+
+
+double MovingAverage::doMovingAverage(double value) {
+  ringBufData[headPos] = value;
+  numRecords++;
+  headPos ++;
+  /* end of buffer reached */
+  if (headPos == maxBufPos){
+     ringBufSum += value - ringBufData[0];
+     headPos = 0;
+   }
+  else{
+     ringBufSum += value - ringBufData[headPos];
+  }
+  return(ringBufSum/(double)(numRecords));
+}
+
+
+double MovingAverage::add(double value) {
+  return(doMovingAverage(value));
+}
+
+
+/* the filter of the original code is kept as it is: no inline variant */
+size_t MovingAverage::addBlock(const double *x, size_t num, double diffThresh,
+                               double relThresh, double *value, double *out) {
+  size_t numAdded = 0;
+  for (size_t n = 0; n < num; n ++){
+    if ((fabs(x[n] - x[n + 1]) < diffThresh) && (x[n] < relThresh)){
+      *value = doMovingAverage(x[n]);
+      numAdded ++;
+    }
+    if (out != NULL){
+      out[n] = *value;
+    }
+  }
+  return(numAdded);
+}
+
+
+/* the estimate is the sum of the recent samples divided by all samples seen
+ * so far: never below min(0, smallest sample in the ring) */
+double MovingAverage::lowerBound() {
+  double low = 0.0;
+  for (int n = 0; n <= maxBufPos; n ++){
+    if (ringBufData[n] < low) low = ringBufData[n];
+  }
+  return(low);
+}
+
+
+SlidingMean::SlidingMean (int numElements) {
+  numData = numElements;
+  ringData = new double[numData]();
+  reset();
+}
+
+
+SlidingMean::~SlidingMean () {
+  delete[] ringData;
+}
+
+
+void SlidingMean::reset() {
+  memset(ringData, 0, sizeof(double) * numData);
+  headPos = 0;
+  numRecords = 0;
+  ringSum = 0.0;
+}
+
+
+void SlidingMean::resum() {
+  double sum = 0.0;
+  for (int n = 0; n < numRecords; n ++){
+    sum += ringData[n];
+  }
+  ringSum = sum;
+}
+
+
+double SlidingMean::add(double value) {
+  return(push(value));
+}
+
+
+size_t SlidingMean::addBlock(const double *x, size_t num, double diffThresh,
+                             double relThresh, double *value, double *out) {
+  return(gatedBlock(this, x, num, diffThresh, relThresh, value, out));
+}
+
+
+/* the ring fills up from slot 0 */
+double SlidingMean::lowerBound() {
+  double low = HUGE_VAL;
+  for (int n = 0; n < numRecords; n ++){
+    if (ringData[n] < low) low = ringData[n];
+  }
+  return(low);
+}
+
+
+ExponentialAverage::ExponentialAverage (int numElements) {
+  numData = numElements;
+  alpha = 2.0 / (double)(numData + 1);
+  reset();
+}
+
+
+void ExponentialAverage::reset() {
+  average = 0.0;
+  empty = true;
+}
+
+
+double ExponentialAverage::add(double value) {
+  return(push(value));
+}
+
+
+size_t ExponentialAverage::addBlock(const double *x, size_t num, double diffThresh,
+                                    double relThresh, double *value, double *out) {
+  return(gatedBlock(this, x, num, diffThresh, relThresh, value, out));
+}
+
+
+/* a convex combination of the average and the new samples */
+double ExponentialAverage::lowerBound() {
+  return(empty ? HUGE_VAL : average);
+}
+
+
+SlidingMedian::SlidingMedian (int numElements) {
+  numData = numElements;
+  ringData = new double[numData]();
+  heapOf = new int[numData];
+  posOf = new int[numData];
+  /* the lower heap holds up to (n + 1) / 2, the upper one n / 2 slots */
+  for (int h = 0; h < 2; h ++){
+    heap[h].key = new double[numData];
+    heap[h].slot = new int[numData];
+  }
+  heap[0].sign = 1.0;
+  heap[1].sign = -1.0;
+  reset();
+}
+
+
+SlidingMedian::~SlidingMedian () {
+  delete[] ringData;
+  delete[] heapOf;
+  delete[] posOf;
+  for (int h = 0; h < 2; h ++){
+    delete[] heap[h].key;
+    delete[] heap[h].slot;
+  }
+}
+
+
+void SlidingMedian::reset() {
+  headPos = 0;
+  numRecords = 0;
+  heap[0].num = 0;
+  heap[1].num = 0;
+}
+
+
+/* both heaps are max heaps of their keys */
+void SlidingMedian::siftUp(int h, int i) {
+  Heap &hp = heap[h];
+  const int slot = hp.slot[i];
+  const double k = hp.key[i];
+  while (i > 0){
+    const int parent = (i - 1) / 2;
+    if (hp.key[parent] >= k){
+      break;
+    }
+    place(h, i, hp.slot[parent], hp.key[parent]);
+    i = parent;
+  }
+  place(h, i, slot, k);
+}
+
+
+void SlidingMedian::siftDown(int h, int i) {
+  Heap &hp = heap[h];
+  const int slot = hp.slot[i];
+  const double k = hp.key[i];
+  for (;;){
+    int child = 2 * i + 1;
+    if (child >= hp.num){
+      break;
+    }
+    if ((child + 1 < hp.num) && (hp.key[child + 1] > hp.key[child])){
+      child ++;
+    }
+    if (hp.key[child] <= k){
+      break;
+    }
+    place(h, i, hp.slot[child], hp.key[child]);
+    i = child;
+  }
+  place(h, i, slot, k);
+}
+
+
+void SlidingMedian::insert(int h, int slot) {
+  const int i = heap[h].num ++;
+  place(h, i, slot, heap[h].sign * ringData[slot]);
+  siftUp(h, i);
+}
+
+
+int SlidingMedian::removeTop(int h) {
+  Heap &hp = heap[h];
+  const int top = hp.slot[0];
+  hp.num --;
+  if (hp.num > 0){
+    place(h, 0, hp.slot[hp.num], hp.key[hp.num]);
+    siftDown(h, 0);
+  }
+  return(top);
+}
+
+
+double SlidingMedian::push(double value) {
+  const int slot = headPos;
+  ringData[slot] = value;
+  if (numRecords < numData){
+    /* filling up: insert and keep the lower heap equal or one larger */
+    numRecords ++;
+    if ((heap[0].num == 0) || (value <= heap[0].key[0])){
+      insert(0, slot);
+    }
+    else{
+      insert(1, slot);
+    }
+    if (heap[0].num > heap[1].num + 1){
+      insert(1, removeTop(0));
+    }
+    else if (heap[1].num > heap[0].num){
+      insert(0, removeTop(1));
+    }
+  }
+  else{
+    /* the oldest sample is overwritten in place */
+    const int h = heapOf[slot];
+    const int i = posOf[slot];
+    heap[h].key[i] = heap[h].sign * value;
+    siftUp(h, i);
+    siftDown(h, posOf[slot]);
+    if ((heap[1].num > 0) && (heap[0].key[0] > -heap[1].key[0])){
+      const int lower = heap[0].slot[0];
+      place(0, 0, heap[1].slot[0], -heap[1].key[0]);
+      place(1, 0, lower, -ringData[lower]);
+      siftDown(0, 0);
+      siftDown(1, 0);
+    }
+  }
+  if (++ headPos == numData){
+    headPos = 0;
+  }
+  if (heap[0].num > heap[1].num){
+    return(heap[0].key[0]);
+  }
+  return(0.5 * (heap[0].key[0] - heap[1].key[0]));
+}
+
+
+double SlidingMedian::lowerBound() {
+  double low = HUGE_VAL;
+  for (int n = 0; n < numRecords; n ++){
+    if (ringData[n] < low) low = ringData[n];
+  }
+  return(low);
+}
+
+
+double SlidingMedian::add(double value) {
+  return(push(value));
+}
+
+
+size_t SlidingMedian::addBlock(const double *x, size_t num, double diffThresh,
+                               double relThresh, double *value, double *out) {
+  return(gatedBlock(this, x, num, diffThresh, relThresh, value, out));
+}
@@ -0,0 +1,223 @@
+/** \file baselineestimator.h
+ * \brief Baseline estimators: moving averages and a sliding median
+ *
+ * \author Copyright (C) 2014 samplemaker
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1
+ * of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free
+ * Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA
+ *
+ * @{
+ */
+
+#ifndef BASELINEESTIMATOR_H
+#define BASELINEESTIMATOR_H
+
+#include <cstdlib>
+
+
+/* implementations of BaselineEstimator, see BaseLine::estimator */
+enum BASELINE_ESTIMATORS {
+    BASELINE_LEGACY,    /* MovingAverage of the original code */
+    BASELINE_MEAN,      /* exact sliding mean over the window */
+    BASELINE_EMA,       /* exponential moving average, same center of mass */
+    BASELINE_MEDIAN     /* sliding median over the window (two heaps) */
+};
+
+
+/**
+ *  Analyzer::doBaseline feeds the samples which pass its gate (small slope,
+ *  below the absolute threshold) into an estimator and holds the last value
+ *  in between. add() takes one gated sample, addBlock() runs the gate itself
+ *  over a whole block without a virtual call per sample.
+ **/
+class BaselineEstimator
+{
+
+  public:
+    virtual ~BaselineEstimator () {}
+    /* numElements: window length (legacy, mean, median) or center of mass (ema) */
+    static BaselineEstimator * create(int estimator, int numElements);
+    static const char * name(int estimator);
+    /* adds one sample, returns the new estimate */
+    virtual double add(double value) = 0;
+    /* sample n of x[0 .. num] is added if |x[n] - x[n + 1]| < diffThresh and
+     * x[n] < relThresh. *value is the held estimate, it is updated in place.
+     * out[n] (if not NULL) receives the estimate valid at sample n. returns
+     * the number of samples added */
+    virtual size_t addBlock(const double *x, size_t num, double diffThresh,
+                            double relThresh, double *value, double *out = NULL) = 0;
+    /* no estimate falls below this value as long as the samples added are
+     * not lower (up to rounding). O(size()), for the trigger pre-scan */
+    virtual double lowerBound() = 0;
+    virtual void reset() = 0;
+    virtual int size() = 0;
+    virtual int kind() = 0;
+};
+
+
+/* the original filter, kept for histograms identical to earlier versions.
+ * it divides the sum by all samples seen so far and the wrap around at
+ * maxBufPos skips a slot: not a true windowed average */
+class MovingAverage : public BaselineEstimator
+{
+
+  public:
+    /* constructor */
+    MovingAverage (int numElements);
+    /* destructor */
+    ~MovingAverage ();
+    double doMovingAverage(double value);
+    double add(double value);
+    size_t addBlock(const double *x, size_t num, double diffThresh,
+                    double relThresh, double *value, double *out = NULL);
+    double lowerBound();
+    void reset();
+    inline int size() { return maxBufPos + 1; }
+    inline int kind() { return BASELINE_LEGACY; }
+  private:
+    double * ringBufData;
+    int headPos;
+    int numRecords;
+    int maxBufPos;
+    double ringBufSum;
+
+};
+
+
+/* mean of the last numElements samples (fewer during the start). the running
+ * sum is recomputed at every wrap around, so no rounding error accumulates */
+class SlidingMean : public BaselineEstimator
+{
+
+  public:
+    SlidingMean (int numElements);
+    ~SlidingMean ();
+    inline double push(double value){
+      if (numRecords < numData){
+        numRecords ++;
+      }
+      else{
+        ringSum -= ringData[headPos];
+      }
+      ringData[headPos] = value;
+      ringSum += value;
+      if (++ headPos == numData){
+        headPos = 0;
+        resum();
+      }
+      return(ringSum / (double)(numRecords));
+    }
+    double add(double value);
+    size_t addBlock(const double *x, size_t num, double diffThresh,
+                    double relThresh, double *value, double *out = NULL);
+    double lowerBound();
+    void reset();
+    inline int size() { return numData; }
+    inline int kind() { return BASELINE_MEAN; }
+  private:
+    double * ringData;
+    int numData;
+    int headPos;
+    int numRecords;
+    double ringSum;
+    void resum();
+};
+
+
+/* y += alpha * (x - y) with alpha = 2 / (numElements + 1). starts at the
+ * first sample instead of zero */
+class ExponentialAverage : public BaselineEstimator
+{
+
+  public:
+    ExponentialAverage (int numElements);
+    inline double push(double value){
+      if (empty){
+        average = value;
+        empty = false;
+      }
+      else{
+        average += alpha * (value - average);
+      }
+      return(average);
+    }
+    double add(double value);
+    size_t addBlock(const double *x, size_t num, double diffThresh,
+                    double relThresh, double *value, double *out = NULL);
+    double lowerBound();
+    void reset();
+    inline int size() { return numData; }
+    inline int kind() { return BASELINE_EMA; }
+  private:
+    int numData;
+    double alpha;
+    double average;
+    bool empty;
+};
+
+
+/**
+ *  Median of the last numElements samples in O(log n) per sample. The lower
+ *  half sits in a max heap, the upper half in a min heap, both hold slots of
+ *  the ring. Each slot knows its heap and position, so the oldest sample is
+ *  replaced in place: sift it within its heap, then swap the two tops if they
+ *  are out of order. The lower heap holds one more element for odd counts,
+ *  even counts give the mean of both tops.
+ **/
+class SlidingMedian : public BaselineEstimator
+{
+
+  public:
+    SlidingMedian (int numElements);
+    ~SlidingMedian ();
+    double push(double value);
+    double add(double value);
+    size_t addBlock(const double *x, size_t num, double diffThresh,
+                    double relThresh, double *value, double *out = NULL);
+    double lowerBound();
+    void reset();
+    inline int size() { return numData; }
+    inline int kind() { return BASELINE_MEDIAN; }
+  private:
+    /* the keys are kept next to the slots (sign * value), so that sifting
+     * does not chase the slot into the ring */
+    struct Heap
+    {
+      double * key;
+      int * slot;
+      int num;
+      double sign;   /* +1: max heap, -1: min heap */
+    };
+    double * ringData;
+    int * heapOf;    /* 0: lower, 1: upper */
+    int * posOf;
+    Heap heap[2];
+    int numData;
+    int headPos;
+    int numRecords;
+    inline void place(int h, int i, int slot, double key){
+      heap[h].key[i] = key;
+      heap[h].slot[i] = slot;
+      heapOf[slot] = h;
+      posOf[slot] = i;
+    }
+    void siftUp(int h, int i);
+    void siftDown(int h, int i);
+    void insert(int h, int slot);
+    int removeTop(int h);
+};
+
+
+#endif
@@ -0,0 +1,790 @@
+/** \file bench.cpp
+ * \brief Microbenchmarks for the processing stages
+ *
+ * \author Copyright (C) 2014 samplemaker
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1
+ * of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free
+ * Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA
+ *
+ * @{
+ */
+
+#include <stdio.h>
+#include <cmath>
+#include <cstring>
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QVector>
+
+#include "analyzer.h"
+#include "audioinput.h"
+#include "interpolate.h"
+#include "pcmconvert.h"
+#include "pulsegen.h"
+#include "sweeper.h"
+
+/* one entry per printed result row, written with --json */
+static QJsonArray results;
+
+
+static void addResult(const QJsonObject &row)
+{
+  results.append(row);
+}
+
+
+/* a gaussian pulse sampled with roughly the given number of samples per
+ * pulse plus numPast samples on each side - like the analyzer cuts them */
+static void makePulse(double *dst, size_t numSrc, double height)
+{
+  const double center = 0.5 * (double)(numSrc - 1);
+  const double sigma = (double)(numSrc) / 8.0;
+  for (size_t n = 0; n < numSrc; n ++){
+    const double t = ((double)(n) - center) / sigma;
+    dst[n] = height * exp(-0.5 * t * t);
+  }
+}
+
+
+/* polyphase upsample() versus the direct upsampleReference() at the
+ * interpolation factor / window size of the presets in AnalyzerSettings */
+static void benchUpsample()
+{
+  const size_t k[] = {P_IPLN_FAC_DEFAULT, IPLN_PRESET_FACTOR};
+  const size_t windowSize[] = {P_WINDOW_SIZE_DEFAULT, IPLN_PRESET_WINDOW_10SPP};
+  const size_t numSrc[] = {16, 24, 40};
+  const int numRounds = 20000;
+
+  printf("# upsample: k\tN\tnumSrc\tref[ns/pulse]\tpolyphase[ns/pulse]\tspeedup\tmaxdiff\n");
+  for (size_t c = 0; c < sizeof(k) / sizeof(k[0]); c ++){
+    Interpolator lti(k[c], windowSize[c]);
+    for (size_t s = 0; s < sizeof(numSrc) / sizeof(numSrc[0]); s ++){
+      const size_t numDst = k[c] * (numSrc[s] - 1) + 1;
+      double * src = new double[numSrc[s]];
+      double * dstRef = new double[numDst];
+      double * dstFast = new double[numDst];
+      makePulse(src, numSrc[s], 0.5);
+
+      QElapsedTimer timer;
+      timer.start();
+      for (int r = 0; r < numRounds; r ++){
+        lti.upsampleReference(src, dstRef, numSrc[s], 0.0);
+      }
+      const double nsRef = (double)(timer.nsecsElapsed()) / numRounds;
+
+      timer.restart();
+      for (int r = 0; r < numRounds; r ++){
+        lti.upsample(src, dstFast, numSrc[s], 0.0);
+      }
+      const double nsFast = (double)(timer.nsecsElapsed()) / numRounds;
+
+      double maxDiff = 0.0;
+      for (size_t m = 0; m < numDst; m ++){
+        maxDiff = fmax(maxDiff, fabs(dstRef[m] - dstFast[m]));
+      }
+      printf("upsample\t%u\t%u\t%u\t%.1f\t%.1f\t%.2f\t%.3g\n",
+             (unsigned)k[c], (unsigned)windowSize[c], (unsigned)numSrc[s],
+             nsRef, nsFast, nsRef / nsFast, maxDiff);
+      QJsonObject row;
+      row["bench"] = "upsample";
+      row["k"] = (int)(k[c]);
+      row["N"] = (int)(windowSize[c]);
+      row["numSrc"] = (int)(numSrc[s]);
+      row["refNsPerPulse"] = nsRef;
+      row["nsPerPulse"] = nsFast;
+      row["maxDiff"] = maxDiff;
+      addResult(row);
+      delete [] src;
+      delete [] dstRef;
+      delete [] dstFast;
+    }
+  }
+}
+
+
+/* PcmConverter::convert() versus convertReference() for every supported
+ * format, byte order, channel layout and simd kernel the cpu has. odd
+ * lengths and an odd source
+ * address leave tails for the simd kernels, the output has to be bitwise
+ * equal. returns the number of mismatching runs */
+static int benchPcmConvert()
+{
+  const int bits[] = {8, 16, 24, 32, 32};
+  const bool isFloat[] = {false, false, false, false, true};
+  const char * simd[] = {"scalar", "sse2", "avx2"};
+  const size_t lengths[] = {1, 7, 8, 15, 17, 33, 1023, 4097};
+  const size_t maxLength = 4097;
+  const int maxFrameBytes = 4 * 2;
+  const int numRounds = 200;
+  int failures = 0;
+
+  /* random bytes: every bit pattern of a sample is a valid input */
+  QVector<unsigned char> raw(maxLength * maxFrameBytes + 1);
+  quint32 state = 12345;
+  for (int n = 0; n < raw.size(); n ++){
+    state = state * 1664525u + 1013904223u;
+    raw[n] = (unsigned char)(state >> 24);
+  }
+  QVector<double> dstRef(maxLength);
+  QVector<double> dstFast(maxLength);
+
+  printf("# pcm: format\tchannels\tkernel\tref[ns/sample]\tkernel[ns/sample]\tspeedup\tmismatches\n");
+  for (size_t f = 0; f < sizeof(bits) / sizeof(bits[0]); f ++){
+    /* 8 bit samples have no byte order */
+    for (int bigEndian = 0; bigEndian < (bits[f] == 8 ? 1 : 2); bigEndian ++){
+      for (int numChannels = 1; numChannels <= 2; numChannels ++){
+        for (size_t k = 0; k < sizeof(simd) / sizeof(simd[0]); k ++){
+          PcmConverter converter(bits[f], isFloat[f], bigEndian != 0, numChannels);
+          if (!converter.selectKernel(simd[k])){
+            continue;
+          }
+          converter.setGain(1.7);
+          int mismatches = 0;
+          for (int channel = 0; channel < numChannels; channel ++){
+            for (size_t l = 0; l < sizeof(lengths) / sizeof(lengths[0]); l ++){
+              for (int offset = 0; offset < 2; offset ++){
+                const unsigned char * src = raw.constData() + offset;
+                dstRef.fill(0.0);
+                dstFast.fill(-1.0);
+                converter.convertReference(src, dstRef.data(), lengths[l], channel);
+                converter.convert(src, dstFast.data(), lengths[l], channel);
+                /* also nothing may be written beyond the end */
+                if ((memcmp(dstRef.constData(), dstFast.constData(), lengths[l] * sizeof(double)) != 0) ||
+                    ((lengths[l] < maxLength) && (dstFast[(int)(lengths[l])] != -1.0))){
+                  mismatches ++;
+                }
+              }
+            }
+          }
+
+          QElapsedTimer timer;
+          timer.start();
+          for (int r = 0; r < numRounds; r ++){
+            converter.convertReference(raw.constData(), dstRef.data(), maxLength, 0);
+          }
+          const double nsRef = (double)(timer.nsecsElapsed()) / ((double)(numRounds) * maxLength);
+          timer.restart();
+          for (int r = 0; r < numRounds; r ++){
+            converter.convert(raw.constData(), dstFast.data(), maxLength, 0);
+          }
+          const double nsFast = (double)(timer.nsecsElapsed()) / ((double)(numRounds) * maxLength);
+
+          const QString format = QString("%1%2%3").arg(isFloat[f] ? "f" : (bits[f] == 8 ? "u" : "s"))
+                                                  .arg(bits[f]).arg(bigEndian ? "be" : "le");
+          printf("pcm\t%s\t%d\t%s\t%.2f\t%.2f\t%.2f\t%d\n", qPrintable(format), numChannels,
+                 converter.kernelName(), nsRef, nsFast, nsRef / nsFast, mismatches);
+          if (mismatches > 0){
+            fprintf(stderr, "pcm %s, %d channels: %s differs from the reference\n",
+                    qPrintable(format), numChannels, converter.kernelName());
+            failures ++;
+          }
+          QJsonObject row;
+          row["bench"] = "pcm";
+          row["format"] = format;
+          row["channels"] = numChannels;
+          row["kernel"] = converter.kernelName();
+          row["refNsPerSample"] = nsRef;
+          row["nsPerSample"] = nsFast;
+          row["mismatches"] = mismatches;
+          addResult(row);
+        }
+      }
+    }
+  }
+  return(failures);
+}
+
+
+/* the runtime parameter kernels versus the compile time specialized ones
+ * of the presets (both polyphase) */
+static void benchSpecialized()
+{
+  const size_t windowSize[] = {IPLN_PRESET_WINDOW_6SPP, IPLN_PRESET_WINDOW_10SPP};
+  const size_t numSrc[] = {16, 24, 40};
+  const int numRounds = 20000;
+  const size_t k = IPLN_PRESET_FACTOR;
+
+  printf("# specialized: k\tN\tnumSrc\truntime[ns/pulse]\tfixed[ns/pulse]\tspeedup\tmaxdiff\n");
+  for (size_t c = 0; c < sizeof(windowSize) / sizeof(windowSize[0]); c ++){
+    Interpolator ltiFixed(k, windowSize[c]);
+    Interpolator ltiRuntime(k, windowSize[c]);
+    ltiRuntime.setSpecialized(false);
+    for (size_t s = 0; s < sizeof(numSrc) / sizeof(numSrc[0]); s ++){
+      const size_t numDst = k * (numSrc[s] - 1) + 1;
+      double * src = new double[numSrc[s]];
+      double * dstRuntime = new double[numDst];
+      double * dstFixed = new double[numDst];
+      makePulse(src, numSrc[s], 0.5);
+
+      QElapsedTimer timer;
+      timer.start();
+      for (int r = 0; r < numRounds; r ++){
+        ltiRuntime.upsample(src, dstRuntime, numSrc[s], 0.0);
+      }
+      const double nsRuntime = (double)(timer.nsecsElapsed()) / numRounds;
+
+      timer.restart();
+      for (int r = 0; r < numRounds; r ++){
+        ltiFixed.upsample(src, dstFixed, numSrc[s], 0.0);
+      }
+      const double nsFixed = (double)(timer.nsecsElapsed()) / numRounds;
+
+      double maxDiff = 0.0;
+      for (size_t m = 0; m < numDst; m ++){
+        maxDiff = fmax(maxDiff, fabs(dstRuntime[m] - dstFixed[m]));
+      }
+      printf("specialized\t%u\t%u\t%u\t%.1f\t%.1f\t%.2f\t%.3g\n",
+             (unsigned)k, (unsigned)windowSize[c], (unsigned)numSrc[s],
+             nsRuntime, nsFixed, nsRuntime / nsFixed, maxDiff);
+      QJsonObject row;
+      row["bench"] = "specialized";
+      row["kernel"] = ltiFixed.kernelName();
+      row["k"] = (int)(k);
+      row["N"] = (int)(windowSize[c]);
+      row["numSrc"] = (int)(numSrc[s]);
+      row["runtimeNsPerPulse"] = nsRuntime;
+      row["nsPerPulse"] = nsFixed;
+      row["maxDiff"] = maxDiff;
+      addResult(row);
+      delete [] src;
+      delete [] dstRuntime;
+      delete [] dstFixed;
+    }
+  }
+}
+
+
+/* height of a pulse: upsample + scan versus the lazy local refinement */
+static void benchPeakSearch()
+{
+  const size_t numSrc[] = {16, 24, 40};
+  const int numRounds = 20000;
+  Interpolator lti(P_IPLN_FAC_DEFAULT, P_WINDOW_SIZE_DEFAULT);
+
+  printf("# peaksearch: numSrc\tupsample[ns/pulse]\tlazy[ns/pulse]\tspeedup\theightdiff\n");
+  for (size_t s = 0; s < sizeof(numSrc) / sizeof(numSrc[0]); s ++){
+    const size_t numDst = P_IPLN_FAC_DEFAULT * (numSrc[s] - 1) + 1;
+    double * src = new double[numSrc[s]];
+    double * dst = new double[numDst];
+    makePulse(src, numSrc[s], 0.5);
+
+    double heightGrid = 0.0;
+    QElapsedTimer timer;
+    timer.start();
+    for (int r = 0; r < numRounds; r ++){
+      lti.upsample(src, dst, numSrc[s], 0.0);
+      double searchMax = -1.0;
+      double searchMin = 1.0;
+      for (size_t m = 0; m < numDst; m ++){
+        searchMax = fmax(searchMax, dst[m]);
+        searchMin = fmin(searchMin, dst[m]);
+      }
+      heightGrid = searchMax - searchMin;
+    }
+    const double nsGrid = (double)(timer.nsecsElapsed()) / numRounds;
+
+    double heightLazy = 0.0;
+    timer.restart();
+    for (int r = 0; r < numRounds; r ++){
+      size_t posMax = 0;
+      size_t posMin = 0;
+      for (size_t n = 1; n < numSrc[s]; n ++){
+        if (src[n] > src[posMax]) posMax = n;
+        if (src[n] < src[posMin]) posMin = n;
+      }
+      double valMax, valMin;
+      lti.refineExtrema(src, numSrc[s], posMax, posMin, 0.0, &valMax, &valMin);
+      heightLazy = fmax(-1.0, valMax) - fmin(1.0, valMin);
+    }
+    const double nsLazy = (double)(timer.nsecsElapsed()) / numRounds;
+
+    printf("peaksearch\t%u\t%.1f\t%.1f\t%.2f\t%.3g\n", (unsigned)numSrc[s],
+           nsGrid, nsLazy, nsGrid / nsLazy, heightLazy - heightGrid);
+    QJsonObject row;
+    row["bench"] = "peaksearch";
+    row["numSrc"] = (int)(numSrc[s]);
+    row["upsampleNsPerPulse"] = nsGrid;
+    row["lazyNsPerPulse"] = nsLazy;
+    row["heightDiff"] = heightLazy - heightGrid;
+    addResult(row);
+    delete [] src;
+    delete [] dst;
+  }
+}
+
+
+/* the baseline estimators alone on the synthetic signal: every sample is
+ * added (add) and the gate of the analyzer over whole blocks (addBlock) */
+static void benchBaseline(const QVector<double> &signal)
+{
+  const int numAvrg[] = {B_NUM_AVRG_DEFAULT, 200};
+  const int estimators[] = {BASELINE_LEGACY, BASELINE_MEAN, BASELINE_EMA, BASELINE_MEDIAN};
+  const int step = NUM_ELEMENTS_RINGBUF - NUM_FUTUREPAST_RINGBUF;
+  const int numBlocks = (signal.size() - 1) / step;
+
+  printf("# baseline: estimator\tsize\tsamples\tadd[ns/sample]\tblock[ns/sample]\n");
+  for (size_t e = 0; e < sizeof(estimators) / sizeof(estimators[0]); e ++){
+    for (size_t c = 0; c < sizeof(numAvrg) / sizeof(numAvrg[0]); c ++){
+      BaselineEstimator * estimator = BaselineEstimator::create(estimators[e], numAvrg[c]);
+      /* keeps the compiler from dropping the loop */
+      volatile double sink = 0.0;
+      QElapsedTimer timer;
+      timer.start();
+      for (int n = 0; n < signal.size(); n ++){
+        sink = estimator->add(signal[n]);
+      }
+      const double nsAdd = (double)(timer.nsecsElapsed()) / signal.size();
+      estimator->reset();
+      double value = 0.0;
+      timer.start();
+      for (int b = 0; b < numBlocks; b ++){
+        estimator->addBlock(signal.constData() + b * step, step,
+                            B_DIFF_TRESH_DEFAULT, B_REL_THRESH_DEFAULT, &value);
+      }
+      const double nsBlock = numBlocks > 0 ? (double)(timer.nsecsElapsed()) / ((double)(numBlocks) * step) : 0.0;
+      sink = value;
+      Q_UNUSED(sink);
+      delete estimator;
+      const char * name = BaselineEstimator::name(estimators[e]);
+      printf("baseline\t%s\t%d\t%d\t%.2f\t%.2f\n", name, numAvrg[c], (int)(signal.size()), nsAdd, nsBlock);
+      QJsonObject row;
+      row["bench"] = "baseline";
+      row["estimator"] = name;
+      row["size"] = numAvrg[c];
+      row["samples"] = (int)(signal.size());
+      row["nsPerSample"] = nsAdd;
+      row["nsPerSampleBlock"] = nsBlock;
+      addResult(row);
+    }
+  }
+}
+
+
+static void defaultSettings(BaseLine &baseline, PulseEvent &pulseEvent, int peakMode)
+{
+  baseline.value = 0;
+  baseline.diffThresh = B_DIFF_TRESH_DEFAULT;
+  baseline.relThresh = B_REL_THRESH_DEFAULT;
+  baseline.numMAvrg = B_NUM_AVRG_DEFAULT;
+  baseline.estimator = B_ESTIMATOR_DEFAULT;
+  pulseEvent.trigThresh = P_TRIG_THRESH_DEFAULT;
+  pulseEvent.numPast = P_NUM_PAST_DEFAULT;
+  pulseEvent.minGlitchFilter = P_MIN_GLITCH_DEFAULT;
+  pulseEvent.maxGlitchFilter = P_MAX_GLITCH_DEFAULT;
+  pulseEvent.iplnFactor = P_IPLN_FAC_DEFAULT;
+  pulseEvent.windowSize = P_WINDOW_SIZE_DEFAULT;
+  pulseEvent.peakMode = peakMode;
+}
+
+
+/* Analyzer::doHistogram fed with the blocks AudioInfo would hand over. a
+ * signal without pulses measures the trigger search and the baseline only */
+static void benchTrigger(const QVector<double> &signal, const QVector<double> &quiet)
+{
+  const int step = NUM_ELEMENTS_RINGBUF - NUM_FUTUREPAST_RINGBUF;
+  const int modes[] = {PEAK_UPSAMPLE, PEAK_LAZY};
+
+  printf("# trigger: signal\tpeakmode\tsamples\tpulses\tns/sample\tpulses/s\n");
+  for (int v = 0; v < 2; v ++){
+    const QVector<double> &src = (v == 0) ? quiet : signal;
+    /* numExtra zeros in front, as the ringbuffer starts */
+    QVector<double> stream(NUM_FUTUREPAST_RINGBUF, 0.0);
+    for (int n = 0; n < src.size(); n ++){
+      stream.append(src[n]);
+    }
+    const int numBlocks = (stream.size() - NUM_ELEMENTS_RINGBUF) / step;
+    for (int p = 0; p < 2; p ++){
+      BaseLine baseline;
+      PulseEvent pulseEvent;
+      defaultSettings(baseline, pulseEvent, modes[p]);
+      Analyzer analyzer(G_NUM_BINS_HIST_DEFAULT, NUM_FUTUREPAST_RINGBUF, NUM_ELEMENTS_RINGBUF,
+                        &baseline, &pulseEvent);
+      analyzer.setPublishInterval(1 << 30);
+      QElapsedTimer timer;
+      timer.start();
+      for (int b = 0; b < numBlocks; b ++){
+        analyzer.doHistogram(stream.constData() + b * step, NUM_ELEMENTS_RINGBUF, 0.0);
+      }
+      const qint64 nsecs = timer.nsecsElapsed();
+      quint64 numPulses = 0;
+      for (unsigned int i = 0; i < analyzer.histResolution; i ++){
+        numPulses += analyzer.histogram[i];
+      }
+      const double numSamples = (double)(numBlocks) * step;
+      const char * name = (v == 0) ? "quiet" : "pulses";
+      const char * mode = (modes[p] == PEAK_LAZY) ? "lazy" : "upsample";
+      printf("trigger\t%s\t%s\t%.0f\t%llu\t%.2f\t%.0f\n", name, mode, numSamples,
+             (unsigned long long)numPulses, (double)(nsecs) / numSamples,
+             nsecs > 0 ? (double)(numPulses) * 1e9 / nsecs : 0.0);
+      QJsonObject row;
+      row["bench"] = "trigger";
+      row["signal"] = name;
+      row["peakMode"] = mode;
+      row["samples"] = numSamples;
+      row["pulses"] = (double)(numPulses);
+      row["nsPerSample"] = (double)(nsecs) / numSamples;
+      addResult(row);
+    }
+  }
+}
+
+
+/* a pulse crossing the end of block 0 lets block 1 start at sample offset,
+ * off the grid of the pre-scan, so the last samples of block 1 go through the per sample
+ * loop. there the signal ramps down (pulling the baseline low) and block 2
+ * rises again by less than the trigger threshold over the former baseline */
+static QVector<double> offsetSignal(int offset)
+{
+  const int step = NUM_ELEMENTS_RINGBUF - NUM_FUTUREPAST_RINGBUF;
+  QVector<double> x(4 * step, 0.0);
+  const int peak = step - NUM_FUTUREPAST_RINGBUF + offset;
+  for (int j = -8; j <= 8; j ++){
+    const double t = (double)(j) / 2.0;
+    x[peak + j] += 0.3 * exp(-t * t);
+  }
+  const int blockEnd = 2 * step - NUM_FUTUREPAST_RINGBUF;
+  const int tail = (PRESCAN_BLOCK - offset % PRESCAN_BLOCK) % PRESCAN_BLOCK;
+  for (int n = blockEnd - tail; n < blockEnd; n ++){
+    x[n] = -0.002 * (double)(n - (blockEnd - tail) + 1);
+  }
+  for (int n = blockEnd + 5; n < blockEnd + 300; n ++){
+    x[n] = 0.8 * P_TRIG_THRESH_DEFAULT;
+  }
+  return x;
+}
+
+
+/* the per sample loop alone versus the trigger pre-scan: histogram and the
+ * trigger positions have to be identical. returns the number of differences */
+static int benchPrescan(const QVector<double> &signal)
+{
+  const int step = NUM_ELEMENTS_RINGBUF - NUM_FUTUREPAST_RINGBUF;
+  const int estimators[] = {BASELINE_LEGACY, BASELINE_MEAN, BASELINE_EMA, BASELINE_MEDIAN};
+  int failures = 0;
+
+  printf("# prescan: signal\testimator\tpulses\tloop[ns/sample]\tprescan[ns/sample]\tspeedup\tmismatch\n");
+  /* offset -1: the synthetic signal, else offsetSignal(offset) */
+  for (int offset = -1; offset < PRESCAN_BLOCK; offset ++){
+    const QVector<double> src = (offset < 0) ? signal : offsetSignal(offset);
+    QVector<double> stream(NUM_FUTUREPAST_RINGBUF, 0.0);
+    for (int n = 0; n < src.size(); n ++){
+      stream.append(src[n]);
+    }
+    const int numBlocks = (stream.size() - NUM_ELEMENTS_RINGBUF) / step;
+    for (size_t e = 0; e < sizeof(estimators) / sizeof(estimators[0]); e ++){
+      QVector<unsigned int> histogram[2];
+      QVector<PulseRecord> pulses[2];
+      double nsPerSample[2];
+      for (int v = 0; v < 2; v ++){
+        BaseLine baseline;
+        PulseEvent pulseEvent;
+        defaultSettings(baseline, pulseEvent, PEAK_LAZY);
+        baseline.estimator = estimators[e];
+        Analyzer analyzer(G_NUM_BINS_HIST_DEFAULT, NUM_FUTUREPAST_RINGBUF, NUM_ELEMENTS_RINGBUF,
+                          &baseline, &pulseEvent);
+        analyzer.setPublishInterval(1 << 30);
+        analyzer.setPrescan(v == 1);
+        analyzer.setPulseSink(&pulses[v]);
+        QElapsedTimer timer;
+        timer.start();
+        for (int b = 0; b < numBlocks; b ++){
+          analyzer.doHistogram(stream.constData() + b * step, NUM_ELEMENTS_RINGBUF, 0.0);
+        }
+        nsPerSample[v] = (double)(timer.nsecsElapsed()) / ((double)(numBlocks) * step);
+        histogram[v] = QVector<unsigned int>(G_NUM_BINS_HIST_DEFAULT);
+        for (unsigned int i = 0; i < analyzer.histResolution; i ++){
+          histogram[v][i] = analyzer.histogram[i];
+        }
+      }
+      bool mismatch = (histogram[0] != histogram[1]) || (pulses[0].size() != pulses[1].size());
+      for (int i = 0; !mismatch && (i < pulses[0].size()); i ++){
+        mismatch = (pulses[0][i].trigPos != pulses[1][i].trigPos) || (pulses[0][i].bin != pulses[1][i].bin);
+      }
+      const char * name = BaselineEstimator::name(estimators[e]);
+      if (mismatch){
+        fprintf(stderr, "prescan: differs from the per sample loop at offset %d, estimator %s\n", offset, name);
+        failures ++;
+      }
+      /* the offset signals are only checked, rows for the synthetic one */
+      if (offset >= 0){
+        continue;
+      }
+      printf("prescan\tpulses\t%s\t%d\t%.2f\t%.2f\t%.2f\t%d\n", name, (int)(pulses[1].size()),
+             nsPerSample[0], nsPerSample[1], nsPerSample[0] / nsPerSample[1], mismatch ? 1 : 0);
+      QJsonObject row;
+      row["bench"] = "prescan";
+      row["estimator"] = name;
+      row["pulses"] = (int)(pulses[1].size());
+      row["loopNsPerSample"] = nsPerSample[0];
+      row["nsPerSample"] = nsPerSample[1];
+      row["mismatch"] = mismatch;
+      addResult(row);
+    }
+  }
+  printf("prescan\toffsets 0..%d\t%s\n", PRESCAN_BLOCK - 1, failures > 0 ? "differ" : "identical");
+  return(failures);
+}
+
+
+/* the ways the blocks of a decode reach the analyzers */
+enum { PATH_DIRECT, PATH_PIPELINE, PATH_CHANNELS };
+
+
+/* one decode of wavFile into the configurations of a sweep spec, returns
+ * the histogram of each one (empty if the file cannot be opened) */
+static QVector<QVector<unsigned int> > pathHistograms(const QString &wavFile, const QString &spec,
+                                                      int numThreads, int path)
+{
+  QVector<QVector<unsigned int> > histograms;
+  AudioInfo audioInfo(NUM_ELEMENTS_RINGBUF, NUM_FUTUREPAST_RINGBUF);
+  if (!audioInfo.open(wavFile)){
+    fprintf(stderr, "cannot open %s\n", qPrintable(wavFile));
+    return histograms;
+  }
+  BaseLine baseline;
+  PulseEvent pulseEvent;
+  defaultSettings(baseline, pulseEvent, P_PEAK_MODE_DEFAULT);
+  Sweeper sweeper(G_NUM_BINS_HIST_DEFAULT, NUM_FUTUREPAST_RINGBUF, NUM_ELEMENTS_RINGBUF, baseline);
+  QString error;
+  if (!sweeper.setup(spec, pulseEvent, numThreads, &error)){
+    fprintf(stderr, "%s: %s\n", qPrintable(spec), qPrintable(error));
+    return histograms;
+  }
+  if (path == PATH_CHANNELS){
+    audioInfo.selectChannel(ALL_CHANNELS);
+    QObject::connect(audioInfo.channelOutput(0),
+                     SIGNAL( blockReady(const double *, size_t, float) ),
+                     &sweeper,
+                     SLOT( doBlock(const double *, size_t, float)),
+                     Qt::DirectConnection);
+  }
+  else{
+    audioInfo.setPipelined(path == PATH_PIPELINE);
+    QObject::connect(&audioInfo,
+                     SIGNAL( audioDataReady(const double *, size_t, float) ),
+                     &sweeper,
+                     SLOT( doBlock(const double *, size_t, float)),
+                     Qt::DirectConnection);
+  }
+  sweeper.start();
+  audioInfo.decode();
+  sweeper.finish();
+  for (int n = 0; n < sweeper.size(); n ++){
+    const unsigned int *h = sweeper.analyzer(n)->histogram;
+    histograms.append(QVector<unsigned int>(G_NUM_BINS_HIST_DEFAULT));
+    memcpy(histograms.last().data(), h, G_NUM_BINS_HIST_DEFAULT * sizeof(h[0]));
+  }
+  return histograms;
+}
+
+
+/* the pipelined decode, the queues of ALL_CHANNELS and the lanes of a sweep
+ * hand copies of the blocks to the analyzers, followers with a larger numPast
+ * look further back than their leader. every histogram has to be bitwise
+ * equal to the one of a direct run of its configuration alone. returns the
+ * number of differences */
+static int benchPaths(const QString &wavFile)
+{
+  const QString spec = "num-past=5,8;min-glitch=1,2";
+  const struct { const char *name; int path; int numThreads; } runs[] = {
+    {"direct", PATH_DIRECT, 1}, {"lanes", PATH_DIRECT, 2},
+    {"pipeline", PATH_PIPELINE, 1}, {"channels", PATH_CHANNELS, 1}};
+  int failures = 0;
+
+  printf("# paths: path\tconfigurations\tpulses\tmismatch\n");
+  /* the reference: each configuration on its own */
+  QVector<QVector<unsigned int> > reference;
+  PulseEvent pulseEvent;
+  BaseLine baseline;
+  defaultSettings(baseline, pulseEvent, P_PEAK_MODE_DEFAULT);
+  Sweeper labels(G_NUM_BINS_HIST_DEFAULT, NUM_FUTUREPAST_RINGBUF, NUM_ELEMENTS_RINGBUF, baseline);
+  QString error;
+  labels.setup(spec, pulseEvent, 1, &error);
+  for (int n = 0; n < labels.size(); n ++){
+    const QVector<QVector<unsigned int> > alone =
+      pathHistograms(wavFile, labels.label(n).replace(' ', ';'), 1, PATH_DIRECT);
+    if (alone.isEmpty()){
+      return(1);
+    }
+    reference.append(alone.first());
+  }
+  for (size_t r = 0; r < sizeof(runs) / sizeof(runs[0]); r ++){
+    const QVector<QVector<unsigned int> > histograms = pathHistograms(wavFile, spec, runs[r].numThreads, runs[r].path);
+    quint64 numPulses = 0;
+    int mismatch = 0;
+    for (int n = 0; n < reference.size(); n ++){
+      if ((n >= histograms.size()) || (histograms.at(n) != reference.at(n))){
+        fprintf(stderr, "paths: %s differs from a direct run of %s\n", runs[r].name, qPrintable(labels.label(n)));
+        mismatch ++;
+        continue;
+      }
+      for (int i = 0; i < histograms.at(n).size(); i ++){
+        numPulses += histograms.at(n).at(i);
+      }
+    }
+    failures += mismatch;
+    printf("paths\t%s\t%d\t%llu\t%d\n", runs[r].name, reference.size(), (unsigned long long)numPulses, mismatch);
+    QJsonObject row;
+    row["bench"] = "paths";
+    row["path"] = runs[r].name;
+    row["pulses"] = (double)(numPulses);
+    row["mismatch"] = mismatch;
+    addResult(row);
+  }
+  return(failures);
+}
+
+
+/* AudioInfo::decode() alone and with the analyzer connected (end to end) */
+static void benchFile(const QString &wavFile)
+{
+  printf("# file: stage\tsamples\tpulses\ttime[s]\tsamples/s\tpulses/s\tMB/s read\n");
+  for (int e = 0; e < 2; e ++){
+    AudioInfo audioInfo(NUM_ELEMENTS_RINGBUF, NUM_FUTUREPAST_RINGBUF);
+    if (!audioInfo.open(wavFile)){
+      fprintf(stderr, "cannot open %s\n", qPrintable(wavFile));
+      return;
+    }
+    BaseLine baseline;
+    PulseEvent pulseEvent;
+    defaultSettings(baseline, pulseEvent, P_PEAK_MODE_DEFAULT);
+    Analyzer analyzer(G_NUM_BINS_HIST_DEFAULT, NUM_FUTUREPAST_RINGBUF, NUM_ELEMENTS_RINGBUF,
+                      &baseline, &pulseEvent);
+    if (e == 1){
+      QObject::connect(&audioInfo,
+                       SIGNAL( audioDataReady(const double *, size_t, float) ),
+                       &analyzer,
+                       SLOT( doHistogram(const double *, size_t, float)),
+                       Qt::DirectConnection);
+    }
+    const quint64 numSamples = audioInfo.totalSamples();
+    QElapsedTimer timer;
+    timer.start();
+    audioInfo.decode();
+    const double secs = (double)(timer.nsecsElapsed()) * 1e-9;
+    quint64 numPulses = 0;
+    for (unsigned int i = 0; i < analyzer.histResolution; i ++){
+      numPulses += analyzer.histogram[i];
+    }
+    const char * stage = (e == 0) ? "decode" : "endtoend";
+    printf("file\t%s\t%llu\t%llu\t%.3f\t%.0f\t%.0f\t%.1f\n", stage,
+           (unsigned long long)numSamples, (unsigned long long)numPulses, secs,
+           secs > 0.0 ? (double)(numSamples) / secs : 0.0,
+           secs > 0.0 ? (double)(numPulses) / secs : 0.0, audioInfo.decodeRate());
+    QJsonObject row;
+    row["bench"] = stage;
+    row["samples"] = (double)(numSamples);
+    row["pulses"] = (double)(numPulses);
+    row["seconds"] = secs;
+    row["samplesPerSecond"] = secs > 0.0 ? (double)(numSamples) / secs : 0.0;
+    row["pulsesPerSecond"] = secs > 0.0 ? (double)(numPulses) / secs : 0.0;
+    row["readMBPerSecond"] = audioInfo.decodeRate();
+    addResult(row);
+  }
+}
+
+
+int main(int argc, char *argv[])
+{
+  QCoreApplication app(argc, argv);
+  QCoreApplication::setApplicationName("wav2phh-bench");
+
+  QCommandLineParser parser;
+  parser.setApplicationDescription("Microbenchmarks of the processing stages on a synthetic detector signal.");
+  parser.addHelpOption();
+  QCommandLineOption jsonOpt("json", "also write the results to <file> (json).", "file");
+  QCommandLineOption secondsOpt("seconds", "length of the synthetic signal in seconds (default 20).", "s");
+  QCommandLineOption rateOpt("rate", "mean pulses per second of the synthetic signal (default 1000).", "n");
+  QCommandLineOption seedOpt("seed", "seed of the synthetic signal (default 1).", "n");
+  QCommandLineOption keepOpt("keep-wav", "write the synthetic wav file to <file> and keep it.", "file");
+  parser.addOption(jsonOpt);
+  parser.addOption(secondsOpt);
+  parser.addOption(rateOpt);
+  parser.addOption(seedOpt);
+  parser.addOption(keepOpt);
+  parser.process(app);
+
+  PulseGenParams genParams;
+  if (parser.isSet(rateOpt)) genParams.rate = parser.value(rateOpt).toDouble();
+  if (parser.isSet(seedOpt)) genParams.seed = parser.value(seedOpt).toULongLong();
+  const double seconds = parser.isSet(secondsOpt) ? parser.value(secondsOpt).toDouble() : 20.0;
+  const quint64 numSamples = (quint64)(seconds * genParams.sampleRate);
+
+  /* the in memory benches use a few seconds of the same signal */
+  const int numMemory = (int)(qMin(numSamples, (quint64)(5 * genParams.sampleRate)));
+  QVector<double> signal(numMemory);
+  PulseGenerator(genParams).generate(signal.data(), numMemory);
+  PulseGenParams quietParams = genParams;
+  quietParams.rate = 0.0;
+  QVector<double> quiet(numMemory);
+  PulseGenerator(quietParams).generate(quiet.data(), numMemory);
+
+  const int pcmFailures = benchPcmConvert();
+  benchUpsample();
+  benchSpecialized();
+  benchPeakSearch();
+  benchBaseline(signal);
+  benchTrigger(signal, quiet);
+  const int prescanFailures = benchPrescan(signal);
+
+  const QString wavFile = parser.isSet(keepOpt) ? parser.value(keepOpt)
+                          : QDir(QDir::tempPath()).filePath("wav2phh-bench.wav");
+  PulseGenerator wavGen(genParams);
+  int pathFailures = 0;
+  if (wavGen.writeWav(wavFile, numSamples)){
+    benchFile(wavFile);
+    pathFailures = benchPaths(wavFile);
+  }
+  else{
+    fprintf(stderr, "cannot write %s\n", qPrintable(wavFile));
+  }
+  if (!parser.isSet(keepOpt)){
+    QFile::remove(wavFile);
+  }
+
+  if (parser.isSet(jsonOpt)){
+    PcmConverter converter(16);
+    Interpolator lti(P_IPLN_FAC_DEFAULT, P_WINDOW_SIZE_DEFAULT);
+    QJsonObject build;
+    build["compiler"] = __VERSION__;
+    build["qt"] = QT_VERSION_STR;
+    build["pcmKernel"] = converter.kernelName();
+    build["iplnKernel"] = lti.kernelName();
+    QJsonObject signalInfo;
+    signalInfo["sampleRate"] = genParams.sampleRate;
+    signalInfo["rate"] = genParams.rate;
+    signalInfo["seed"] = (double)(genParams.seed);
+    signalInfo["samples"] = (double)(numSamples);
+    signalInfo["pulses"] = (double)(wavGen.numPulses());
+    QJsonObject doc;
+    doc["build"] = build;
+    doc["signal"] = signalInfo;
+    doc["results"] = results;
+    QFile file(parser.value(jsonOpt));
+    if (!file.open(QIODevice::WriteOnly) ||
+        (file.write(QJsonDocument(doc).toJson()) < 0)){
+      fprintf(stderr, "cannot write %s\n", qPrintable(parser.value(jsonOpt)));
+      return 1;
+    }
+  }
+  /* a kernel or a path which does not match its reference fails the run */
+  return ((pcmFailures > 0) || (prescanFailures > 0) || (pathFailures > 0)) ? 1 : 0;
+}
@@ -0,0 +1,159 @@
+/** \file blockqueue.cpp
+ * \brief Lock-free hand over of sample blocks from the decoder to the analyzer
+ *
+ * \author Copyright (C) 2014 samplemaker
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1
+ * of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free
+ * Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA
+ *
+ * @{
+ */
+
+#include "blockqueue.h"
+
+/* rounds of busy waiting before a waiting side starts to sleep */
+#define BLOCK_QUEUE_SPINS 64
+
+
+BlockQueue::BlockQueue (size_t len, size_t num) {
+  blockLen = len;
+  numSlots = num;
+  ring = new Slot[numSlots];
+  for (size_t n = 0; n < numSlots; n ++){
+    ring[n].data = new double[blockLen];
+    ring[n].len = 0;
+    ring[n].percent = 0;
+  }
+  clear();
+}
+
+
+/* destructor */
+BlockQueue::~BlockQueue () {
+  for (size_t n = 0; n < numSlots; n ++){
+    delete[] ring[n].data;
+  }
+  delete[] ring;
+}
+
+
+/* only while neither side is running */
+void BlockQueue::clear() {
+  head.store(0);
+  tail.store(0);
+  closed.store(false);
+  producerStalls = 0;
+  consumerStalls = 0;
+  depthSum = 0;
+  maxDepth = 0;
+}
+
+
+void BlockQueue::backOff(int round) {
+  if (round < BLOCK_QUEUE_SPINS){
+    QThread::yieldCurrentThread();
+  }
+  else{
+    QThread::usleep(50);
+  }
+}
+
+
+double * BlockQueue::beginWrite() {
+  const size_t h = head.load(std::memory_order_relaxed);
+  size_t depth = h - tail.load(std::memory_order_acquire);
+  if (depth >= numSlots){
+    producerStalls ++;
+    for (int round = 0; depth >= numSlots; round ++){
+      backOff(round);
+      depth = h - tail.load(std::memory_order_acquire);
+    }
+  }
+  depthSum += depth;
+  if (depth > maxDepth){
+    maxDepth = depth;
+  }
+  return(ring[h % numSlots].data);
+}
+
+
+void BlockQueue::endWrite(size_t len, float percent) {
+  const size_t h = head.load(std::memory_order_relaxed);
+  ring[h % numSlots].len = len < blockLen ? len : blockLen;
+  ring[h % numSlots].percent = percent;
+  /* publishes the slot content */
+  head.store(h + 1, std::memory_order_release);
+}
+
+
+void BlockQueue::close() {
+  closed.store(true, std::memory_order_release);
+}
+
+
+const double * BlockQueue::beginRead(size_t *len, float *percent) {
+  const size_t t = tail.load(std::memory_order_relaxed);
+  if (t == head.load(std::memory_order_acquire)){
+    consumerStalls ++;
+    for (int round = 0; t == head.load(std::memory_order_acquire); round ++){
+      /* closed is set after the last head update: check head once more */
+      if (closed.load(std::memory_order_acquire) &&
+          (t == head.load(std::memory_order_acquire))){
+        return(NULL);
+      }
+      backOff(round);
+    }
+  }
+  const Slot &slot = ring[t % numSlots];
+  *len = slot.len;
+  *percent = slot.percent;
+  return(slot.data);
+}
+
+
+void BlockQueue::endRead() {
+  /* hands the slot back to the producer */
+  tail.store(tail.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+}
+
+
+/* call after both sides have finished */
+BlockQueueStats BlockQueue::stats() {
+  BlockQueueStats s;
+  s.numBlocks = head.load();
+  s.producerStalls = producerStalls;
+  s.consumerStalls = consumerStalls;
+  s.maxDepth = maxDepth;
+  s.meanDepth = s.numBlocks > 0 ? (double)(depthSum) / (double)(s.numBlocks) : 0.0;
+  return(s);
+}
+
+
+BlockConsumer::BlockConsumer(BlockQueue *queue, QObject *parent) :
+     QThread(parent)
+{
+    mQueue = queue;
+}
+
+
+void BlockConsumer::run(){
+    size_t len;
+    float percent;
+    const double * data;
+    while ((data = mQueue->beginRead(&len, &percent)) != NULL){
+        emit blockReady(data, len, percent);
+        mQueue->endRead();
+    }
+}
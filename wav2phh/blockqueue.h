@@ -0,0 +1,123 @@
+/** \file blockqueue.h
+ * \brief Lock-free hand over of sample blocks from the decoder to the analyzer
+ *
+ * \author Copyright (C) 2014 samplemaker
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1
+ * of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free
+ * Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA
+ *
+ * @{
+ */
+
+#ifndef BLOCKQUEUE_H
+#define BLOCKQUEUE_H
+
+#include <cstdlib>
+#include <atomic>
+#include <QThread>
+
+/* number of blocks in flight between decoder and analyzer (power of two) */
+#define BLOCK_QUEUE_SLOTS 16
+
+
+struct BlockQueueStats
+{
+    quint64 numBlocks;
+    /* producer found the queue full (back-pressure) / consumer found it empty */
+    quint64 producerStalls;
+    quint64 consumerStalls;
+    /* queue depth seen by the producer right before each push */
+    size_t maxDepth;
+    double meanDepth;
+};
+
+
+/**
+ *  Bounded single producer / single consumer queue of fixed size sample
+ *  blocks. All blocks are allocated upfront, the producer fills the slot at
+ *  the head in place and the consumer reads the slot at the tail in place.
+ *  The two indices are the only shared state: each one is written by one
+ *  side only (release) and read by the other (acquire), no locks involved.
+ *
+ *  A full queue blocks the producer (back-pressure), an empty one the
+ *  consumer. Both spin shortly and then sleep in small steps, a blocked side
+ *  does not burn a core.
+ **/
+class BlockQueue
+{
+
+  public:
+    /* constructor */
+    BlockQueue (size_t blockLen, size_t numSlots = BLOCK_QUEUE_SLOTS);
+    /* destructor */
+    ~BlockQueue ();
+    void clear();
+    /* producer: slot to fill, waits while the queue is full */
+    double * beginWrite();
+    void endWrite(size_t len, float percent);
+    /* producer: no more blocks will follow */
+    void close();
+    /* consumer: next block, waits while the queue is empty. returns NULL
+     * once the queue is closed and drained */
+    const double * beginRead(size_t *len, float *percent);
+    void endRead();
+    BlockQueueStats stats();
+  private:
+    struct Slot
+    {
+      double * data;
+      size_t len;
+      float percent;
+    };
+    Slot * ring;
+    size_t numSlots;
+    size_t blockLen;
+    /* head and tail on separate cache lines: no false sharing. padding
+     * instead of alignas, the object is created with plain new */
+    char pad0[64];
+    std::atomic<size_t> head;
+    char pad1[64];
+    std::atomic<size_t> tail;
+    char pad2[64];
+    std::atomic<bool> closed;
+    /* written by the producer only */
+    quint64 producerStalls;
+    quint64 depthSum;
+    size_t maxDepth;
+    /* written by the consumer only */
+    quint64 consumerStalls;
+    static void backOff(int round);
+};
+
+
+/* pops the blocks from the queue on its own thread and hands them on */
+class BlockConsumer : public QThread
+{
+    Q_OBJECT
+
+public:
+   explicit BlockConsumer(BlockQueue *queue, QObject *parent = 0);
+   void run();
+
+signals:
+   /* the block is only valid until the slot returns */
+   void blockReady(const double * data, size_t len, float percent);
+
+private:
+   BlockQueue * mQueue;
+};
+
+
+#endif
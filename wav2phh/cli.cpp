@@ -0,0 +1,1286 @@
+/** \file cli.cpp
+ * \brief Headless batch frontend: wav file in, pulse height histogram out
+ *
+ * \author Copyright (C) 2014 samplemaker
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1
+ * of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free
+ * Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA
+ *
+ * @{
+ */
+
+#include <stdio.h>
+#include <csignal>
+#include <cmath>
+#include <cstring>
+#include <algorithm>
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QElapsedTimer>
+#include <QSettings>
+#include <QFile>
+#include <QFileInfo>
+#include <QDir>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QTextStream>
+#include <QThreadPool>
+#include <QTimer>
+
+#include "alloccount.h"
+#include "analyzer.h"
+#include "audioinput.h"
+#include "eventlist.h"
+#include "resultcache.h"
+#include "segmentrunner.h"
+#include "sweeper.h"
+#include "timeslices.h"
+#include "verifier.h"
+
+
+/* all parameters a run depends on. the config file is read first,
+ * command line flags override single values */
+struct CliSettings
+{
+    BaseLine baseline;
+    PulseEvent pulseEvent;
+    double softGain;
+    unsigned int numBinsHist;
+};
+
+
+static void loadDefaults(CliSettings &s)
+{
+    s.baseline.value = 0;
+    s.baseline.diffThresh = B_DIFF_TRESH_DEFAULT;
+    s.baseline.relThresh = B_REL_THRESH_DEFAULT;
+    s.baseline.numMAvrg = B_NUM_AVRG_DEFAULT;
+    s.baseline.estimator = B_ESTIMATOR_DEFAULT;
+    s.pulseEvent.trigThresh = P_TRIG_THRESH_DEFAULT;
+    s.pulseEvent.numPast = P_NUM_PAST_DEFAULT;
+    s.pulseEvent.minGlitchFilter = P_MIN_GLITCH_DEFAULT;
+    s.pulseEvent.maxGlitchFilter = P_MAX_GLITCH_DEFAULT;
+    s.pulseEvent.iplnFactor = P_IPLN_FAC_DEFAULT;
+    s.pulseEvent.windowSize = P_WINDOW_SIZE_DEFAULT;
+    s.pulseEvent.peakMode = P_PEAK_MODE_DEFAULT;
+    s.softGain = G_SOFT_GAIN_DEFAULT;
+    s.numBinsHist = G_NUM_BINS_HIST_DEFAULT;
+}
+
+
+static bool parsePeakMode(const QString &name, int &peakMode)
+{
+    if (name == "upsample")
+        peakMode = PEAK_UPSAMPLE;
+    else if (name == "lazy")
+        peakMode = PEAK_LAZY;
+    else
+        return false;
+    return true;
+}
+
+
+static bool parseEstimator(const QString &name, int &estimator)
+{
+    const int all[] = {BASELINE_LEGACY, BASELINE_MEAN, BASELINE_EMA, BASELINE_MEDIAN};
+    for (size_t i = 0; i < sizeof(all) / sizeof(all[0]); i++){
+        if (name == BaselineEstimator::name(all[i])){
+            estimator = all[i];
+            return true;
+        }
+    }
+    return false;
+}
+
+
+/* a whole number >= 0. a typo is rejected instead of read as 0 */
+template <typename T>
+static bool parseCount(const QString &text, T &count)
+{
+    bool ok;
+    const uint value = text.trimmed().toUInt(&ok);
+    if (ok)
+        count = (T)(value);
+    return ok;
+}
+
+
+/* count from the config file, left as is if the key is missing */
+template <typename T>
+static bool iniCount(const QSettings &ini, const char *key, T &count)
+{
+    if (!ini.contains(key) || parseCount(ini.value(key).toString(), count))
+        return true;
+    fprintf(stderr, "%s: %s is not a whole number\n", qPrintable(ini.fileName()), key);
+    return false;
+}
+
+
+/* count from the command line, left as is if the option is not given */
+template <typename T>
+static bool optionCount(const QCommandLineParser &parser, const QCommandLineOption &option, T &count)
+{
+    if (!parser.isSet(option) || parseCount(parser.value(option), count))
+        return true;
+    fprintf(stderr, "--%s: a whole number\n", qPrintable(option.names().at(0)));
+    return false;
+}
+
+
+/* ini style config file, e.g.
+ *
+ * [baseline]
+ * diffThresh=0.005
+ * estimator=median
+ * [pulse]
+ * windowSize=22
+ * [general]
+ * numBinsHist=2048
+ *
+ * returns false if a count is not a whole number
+ */
+static bool loadConfig(CliSettings &s, const QString &fileName)
+{
+    QSettings ini(fileName, QSettings::IniFormat);
+    s.baseline.diffThresh = ini.value("baseline/diffThresh", s.baseline.diffThresh).toDouble();
+    s.baseline.relThresh = ini.value("baseline/relThresh", s.baseline.relThresh).toDouble();
+    bool ok = iniCount(ini, "baseline/numMAvrg", s.baseline.numMAvrg);
+    if (ini.contains("baseline/estimator") && !parseEstimator(ini.value("baseline/estimator").toString(), s.baseline.estimator))
+        fprintf(stderr, "%s: unknown estimator\n", qPrintable(fileName));
+    s.pulseEvent.trigThresh = ini.value("pulse/trigThresh", s.pulseEvent.trigThresh).toDouble();
+    ok = iniCount(ini, "pulse/numPast", s.pulseEvent.numPast) && ok;
+    ok = iniCount(ini, "pulse/minGlitchFilter", s.pulseEvent.minGlitchFilter) && ok;
+    ok = iniCount(ini, "pulse/maxGlitchFilter", s.pulseEvent.maxGlitchFilter) && ok;
+    ok = iniCount(ini, "pulse/iplnFactor", s.pulseEvent.iplnFactor) && ok;
+    ok = iniCount(ini, "pulse/windowSize", s.pulseEvent.windowSize) && ok;
+    if (ini.contains("pulse/peakMode") && !parsePeakMode(ini.value("pulse/peakMode").toString(), s.pulseEvent.peakMode))
+        fprintf(stderr, "%s: unknown peakMode\n", qPrintable(fileName));
+    s.softGain = ini.value("general/softGain", s.softGain).toDouble();
+    ok = iniCount(ini, "general/numBinsHist", s.numBinsHist) && ok;
+    return ok;
+}
+
+
+/* settings an analyzer can be built from. the gui spin boxes have the same
+ * minimums, here they come from the command line or a config file */
+static bool checkSettings(const CliSettings &s)
+{
+    bool ok = true;
+    if (s.pulseEvent.windowSize < 1){
+        fprintf(stderr, "--window-size: at least 1\n");
+        ok = false;
+    }
+    if (s.pulseEvent.iplnFactor < 1){
+        fprintf(stderr, "--ipln-factor: at least 1\n");
+        ok = false;
+    }
+    if (s.baseline.numMAvrg < 1){
+        fprintf(stderr, "--num-avrg: at least 1\n");
+        ok = false;
+    }
+    if (s.numBinsHist < 1){
+        fprintf(stderr, "--bins: at least 1\n");
+        ok = false;
+    }
+    if (s.pulseEvent.minGlitchFilter >= s.pulseEvent.maxGlitchFilter){
+        fprintf(stderr, "--min-glitch: below --max-glitch\n");
+        ok = false;
+    }
+    /* the samples in front of a trigger come from the past part of the block */
+    if (s.pulseEvent.numPast >= NUM_FUTUREPAST_RINGBUF / 2){
+        fprintf(stderr, "--num-past: below %d\n", NUM_FUTUREPAST_RINGBUF / 2);
+        ok = false;
+    }
+    return ok;
+}
+
+
+/* "low:high", either side may be left out */
+static bool parseRange(const QString &text, double &low, double &high)
+{
+    const QStringList parts = text.split(':');
+    if (parts.size() != 2)
+        return false;
+    bool okLow = true;
+    bool okHigh = true;
+    if (!parts.at(0).isEmpty())
+        low = parts.at(0).toDouble(&okLow);
+    if (!parts.at(1).isEmpty())
+        high = parts.at(1).toDouble(&okHigh);
+    return okLow && okHigh;
+}
+
+
+/* <n> samples or <x>s seconds */
+static bool parseSliceLength(const QString &text, double sampleRate, quint64 &numSamples)
+{
+    bool ok;
+    if (text.endsWith("s")){
+        const double secs = text.left(text.size() - 1).toDouble(&ok);
+        numSamples = (quint64)(secs * sampleRate + 0.5);
+    }
+    else
+        numSamples = text.toULongLong(&ok);
+    return ok && (numSamples > 0);
+}
+
+
+/* one column per histogram: bin, count of the first, count of the second, ... */
+static bool writeHistograms(const unsigned int * const *histograms, int numColumns,
+                            unsigned int numBins, const QString &fileName)
+{
+    QFile file;
+    bool opened;
+    if (fileName.isEmpty() || fileName == "-")
+        opened = file.open(stdout, QIODevice::WriteOnly | QIODevice::Text);
+    else{
+        file.setFileName(fileName);
+        opened = file.open(QIODevice::WriteOnly | QIODevice::Text);
+    }
+    if (!opened)
+        return false;
+    /* same format as MainWindow::saveFile for a single column */
+    QTextStream outPut(&file);
+    for (size_t i = 0; i < numBins; i++){
+        outPut << i;
+        for (int c = 0; c < numColumns; c++){
+            outPut << "\t" << histograms[c][i];
+        }
+        outPut << endl;
+    }
+    return true;
+}
+
+
+static bool writeHistogram(const unsigned int *histogram, unsigned int numBins, const QString &fileName)
+{
+    return writeHistograms(&histogram, 1, numBins, fileName);
+}
+
+
+static void unknownFormat(const QString &fileName)
+{
+    fprintf(stderr, "%s: unknown format: 8/16/24/32bit int or 32bit float, 1-%d channels - WAV only!\n",
+            qPrintable(fileName), WAV_MAX_CHANNELS);
+}
+
+
+/* --stats: the counters of the whole run as json, plus one entry per
+ * channel for multi channel files. nothing to do without a file name */
+static bool writeStats(const PipelineStats &total, const QVector<PipelineStats> &channels,
+                       const QString &fileName)
+{
+    fprintf(stderr, "%s\n", qPrintable(total.summary()));
+    if (fileName.isEmpty())
+        return true;
+    QJsonObject doc = total.toJson();
+    if (channels.size() > 1){
+        QJsonArray perChannel;
+        for (int c = 0; c < channels.size(); c++){
+            perChannel.append(channels.at(c).toJson());
+        }
+        doc["channels"] = perChannel;
+    }
+    QFile file(fileName);
+    if (!file.open(QIODevice::WriteOnly) ||
+        (file.write(QJsonDocument(doc).toJson()) < 0)){
+        fprintf(stderr, "cannot write %s\n", qPrintable(fileName));
+        return false;
+    }
+    return true;
+}
+
+
+static quint64 sumHistogram(const unsigned int *histogram, unsigned int numBins)
+{
+    quint64 sum = 0;
+    for (unsigned int i = 0; i < numBins; i++){
+        sum += histogram[i];
+    }
+    return sum;
+}
+
+
+/* expands wildcards (also on systems where the shell does not) and reads
+ * file lists: "@list.txt" stands for the paths in list.txt, one per line */
+static QStringList expandInputs(const QStringList &args)
+{
+    QStringList files;
+    for (int i = 0; i < args.size(); i++){
+        const QString arg = args.at(i);
+        if (arg.startsWith("@")){
+            QFile list(arg.mid(1));
+            if (!list.open(QIODevice::ReadOnly | QIODevice::Text)){
+                fprintf(stderr, "cannot read file list %s\n", qPrintable(arg.mid(1)));
+                continue;
+            }
+            QTextStream in(&list);
+            while (!in.atEnd()){
+                const QString line = in.readLine().trimmed();
+                if (!line.isEmpty() && !line.startsWith("#"))
+                    files << line;
+            }
+        }
+        else if (arg.contains('*') || arg.contains('?')){
+            const QFileInfo info(arg);
+            const QDir dir(info.path());
+            const QStringList names = dir.entryList(QStringList() << info.fileName(), QDir::Files, QDir::Name);
+            for (int n = 0; n < names.size(); n++)
+                files << dir.filePath(names.at(n));
+        }
+        else{
+            files << arg;
+        }
+    }
+    return files;
+}
+
+
+/* per file result of a batch run */
+struct BatchFile
+{
+    QString name;
+    quint64 numSamples;
+    int sampleRate;
+    int frameBytes;
+    int numSegments;
+    qint64 nsecs;
+    bool ok;
+    unsigned int * histogram;
+};
+
+
+/**
+ *  All files of a batch go through one thread pool. Files much larger than
+ *  the average share of a thread are split into segments (see segmentrunner.h
+ *  for the tolerance at the cuts), small files stay in one piece and are
+ *  therefore analyzed exactly as in a sequential run. The jobs are queued
+ *  largest first, idle threads pick the next one from the shared queue, so the
+ *  many small files fill up the gaps at the end.
+ **/
+static bool runBatch(const CliSettings &s, QList<BatchFile> &files, int numThreads,
+                     quint64 leadIn, int channel, unsigned int *total, PipelineStats &stats)
+{
+    quint64 numAll = 0;
+    for (int i = 0; i < files.size(); i++){
+        if (files.at(i).ok)
+            numAll += files.at(i).numSamples;
+    }
+    /* about four jobs per thread, but never segments that are mostly lead-in */
+    quint64 target = numAll / (4 * (quint64)(numThreads)) + 1;
+    const quint64 minSegment = 16 * (leadIn + NUM_ELEMENTS_RINGBUF);
+    if (target < minSegment)
+        target = minSegment;
+
+    QList<SegmentRunner *> runners;
+    for (int i = 0; i < files.size(); i++){
+        BatchFile &f = files[i];
+        if (!f.ok)
+            continue;
+        int numSegments = 1;
+        if ((numThreads > 1) && (f.numSamples > target + target / 2))
+            numSegments = (f.numSamples + target / 2) / target;
+        QList<Segment> segments = SegmentRunner::split(f.name, f.numSamples, numSegments, leadIn);
+        f.numSegments = segments.size();
+        for (int n = 0; n < segments.size(); n++){
+            segments[n].fileIndex = i;
+            segments[n].channel = channel;
+            runners.append(new SegmentRunner(segments.at(n), s.baseline, s.pulseEvent, s.softGain, s.numBinsHist));
+        }
+    }
+    /* longest processing time first */
+    std::sort(runners.begin(), runners.end(),
+              [](SegmentRunner *a, SegmentRunner *b){ return a->segment().count > b->segment().count; });
+
+    QThreadPool *pool = QThreadPool::globalInstance();
+    pool->setMaxThreadCount(numThreads);
+    for (int i = 0; i < runners.size(); i++){
+        pool->start(runners.at(i));
+    }
+    pool->waitForDone();
+
+    bool ok = true;
+    for (int i = 0; i < runners.size(); i++){
+        SegmentRunner *r = runners.at(i);
+        BatchFile &f = files[r->segment().fileIndex];
+        if (!r->ok){
+            f.ok = false;
+            ok = false;
+        }
+        f.nsecs += r->nsecs;
+        stats.add(r->stats);
+        for (unsigned int n = 0; n < s.numBinsHist; n++){
+            f.histogram[n] += r->histogram[n];
+            total[n] += r->histogram[n];
+        }
+        delete r;
+    }
+    return ok;
+}
+
+
+/* several files and/or several threads: everything goes through runBatch.
+ * the histogram summed over all files goes to outName */
+static int batchMain(const CliSettings &s, const QStringList &inputs, int numThreads,
+                     quint64 leadIn, int channel, const QString &outName, const QString &perFileDir,
+                     const QString &statsName)
+{
+    QElapsedTimer timer;
+    timer.start();
+    QList<BatchFile> files;
+    for (int i = 0; i < inputs.size(); i++){
+        BatchFile f;
+        f.name = inputs.at(i);
+        f.numSamples = 0;
+        f.sampleRate = 0;
+        f.frameBytes = 0;
+        f.numSegments = 0;
+        f.nsecs = 0;
+        f.histogram = new unsigned int[s.numBinsHist + 1]();
+        /* only the header is read here */
+        AudioInfo audioInfo(NUM_ELEMENTS_RINGBUF, NUM_FUTUREPAST_RINGBUF);
+        f.ok = audioInfo.open(f.name);
+        if (f.ok){
+            f.numSamples = audioInfo.totalSamples();
+            f.sampleRate = audioInfo.fileFormat().sampleRate();
+            f.frameBytes = audioInfo.fileFormat().bytesPerFrame();
+            if (!audioInfo.selectChannel(channel)){
+                fprintf(stderr, "%s: has no channel %d\n", qPrintable(f.name), channel);
+                f.ok = false;
+            }
+        }
+        else{
+            unknownFormat(f.name);
+        }
+        files.append(f);
+    }
+
+    if (!perFileDir.isEmpty())
+        QDir().mkpath(perFileDir);
+    unsigned int * total = new unsigned int[s.numBinsHist + 1]();
+    PipelineStats stats;
+    bool ok = runBatch(s, files, numThreads, leadIn, channel, total, stats);
+    const double secs = (double)(timer.nsecsElapsed()) * 1e-9;
+
+    if (!writeHistogram(total, s.numBinsHist, outName)){
+        fprintf(stderr, "cannot write %s\n", qPrintable(outName));
+        ok = false;
+    }
+
+    /* summary: live time from the sample rate, throughput per thread time */
+    quint64 numAllSamples = 0;
+    double numAllBytes = 0;
+    double allLive = 0.0;
+    fprintf(stderr, "file\tsamples\tlive [s]\tpulses\trate [1/s]\tsegments\tthread time [s]\tsamples/s\n");
+    for (int i = 0; i < files.size(); i++){
+        const BatchFile &f = files.at(i);
+        if (f.ok && !perFileDir.isEmpty()){
+            const QString name = QDir(perFileDir).filePath(QFileInfo(f.name).completeBaseName() + ".csv");
+            if (!writeHistogram(f.histogram, s.numBinsHist, name)){
+                fprintf(stderr, "cannot write %s\n", qPrintable(name));
+                ok = false;
+            }
+        }
+        const quint64 numPulses = sumHistogram(f.histogram, s.numBinsHist);
+        const double live = f.sampleRate > 0 ? (double)(f.numSamples) / f.sampleRate : 0.0;
+        const double busy = (double)(f.nsecs) * 1e-9;
+        fprintf(stderr, "%s\t%llu\t%.3f\t%llu\t%.1f\t%d\t%.3f\t%.0f%s\n", qPrintable(f.name),
+                (unsigned long long)f.numSamples, live, (unsigned long long)numPulses,
+                live > 0.0 ? (double)(numPulses) / live : 0.0, f.numSegments, busy,
+                busy > 0.0 ? (double)(f.numSamples) / busy : 0.0, f.ok ? "" : "\tFAILED");
+        delete[] f.histogram;
+        if (f.ok){
+            numAllSamples += f.numSamples;
+            numAllBytes += (double)(f.numSamples) * f.frameBytes;
+            allLive += live;
+        }
+    }
+    const quint64 numPulses = sumHistogram(total, s.numBinsHist);
+    delete[] total;
+    fprintf(stderr, "files: %d, samples: %llu, live: %.3f s, pulses: %llu, time: %.3f s, %.0f samples/s, %.1f MB/s read, %d threads\n",
+            (int)(files.size()), (unsigned long long)numAllSamples, allLive,
+            (unsigned long long)numPulses, secs,
+            secs > 0.0 ? (double)(numAllSamples) / secs : 0.0,
+            secs > 0.0 ? numAllBytes * 1e-6 / secs : 0.0, numThreads);
+    if (!writeStats(stats, QVector<PipelineStats>(), statsName))
+        ok = false;
+    return ok ? 0 : 1;
+}
+
+
+/**
+ *  A multi channel file (one detector per channel) is read once: AudioInfo
+ *  deinterleaves the frames and hands the blocks of channel c through a queue
+ *  to a consumer thread of its own, which runs analyzer c. The histograms are
+ *  written side by side, one column per channel.
+ **/
+static int channelsMain(CliSettings &s, AudioInfo &audioInfo, const QString &outName,
+                        const QString &statsName)
+{
+    const int numChannels = audioInfo.fileFormat().channelCount();
+    const quint64 numSamples = audioInfo.totalSamples();
+    audioInfo.resetSoftGain(s.softGain);
+    audioInfo.selectChannel(ALL_CHANNELS);
+    /* every analyzer works on a baseline of its own */
+    QVector<BaseLine> baselines(numChannels, s.baseline);
+    QVector<Analyzer *> analyzers;
+    QVector<const unsigned int *> histograms;
+    for (int c = 0; c < numChannels; c++){
+        Analyzer *analyzer = new Analyzer(s.numBinsHist, NUM_FUTUREPAST_RINGBUF, NUM_ELEMENTS_RINGBUF,
+                                          &baselines[c], &s.pulseEvent);
+        QObject::connect(audioInfo.channelOutput(c),
+                         SIGNAL( blockReady(const double *, size_t, float) ),
+                         analyzer,
+                         SLOT( doHistogram(const double *, size_t, float)),
+                         Qt::DirectConnection);
+        analyzers.append(analyzer);
+        histograms.append(analyzer->histogram);
+    }
+
+    QElapsedTimer timer;
+    timer.start();
+    audioInfo.decode();
+    const double secs = (double)(timer.nsecsElapsed()) * 1e-9;
+
+    int result = 0;
+    if (!writeHistograms(histograms.constData(), numChannels, s.numBinsHist, outName)){
+        fprintf(stderr, "cannot write %s\n", qPrintable(outName));
+        result = 1;
+    }
+    fprintf(stderr, "samples: %llu x %d channels, time: %.3f s, %.0f samples/s, %.1f MB/s read\n",
+            (unsigned long long)numSamples, numChannels, secs,
+            secs > 0.0 ? (double)(numSamples) * numChannels / secs : 0.0, audioInfo.decodeRate());
+    PipelineStats stats = audioInfo.statistics();
+    QVector<PipelineStats> perChannel;
+    for (int c = 0; c < numChannels; c++){
+        fprintf(stderr, "channel %d: pulses: %llu\n", c,
+                (unsigned long long)sumHistogram(analyzers.at(c)->histogram, analyzers.at(c)->histResolution));
+        analyzers.at(c)->publishStatistics();
+        perChannel.append(analyzers.at(c)->statistics());
+        stats.add(perChannel.last());
+        delete analyzers.at(c);
+    }
+    if (!writeStats(stats, perChannel, statsName))
+        result = 1;
+    return result;
+}
+
+
+/**
+ *  Runs the legacy engine and a fast one on the same blocks of one channel.
+ *  Both histograms are written side by side (legacy first), the differences
+ *  go to stderr. Returns 2 if the engines disagree.
+ **/
+static int verifyMain(CliSettings &s, AudioInfo &audioInfo, int engine,
+                      const QString &engineName, const QString &outName)
+{
+    audioInfo.resetSoftGain(s.softGain);
+    Verifier verifier(s.numBinsHist, NUM_FUTUREPAST_RINGBUF, NUM_ELEMENTS_RINGBUF,
+                      s.baseline, s.pulseEvent, engine);
+    QObject::connect(&audioInfo,
+                     SIGNAL( audioDataReady(const double *, size_t, float) ),
+                     &verifier,
+                     SLOT( doBlock(const double *, size_t, float)),
+                     Qt::DirectConnection);
+    audioInfo.decode();
+
+    const unsigned int *histograms[2] = {verifier.legacy->histogram, verifier.fast->histogram};
+    int result = 0;
+    if (!writeHistograms(histograms, 2, s.numBinsHist, outName)){
+        fprintf(stderr, "cannot write %s\n", qPrintable(outName));
+        result = 1;
+    }
+
+    unsigned int numBinDiffs = 0;
+    for (unsigned int k = 0; k < s.numBinsHist; k++){
+        if (histograms[0][k] != histograms[1][k])
+            numBinDiffs++;
+    }
+    const double legacySecs = (double)(verifier.legacyNsecs) * 1e-9;
+    const double fastSecs = (double)(verifier.fastNsecs) * 1e-9;
+    fprintf(stderr, "verify legacy / %s: pulses: %llu / %llu, %llu pulses disagree, %u bins differ, max height difference %.3g\n",
+            qPrintable(engineName),
+            (unsigned long long)sumHistogram(histograms[0], s.numBinsHist),
+            (unsigned long long)sumHistogram(histograms[1], s.numBinsHist),
+            (unsigned long long)verifier.numMismatches, numBinDiffs, verifier.maxHeightDiff);
+    fprintf(stderr, "time: legacy %.3f s, %s %.3f s, speedup %.2f\n",
+            legacySecs, qPrintable(engineName), fastSecs, fastSecs > 0.0 ? legacySecs / fastSecs : 0.0);
+    const double sampleRate = (double)(audioInfo.fileFormat().sampleRate());
+    for (int n = 0; n < verifier.mismatches.size(); n++){
+        const PulseMismatch &m = verifier.mismatches.at(n);
+        fprintf(stderr, "  pulse at sample %lld (%.6f s): ", (long long)m.trigPos,
+                sampleRate > 0.0 ? (double)(m.trigPos) / sampleRate : 0.0);
+        if (m.fastBin == VERIFY_NO_PULSE)
+            fprintf(stderr, "legacy only, bin %d (%.9f)\n", m.legacyBin, m.legacyHeight);
+        else if (m.legacyBin == VERIFY_NO_PULSE)
+            fprintf(stderr, "%s only, bin %d (%.9f)\n", qPrintable(engineName), m.fastBin, m.fastHeight);
+        else
+            fprintf(stderr, "bin %d (%.9f) / %d (%.9f)\n", m.legacyBin, m.legacyHeight, m.fastBin, m.fastHeight);
+    }
+    if (verifier.numMismatches > (quint64)(verifier.mismatches.size()))
+        fprintf(stderr, "  ... %llu more\n", (unsigned long long)(verifier.numMismatches - verifier.mismatches.size()));
+    for (unsigned int k = 0, shown = 0; (k < s.numBinsHist) && (shown < VERIFY_MAX_LISTED); k++){
+        if (histograms[0][k] != histograms[1][k]){
+            fprintf(stderr, "  bin %u: %u / %u\n", k, histograms[0][k], histograms[1][k]);
+            shown++;
+        }
+    }
+    if ((result == 0) && ((verifier.numMismatches > 0) || (numBinDiffs > 0)))
+        result = 2;
+    return result;
+}
+
+
+/**
+ *  Runs all configurations of the --sweep spec over one decode of one
+ *  channel. The histograms are written side by side in the order of the
+ *  table, the table with the figures of merit of each one goes to stderr.
+ **/
+static int sweepMain(CliSettings &s, AudioInfo &audioInfo, const QString &spec, int numThreads,
+                     double peakLow, double peakHigh, const QString &outName)
+{
+    Sweeper sweeper(s.numBinsHist, NUM_FUTUREPAST_RINGBUF, NUM_ELEMENTS_RINGBUF, s.baseline);
+    QString error;
+    if (!sweeper.setup(spec, s.pulseEvent, numThreads, &error)){
+        fprintf(stderr, "--sweep: %s\n", qPrintable(error));
+        return 1;
+    }
+    audioInfo.resetSoftGain(s.softGain);
+    QObject::connect(&audioInfo,
+                     SIGNAL( audioDataReady(const double *, size_t, float) ),
+                     &sweeper,
+                     SLOT( doBlock(const double *, size_t, float)),
+                     Qt::DirectConnection);
+    QElapsedTimer timer;
+    timer.start();
+    sweeper.start();
+    audioInfo.decode();
+    sweeper.finish();
+    const double secs = (double)(timer.nsecsElapsed()) * 1e-9;
+
+    QVector<const unsigned int *> histograms;
+    for (int n = 0; n < sweeper.size(); n++){
+        histograms.append(sweeper.analyzer(n)->histogram);
+    }
+    int result = 0;
+    if (!writeHistograms(histograms.constData(), sweeper.size(), s.numBinsHist, outName)){
+        fprintf(stderr, "cannot write %s\n", qPrintable(outName));
+        result = 1;
+    }
+    const quint64 numSamples = audioInfo.totalSamples();
+    fprintf(stderr, "samples: %llu, %d configurations in %d trigger groups on %d threads, time: %.3f s, %.0f samples/s\n",
+            (unsigned long long)numSamples, sweeper.size(), sweeper.numGroups(), sweeper.numLanes(), secs,
+            secs > 0.0 ? (double)(numSamples) / secs : 0.0);
+    const unsigned int first = (unsigned int)(qBound(0.0, peakLow, 1.0) * s.numBinsHist);
+    const unsigned int last = (unsigned int)(qBound(0.0, peakHigh, 1.0) * s.numBinsHist);
+    fprintf(stderr, "#col\ttriggers\taccepted\tcounts\tpeak\tfwhm\tres%%\tarea\tsettings\n");
+    for (int n = 0; n < sweeper.size(); n++){
+        Analyzer *analyzer = sweeper.analyzer(n);
+        analyzer->publishStatistics();
+        const PipelineStats stats = analyzer->statistics();
+        const SweepFom fom = Sweeper::figureOfMerit(analyzer->histogram, first, last);
+        fprintf(stderr, "%d\t%llu\t%llu\t%llu\t%u\t%.2f\t%.2f\t%llu\t%s\n", n + 1,
+                (unsigned long long)stats.triggers, (unsigned long long)stats.accepted,
+                (unsigned long long)fom.counts, fom.peakBin, fom.fwhm, fom.resolution,
+                (unsigned long long)fom.peakArea, qPrintable(sweeper.label(n)));
+    }
+    return result;
+}
+
+
+/* --events: the settings of the run go into the header, rebinning falls
+ * back to them */
+static EventListHeader eventHeader(const CliSettings &s, double sampleRate)
+{
+    EventListHeader header;
+    memset(&header, 0, sizeof(header));
+    header.sampleRate = sampleRate;
+    header.histResolution = s.numBinsHist;
+    header.numPast = (quint32)(s.pulseEvent.numPast);
+    header.minGlitchFilter = (quint32)(s.pulseEvent.minGlitchFilter);
+    header.maxGlitchFilter = (quint32)(s.pulseEvent.maxGlitchFilter);
+    header.trigThresh = s.pulseEvent.trigThresh;
+    header.iplnWidth = EVENTLIST_IPLN_WIDTH;
+    return header;
+}
+
+
+/* what --rebin changes, everything else is taken from the event files */
+struct RebinOptions
+{
+    unsigned int histResolution;    /* 0: as recorded */
+    int minGlitchFilter;            /* -1: as recorded */
+    int maxGlitchFilter;
+    double minHeight;
+    double maxHeight;
+    bool timeWindow;
+    double fromSecs;
+    double toSecs;
+};
+
+
+/* --rebin: one histogram from the events of all files (e.g. the segments of
+ * a long measurement). the settings of the first file apply to all. a glitch
+ * window wider than the recording's admits rejected pulses, which carry an
+ * interpolated height only up to the width in the header: wider ones are
+ * counted with their sample extrema and a warning tells how many */
+static int rebinMain(const QStringList &inputs, const RebinOptions &opt, const QString &outName)
+{
+    RebinSettings r;
+    unsigned int *histogram = NULL;
+    quint64 numEvents = 0;
+    quint64 numCounted = 0;
+    quint64 numDiscrete = 0;
+    qint64 nsecs = 0;
+    for (int i = 0; i < inputs.size(); i++){
+        EventList list;
+        if (!list.open(inputs.at(i))){
+            delete[] histogram;
+            return 1;
+        }
+        const EventListHeader &h = list.header();
+        if (histogram == NULL){
+            r.histResolution = (opt.histResolution > 0) ? opt.histResolution : h.histResolution;
+            r.minGlitchFilter = (opt.minGlitchFilter >= 0) ? (quint32)(opt.minGlitchFilter) : h.minGlitchFilter;
+            r.maxGlitchFilter = (opt.maxGlitchFilter >= 0) ? (quint32)(opt.maxGlitchFilter) : h.maxGlitchFilter;
+            r.minHeight = opt.minHeight;
+            r.maxHeight = opt.maxHeight;
+            histogram = new unsigned int[r.histResolution + 1]();
+        }
+        r.countBegin = Q_INT64_C(-0x7fffffffffffffff);
+        r.countEnd = Q_INT64_C(0x7fffffffffffffff);
+        if (opt.timeWindow){
+            if (h.sampleRate <= 0.0){
+                fprintf(stderr, "%s: sample rate unknown, no time window\n", qPrintable(inputs.at(i)));
+                delete[] histogram;
+                return 1;
+            }
+            if (std::isfinite(opt.fromSecs))
+                r.countBegin = (qint64)(ceil(opt.fromSecs * h.sampleRate));
+            if (std::isfinite(opt.toSecs))
+                r.countEnd = (qint64)(ceil(opt.toSecs * h.sampleRate));
+        }
+        if (list.approximate(r))
+            fprintf(stderr, "%s: warning: the glitch filter %u .. %u admits rejected pulses wider than %u samples, "
+                    "their heights are not interpolated\n",
+                    qPrintable(inputs.at(i)), r.minGlitchFilter, r.maxGlitchFilter, list.iplnWidth());
+        QElapsedTimer timer;
+        timer.start();
+        quint64 discrete = 0;
+        numCounted += list.rebin(r, histogram, &discrete);
+        numDiscrete += discrete;
+        nsecs += timer.nsecsElapsed();
+        numEvents += list.size();
+    }
+    int result = 0;
+    if (!writeHistogram(histogram, r.histResolution, outName)){
+        fprintf(stderr, "cannot write %s\n", qPrintable(outName));
+        result = 1;
+    }
+    const double secs = (double)(nsecs) * 1e-9;
+    const double numBytes = (double)(numEvents) * (double)(EventList::chunkBytes(EVENTLIST_CHUNK)) / EVENTLIST_CHUNK;
+    fprintf(stderr, "events: %llu, counted: %llu, bins: %u, glitch filter: %u .. %u, time: %.3f s, %.0f events/s, %.2f GB/s\n",
+            (unsigned long long)numEvents, (unsigned long long)numCounted, r.histResolution,
+            r.minGlitchFilter, r.maxGlitchFilter, secs,
+            secs > 0.0 ? (double)(numEvents) / secs : 0.0, secs > 0.0 ? numBytes * 1e-9 / secs : 0.0);
+    if (numDiscrete > 0)
+        fprintf(stderr, "warning: %llu counted pulses have sample heights only (not interpolated)\n",
+                (unsigned long long)numDiscrete);
+    delete[] histogram;
+    return result;
+}
+
+
+struct LiveOptions
+{
+    QString replayFile;
+    QString deviceName;
+    int sampleRate;
+    int msecs;
+    int channel;
+    bool pipelined;
+    QString statsName;
+};
+
+
+#define LIVE_SIGNAL_POLL_MSECS 100
+
+/* set by SIGINT / SIGTERM. the handler only sets the flag, the event loop of
+ * liveMain polls it. a second signal ends the process the default way */
+static volatile sig_atomic_t liveInterrupted = 0;
+
+
+static void liveSignal(int sig)
+{
+    liveInterrupted = 1;
+    signal(sig, SIG_DFL);
+}
+
+
+/* live mode: runs the AudioInfo thread with an event loop in main until the
+ * duration has passed, the replayed file ended or the device failed */
+static int liveMain(QCoreApplication &app, CliSettings &s, const LiveOptions &live, const QString &outName)
+{
+    AudioInfo audioInfo(NUM_ELEMENTS_LIVE, NUM_FUTUREPAST_LIVE);
+    if (!live.replayFile.isEmpty()){
+        if (!audioInfo.open(live.replayFile)){
+            unknownFormat(live.replayFile);
+            return 1;
+        }
+        if (!audioInfo.selectChannel(live.channel)){
+            fprintf(stderr, "%s: has no channel %d\n", qPrintable(live.replayFile), live.channel);
+            return 1;
+        }
+        audioInfo.setReplay(true);
+    }
+    else{
+        QAudioDeviceInfo device = QAudioDeviceInfo::defaultInputDevice();
+        if (!live.deviceName.isEmpty()){
+            const QList<QAudioDeviceInfo> devices = QAudioDeviceInfo::availableDevices(QAudio::AudioInput);
+            device = QAudioDeviceInfo();
+            for (int i = 0; i < devices.size(); i++){
+                if (devices.at(i).deviceName() == live.deviceName)
+                    device = devices.at(i);
+            }
+        }
+        if (device.isNull() || !audioInfo.openDevice(device, live.sampleRate)){
+            fprintf(stderr, "no usable capture device %s\n", qPrintable(live.deviceName));
+            return 1;
+        }
+    }
+    audioInfo.resetSoftGain(s.softGain);
+    audioInfo.setPipelined(live.pipelined);
+
+    Analyzer analyzer(s.numBinsHist, NUM_FUTUREPAST_LIVE, NUM_ELEMENTS_LIVE, &s.baseline, &s.pulseEvent);
+    QObject::connect(&audioInfo,
+                     SIGNAL( audioDataReady(const double *, size_t, float) ),
+                     &analyzer,
+                     SLOT( doHistogram(const double *, size_t, float)),
+                     Qt::DirectConnection);
+    QObject::connect(&audioInfo, SIGNAL( decodeFinished() ), &app, SLOT( quit() ), Qt::QueuedConnection);
+    if (live.msecs > 0){
+        QTimer::singleShot(live.msecs, [&audioInfo](){ audioInfo.stopProcess(); });
+    }
+    /* ctrl-c ends the run like --duration: histogram, latencies and stats
+     * are still written */
+    liveInterrupted = 0;
+    signal(SIGINT, liveSignal);
+    signal(SIGTERM, liveSignal);
+    QTimer interruptPoll;
+    interruptPoll.setInterval(LIVE_SIGNAL_POLL_MSECS);
+    QObject::connect(&interruptPoll, &QTimer::timeout, [&audioInfo, &interruptPoll](){
+        if (liveInterrupted){
+            fprintf(stderr, "interrupted, stopping\n");
+            interruptPoll.stop();
+            audioInfo.stopProcess();
+        }
+    });
+    interruptPoll.start();
+    audioInfo.start();
+    app.exec();
+    audioInfo.wait();
+    signal(SIGINT, SIG_DFL);
+    signal(SIGTERM, SIG_DFL);
+
+    if (!writeHistogram(analyzer.histogram, analyzer.histResolution, outName)){
+        fprintf(stderr, "cannot write %s\n", qPrintable(outName));
+        return 1;
+    }
+    const LatencyStats &lat = audioInfo.latencyStats();
+    fprintf(stderr, "pulses: %llu, blocks: %llu, overruns: %llu\n",
+            (unsigned long long)sumHistogram(analyzer.histogram, analyzer.histResolution),
+            (unsigned long long)lat.count(), (unsigned long long)audioInfo.overruns());
+    fprintf(stderr, "latency sample to histogram [ms]: p50 %.1f, p90 %.1f, p99 %.1f, max %.1f\n",
+            lat.percentile(50) * 1e-6, lat.percentile(90) * 1e-6,
+            lat.percentile(99) * 1e-6, lat.max() * 1e-6);
+    analyzer.publishStatistics();
+    PipelineStats stats = audioInfo.statistics();
+    stats.add(analyzer.statistics());
+    if (!writeStats(stats, QVector<PipelineStats>(), live.statsName))
+        return 1;
+    return 0;
+}
+
+
+int main(int argc, char *argv[])
+{
+  /* argument parsing. only the live mode runs the event loop (liveMain) */
+  QCoreApplication app(argc, argv);
+  QCoreApplication::setApplicationName("wav2phh-cli");
+
+  QCommandLineParser parser;
+  parser.setApplicationDescription("Converts a wav record into a pulse height histogram.");
+  parser.addHelpOption();
+  parser.addPositionalArgument("wavfiles", "wav records (8/16/24/32bit int or 32bit float, up to 8 channels). wildcards and @filelist are accepted.");
+  QCommandLineOption configOpt(QStringList() << "c" << "config", "Read the settings from an ini <file>.", "file");
+  QCommandLineOption outOpt(QStringList() << "o" << "output", "Write the histogram to <file> (default: stdout).", "file");
+  QCommandLineOption diffThreshOpt("diff-thresh", "baseline: differential threshold.", "value");
+  QCommandLineOption relThreshOpt("abs-thresh", "baseline: absolute threshold.", "value");
+  QCommandLineOption numAvrgOpt("num-avrg", "baseline: number of samples in the moving average.", "n");
+  QCommandLineOption estimatorOpt("baseline", "baseline: estimator, 'legacy' (default), 'mean', 'ema' or 'median'.", "name");
+  QCommandLineOption trigThreshOpt("trig-thresh", "pulse: trigger threshold.", "value");
+  QCommandLineOption numPastOpt("num-past", "pulse: extra samples to the left and right.", "n");
+  QCommandLineOption minGlitchOpt("min-glitch", "pulse: minimum samples per pulse.", "n");
+  QCommandLineOption maxGlitchOpt("max-glitch", "pulse: maximum samples per pulse.", "n");
+  QCommandLineOption iplnOpt("ipln-factor", "pulse: interpolation factor.", "k");
+  QCommandLineOption windowOpt("window-size", "pulse: half the window size of the low pass filter.", "n");
+  QCommandLineOption peakModeOpt("peak-mode", "pulse: height estimation, 'upsample' (default) or 'lazy'.", "mode");
+  QCommandLineOption gainOpt("soft-gain", "amplification of the audio stream.", "value");
+  QCommandLineOption binsOpt("bins", "number of bins in the histogram.", "n");
+  QCommandLineOption threadsOpt("threads", "analyze on <n> threads, large files are split into segments (0: all cores, default 1).", "n");
+  QCommandLineOption leadInOpt("lead-in", "samples decoded in front of each segment to settle the baseline.", "n");
+  QCommandLineOption liveOpt("live", "live mode: analyze the default capture device (or --device) until --duration has passed.");
+  QCommandLineOption deviceOpt("device", "live mode: name of the capture device.", "name");
+  QCommandLineOption rateOpt("rate", "live mode: sample rate of the capture device (default 48000).", "Hz");
+  QCommandLineOption replayOpt("replay", "live mode: replay the wav file at its real speed instead of a capture device.");
+  QCommandLineOption durationOpt("duration", "live mode: stop after <s> seconds.", "s");
+  QCommandLineOption pipelineOpt("pipeline", "decode and analyze on two threads connected by a block queue.");
+  QCommandLineOption channelOpt("channel", "analyze channel <n> only (default: all channels of a single file, one histogram column each; 0 in batch and live mode).", "n");
+  QCommandLineOption statsOpt("stats", "write the counters (triggers, rejected pulses, ...) and the time spent per stage as json to <file>.", "file");
+  QCommandLineOption verifyOpt("verify", "run the legacy engine and <engine> ('default', 'polyphase', 'fixed' or 'lazy') side by side on one channel and report the differences.", "engine");
+  QCommandLineOption eventsOpt("events", "list mode: also write every pulse (accepted or rejected) to the event file <file>. one file and channel only.", "file");
+  QCommandLineOption rebinOpt("rebin", "the inputs are event files (--events): rebuild the histogram with --bins, --min-glitch, --max-glitch and the windows below.");
+  QCommandLineOption heightWindowOpt("height-window", "rebin: count pulse heights in <low:high> only (full scale 1).", "range");
+  QCommandLineOption timeWindowOpt("time-window", "rebin: count pulses triggered in <from:to> seconds only.", "range");
+  QCommandLineOption noCacheOpt("no-cache", "always analyze, neither look up nor store the result in the result cache.");
+  QCommandLineOption cacheDirOpt("cache-dir", "keep the result cache in <dir> (default: wav2phh/results in the user's cache directory).", "dir");
+  QCommandLineOption cacheSizeOpt("cache-size", "limit the result cache to <MB> (default 64).", "MB");
+  QCommandLineOption sweepOpt("sweep", "run many settings over one decode of one channel, e.g. 'trig-thresh=0.01,0.015;ipln-factor=4:16:4' (also num-past, min-glitch, max-glitch, window-size, peak-mode). one histogram column per setting, the figures of merit go to stderr.", "spec");
+  QCommandLineOption peakWindowOpt("peak-window", "sweep: look for the peak in heights <low:high> only (full scale 1).", "range");
+  QCommandLineOption sidecarOpt("sidecar", "keep the samples of the channel in <wav>.<channel>.f32 next to the record, later runs read them instead of decoding (integers up to 24 bit and float).");
+  QCommandLineOption slicesOpt("slices", "also write a histogram per time slice to <file> (slice, start in s, bin, count of the non empty bins). one file and channel only.", "file");
+  QCommandLineOption sliceLengthOpt("slice-length", "slices: length in samples, or in seconds with a trailing s (default 60s).", "length");
+  QCommandLineOption perFileOpt("per-file", "batch: also write one histogram per input file into <dir>.", "dir");
+  parser.addOption(configOpt);
+  parser.addOption(outOpt);
+  parser.addOption(diffThreshOpt);
+  parser.addOption(relThreshOpt);
+  parser.addOption(numAvrgOpt);
+  parser.addOption(estimatorOpt);
+  parser.addOption(trigThreshOpt);
+  parser.addOption(numPastOpt);
+  parser.addOption(minGlitchOpt);
+  parser.addOption(maxGlitchOpt);
+  parser.addOption(iplnOpt);
+  parser.addOption(windowOpt);
+  parser.addOption(peakModeOpt);
+  parser.addOption(gainOpt);
+  parser.addOption(binsOpt);
+  parser.addOption(threadsOpt);
+  parser.addOption(leadInOpt);
+  parser.addOption(channelOpt);
+  parser.addOption(perFileOpt);
+  parser.addOption(verifyOpt);
+  parser.addOption(sweepOpt);
+  parser.addOption(peakWindowOpt);
+  parser.addOption(statsOpt);
+  parser.addOption(eventsOpt);
+  parser.addOption(noCacheOpt);
+  parser.addOption(cacheDirOpt);
+  parser.addOption(cacheSizeOpt);
+  parser.addOption(rebinOpt);
+  parser.addOption(heightWindowOpt);
+  parser.addOption(timeWindowOpt);
+  parser.addOption(sidecarOpt);
+  parser.addOption(slicesOpt);
+  parser.addOption(sliceLengthOpt);
+  parser.addOption(pipelineOpt);
+  parser.addOption(liveOpt);
+  parser.addOption(deviceOpt);
+  parser.addOption(rateOpt);
+  parser.addOption(replayOpt);
+  parser.addOption(durationOpt);
+  parser.process(app);
+
+  const QStringList args = parser.positionalArguments();
+  if (args.isEmpty() && !parser.isSet(liveOpt)){
+    parser.showHelp(1);
+  }
+
+  CliSettings s;
+  loadDefaults(s);
+  if (parser.isSet(configOpt) && !loadConfig(s, parser.value(configOpt)))
+    return 1;
+  if (parser.isSet(diffThreshOpt)) s.baseline.diffThresh = parser.value(diffThreshOpt).toDouble();
+  if (parser.isSet(relThreshOpt)) s.baseline.relThresh = parser.value(relThreshOpt).toDouble();
+  if (!optionCount(parser, numAvrgOpt, s.baseline.numMAvrg))
+    return 1;
+  if (parser.isSet(estimatorOpt) && !parseEstimator(parser.value(estimatorOpt), s.baseline.estimator)){
+    fprintf(stderr, "unknown baseline estimator %s\n", qPrintable(parser.value(estimatorOpt)));
+    return 1;
+  }
+  if (parser.isSet(trigThreshOpt)) s.pulseEvent.trigThresh = parser.value(trigThreshOpt).toDouble();
+  if (!optionCount(parser, numPastOpt, s.pulseEvent.numPast) ||
+      !optionCount(parser, minGlitchOpt, s.pulseEvent.minGlitchFilter) ||
+      !optionCount(parser, maxGlitchOpt, s.pulseEvent.maxGlitchFilter) ||
+      !optionCount(parser, iplnOpt, s.pulseEvent.iplnFactor) ||
+      !optionCount(parser, windowOpt, s.pulseEvent.windowSize))
+    return 1;
+  if (parser.isSet(peakModeOpt) && !parsePeakMode(parser.value(peakModeOpt), s.pulseEvent.peakMode)){
+    fprintf(stderr, "unknown peak mode %s\n", qPrintable(parser.value(peakModeOpt)));
+    return 1;
+  }
+  if (parser.isSet(gainOpt)) s.softGain = parser.value(gainOpt).toDouble();
+  if (!optionCount(parser, binsOpt, s.numBinsHist) || !checkSettings(s))
+    return 1;
+
+  int numThreads = 1;
+  if (parser.isSet(threadsOpt)){
+    numThreads = parser.value(threadsOpt).toInt();
+    if (numThreads <= 0)
+      numThreads = QThread::idealThreadCount();
+  }
+  quint64 leadIn = SEGMENT_LEAD_IN_DEFAULT;
+  if (parser.isSet(leadInOpt)) leadIn = parser.value(leadInOpt).toULongLong();
+  const int channel = parser.isSet(channelOpt) ? parser.value(channelOpt).toInt() : 0;
+
+  if (parser.isSet(liveOpt) || parser.isSet(replayOpt)){
+    LiveOptions live;
+    live.replayFile = parser.isSet(replayOpt) && !args.isEmpty() ? args.at(0) : QString();
+    live.deviceName = parser.value(deviceOpt);
+    live.sampleRate = parser.isSet(rateOpt) ? parser.value(rateOpt).toInt() : 48000;
+    live.msecs = parser.isSet(durationOpt) ? (int)(parser.value(durationOpt).toDouble() * 1000.0) : 0;
+    live.channel = channel;
+    live.pipelined = parser.isSet(pipelineOpt);
+    live.statsName = parser.value(statsOpt);
+    if (parser.isSet(replayOpt) && live.replayFile.isEmpty()){
+      fprintf(stderr, "--replay needs a wav file\n");
+      return 1;
+    }
+    return liveMain(app, s, live, parser.value(outOpt));
+  }
+
+  const QStringList inputs = expandInputs(args);
+  if (inputs.isEmpty()){
+    fprintf(stderr, "no input files\n");
+    return 1;
+  }
+  if (parser.isSet(rebinOpt)){
+    RebinOptions rebin;
+    rebin.histResolution = parser.isSet(binsOpt) ? s.numBinsHist : 0;
+    rebin.minGlitchFilter = parser.isSet(minGlitchOpt) ? (int)(s.pulseEvent.minGlitchFilter) : -1;
+    rebin.maxGlitchFilter = parser.isSet(maxGlitchOpt) ? (int)(s.pulseEvent.maxGlitchFilter) : -1;
+    rebin.minHeight = -HUGE_VAL;
+    rebin.maxHeight = HUGE_VAL;
+    rebin.timeWindow = parser.isSet(timeWindowOpt);
+    rebin.fromSecs = -HUGE_VAL;
+    rebin.toSecs = HUGE_VAL;
+    if ((parser.isSet(heightWindowOpt) && !parseRange(parser.value(heightWindowOpt), rebin.minHeight, rebin.maxHeight)) ||
+        (rebin.timeWindow && !parseRange(parser.value(timeWindowOpt), rebin.fromSecs, rebin.toSecs))){
+      fprintf(stderr, "a window is given as <low:high>\n");
+      return 1;
+    }
+    return rebinMain(inputs, rebin, parser.value(outOpt));
+  }
+  if (parser.isSet(sweepOpt) && ((inputs.size() > 1) || parser.isSet(eventsOpt) || parser.isSet(verifyOpt))){
+    fprintf(stderr, "--sweep: one input file, no --events or --verify\n");
+    return 1;
+  }
+  if (parser.isSet(eventsOpt) && ((inputs.size() > 1) || (numThreads > 1) || parser.isSet(verifyOpt))){
+    fprintf(stderr, "--events: one input file on one thread only\n");
+    return 1;
+  }
+  if (parser.isSet(slicesOpt) && ((inputs.size() > 1) || (numThreads > 1) || parser.isSet(verifyOpt) ||
+                                  parser.isSet(sweepOpt))){
+    fprintf(stderr, "--slices: one input file on one thread only, no --verify or --sweep\n");
+    return 1;
+  }
+  if (((inputs.size() > 1) || (numThreads > 1)) && !parser.isSet(sweepOpt)){
+    return batchMain(s, inputs, numThreads, leadIn, channel, parser.value(outOpt), parser.value(perFileOpt),
+                     parser.value(statsOpt));
+  }
+
+  AudioInfo audioInfo(NUM_ELEMENTS_RINGBUF, NUM_FUTUREPAST_RINGBUF);
+  if (!audioInfo.open(inputs.at(0))){
+    unknownFormat(inputs.at(0));
+    return 1;
+  }
+  const int numChannels = audioInfo.fileFormat().channelCount();
+  if (!parser.isSet(channelOpt) && (numChannels > 1) && (parser.isSet(eventsOpt) || parser.isSet(slicesOpt))){
+    fprintf(stderr, "--events, --slices: choose a --channel of %s\n", qPrintable(inputs.at(0)));
+    return 1;
+  }
+  if (!parser.isSet(channelOpt) && (numChannels > 1) && !parser.isSet(verifyOpt) && !parser.isSet(sweepOpt)){
+    return channelsMain(s, audioInfo, parser.value(outOpt), parser.value(statsOpt));
+  }
+  if (!audioInfo.selectChannel(channel)){
+    fprintf(stderr, "%s: has no channel %d\n", qPrintable(inputs.at(0)), channel);
+    return 1;
+  }
+  if (parser.isSet(sidecarOpt))
+    audioInfo.setSidecar(SIDECAR_FILE);
+  if (parser.isSet(sweepOpt)){
+    double peakLow = 0.0;
+    double peakHigh = 1.0;
+    if (parser.isSet(peakWindowOpt) && !parseRange(parser.value(peakWindowOpt), peakLow, peakHigh)){
+      fprintf(stderr, "a window is given as <low:high>\n");
+      return 1;
+    }
+    return sweepMain(s, audioInfo, parser.value(sweepOpt), numThreads, peakLow, peakHigh, parser.value(outOpt));
+  }
+  if (parser.isSet(verifyOpt)){
+    const int engine = Verifier::engineByName(parser.value(verifyOpt));
+    if (engine < 0){
+      fprintf(stderr, "unknown engine: %s\n", qPrintable(parser.value(verifyOpt)));
+      return 1;
+    }
+    return verifyMain(s, audioInfo, engine, parser.value(verifyOpt), parser.value(outOpt));
+  }
+  audioInfo.resetSoftGain(s.softGain);
+  audioInfo.setPipelined(parser.isSet(pipelineOpt));
+  const quint64 numSamples = audioInfo.totalSamples();
+
+  /* a run with the same data and settings before: its histogram and
+   * statistics instead of a decode */
+  ResultCache cache(parser.value(cacheDirOpt));
+  if (parser.isSet(cacheSizeOpt)){
+    bool ok;
+    const qint64 megaBytes = parser.value(cacheSizeOpt).toLongLong(&ok);
+    if (!ok || (megaBytes <= 0) || (megaBytes > Q_INT64_C(0x7fffffffffffffff) / (1024 * 1024))){
+      fprintf(stderr, "--cache-size: a positive number of MB\n");
+      return 1;
+    }
+    cache.setLimits(megaBytes * 1024 * 1024, RESULT_CACHE_MAX_ENTRIES);
+  }
+  const bool useCache = !parser.isSet(noCacheOpt) && !parser.isSet(eventsOpt) && !parser.isSet(slicesOpt) &&
+                        !AllocCounter::isEnabled();
+  const QString cacheParameters = ResultCache::parameters(s.baseline, s.pulseEvent, s.softGain, s.numBinsHist,
+                                                         channel);
+  QString cacheKey;
+  if (useCache){
+    /* the file is not read for the key: without a remembered content hash
+     * there is nothing to look up, decode() hashes the data as it reads it */
+    cacheKey = cache.knownKey(inputs.at(0), audioInfo.headerLength(), audioInfo.dataLength(), cacheParameters);
+    audioInfo.setContentHash(cacheKey.isEmpty());
+    QVector<unsigned int> histogram(s.numBinsHist);
+    PipelineStats stats;
+    if (cache.lookup(cacheKey, histogram.data(), s.numBinsHist, &stats)){
+      if (!writeHistogram(histogram.constData(), s.numBinsHist, parser.value(outOpt))){
+        fprintf(stderr, "cannot write %s\n", qPrintable(parser.value(outOpt)));
+        return 1;
+      }
+      fprintf(stderr, "samples: %llu, pulses: %llu, from the result cache in %s\n",
+              (unsigned long long)numSamples, (unsigned long long)sumHistogram(histogram.constData(), s.numBinsHist),
+              qPrintable(cache.directory()));
+      return writeStats(stats, QVector<PipelineStats>(), parser.value(statsOpt)) ? 0 : 1;
+    }
+  }
+
+  Analyzer analyzer(s.numBinsHist, NUM_FUTUREPAST_RINGBUF, NUM_ELEMENTS_RINGBUF, &s.baseline, &s.pulseEvent);
+  /* nobody polls the snapshots: the result is read after decode() */
+  QObject::connect(&audioInfo,
+                   SIGNAL( audioDataReady(const double *, size_t, float) ),
+                   &analyzer,
+                   SLOT( doHistogram(const double *, size_t, float)),
+                   Qt::DirectConnection);
+  EventListWriter events;
+  if (parser.isSet(eventsOpt)){
+    if (!events.open(parser.value(eventsOpt), eventHeader(s, (double)(audioInfo.fileFormat().sampleRate()))))
+      return 1;
+    analyzer.setEventList(&events);
+  }
+  const double sampleRate = (double)(audioInfo.fileFormat().sampleRate());
+  TimeSlices slices;
+  if (parser.isSet(slicesOpt)){
+    quint64 sliceLength;
+    const QString lengthText = parser.isSet(sliceLengthOpt) ? parser.value(sliceLengthOpt)
+                                                            : QString("%1s").arg(TIMESLICES_SECONDS_DEFAULT);
+    if (!parseSliceLength(lengthText, sampleRate, sliceLength)){
+      fprintf(stderr, "a slice length is given as <samples> or <seconds>s\n");
+      return 1;
+    }
+    slices.reset(s.numBinsHist, sliceLength);
+    analyzer.setTimeSlices(&slices);
+  }
+  /* called after the analyzer: the first block is the warm up, everything
+   * allocated between the end of the first and the end of the last block
+   * belongs to the steady state */
+  size_t numBlocks = 0;
+  size_t allocsWarm = 0;
+  size_t allocsLast = 0;
+  if (AllocCounter::isEnabled()){
+    QObject::connect(&audioInfo, &AudioInfo::audioDataReady,
+                     [&](const double *, size_t, float){
+                       allocsLast = AllocCounter::count();
+                       if (numBlocks++ == 0)
+                         allocsWarm = allocsLast;
+                     });
+  }
+
+  /* run the decoder in the calling thread instead of start()ing the QThread */
+  QElapsedTimer timer;
+  timer.start();
+  audioInfo.decode();
+  const qint64 nsecs = timer.nsecsElapsed();
+
+  if (!writeHistogram(analyzer.histogram, analyzer.histResolution, parser.value(outOpt))){
+    fprintf(stderr, "cannot write %s\n", qPrintable(parser.value(outOpt)));
+    return 1;
+  }
+  if (parser.isSet(eventsOpt)){
+    const quint64 numEvents = events.size();
+    if (!events.close()){
+      fprintf(stderr, "cannot write %s\n", qPrintable(parser.value(eventsOpt)));
+      return 1;
+    }
+    fprintf(stderr, "events: %llu written to %s\n", (unsigned long long)numEvents, qPrintable(parser.value(eventsOpt)));
+  }
+  if (parser.isSet(slicesOpt)){
+    slices.finish(numSamples);
+    if (!slices.save(parser.value(slicesOpt), sampleRate)){
+      fprintf(stderr, "cannot write %s\n", qPrintable(parser.value(slicesOpt)));
+      return 1;
+    }
+    fprintf(stderr, "slices: %llu of %llu samples, %llu non empty bins written to %s\n",
+            (unsigned long long)slices.size(), (unsigned long long)slices.sliceLength(),
+            (unsigned long long)slices.numEntries(), qPrintable(parser.value(slicesOpt)));
+  }
+
+  const quint64 numPulses = sumHistogram(analyzer.histogram, analyzer.histResolution);
+  const double secs = (double)(nsecs) * 1e-9;
+  fprintf(stderr, "samples: %llu, pulses: %llu, time: %.3f s, %.0f samples/s, %.1f MB/s read\n",
+          (unsigned long long)numSamples, (unsigned long long)numPulses, secs,
+          secs > 0.0 ? (double)(numSamples) / secs : 0.0, audioInfo.decodeRate());
+  fprintf(stderr, "interpolation kernel: %s\n", analyzer.kernelName());
+  if (audioInfo.usedSidecar())
+    fprintf(stderr, "samples from %s\n", qPrintable(SampleSidecar::fileNameFor(inputs.at(0), channel)));
+  if (parser.isSet(pipelineOpt)){
+    const BlockQueueStats q = audioInfo.queueStats();
+    fprintf(stderr, "queue: %llu blocks, depth mean %.2f max %llu of %d, decoder waited %llu times, analyzer waited %llu times\n",
+            (unsigned long long)q.numBlocks, q.meanDepth, (unsigned long long)q.maxDepth, BLOCK_QUEUE_SLOTS,
+            (unsigned long long)q.producerStalls, (unsigned long long)q.consumerStalls);
+  }
+  if (AllocCounter::isEnabled()){
+    fprintf(stderr, "heap allocations: %llu total (%llu bytes), %llu in %llu blocks after warm up\n",
+            (unsigned long long)AllocCounter::count(), (unsigned long long)AllocCounter::bytes(),
+            (unsigned long long)(allocsLast - allocsWarm), (unsigned long long)(numBlocks > 0 ? numBlocks - 1 : 0));
+  }
+  /* the analyzer is done (or its consumer thread has been joined) */
+  analyzer.publishStatistics();
+  PipelineStats stats = audioInfo.statistics();
+  stats.add(analyzer.statistics());
+  if (useCache){
+    /* a file seen for the first time. no hash if the sidecar served the run */
+    quint64 contentHash;
+    if (cacheKey.isEmpty() && audioInfo.contentHash(&contentHash))
+      cacheKey = cache.remember(inputs.at(0), audioInfo.headerLength(), audioInfo.dataLength(), contentHash,
+                                cacheParameters);
+    cache.store(cacheKey, analyzer.histogram, analyzer.histResolution, stats);
+  }
+  if (!writeStats(stats, QVector<PipelineStats>(), parser.value(statsOpt)))
+    return 1;
+
+  return 0;
+}
@@ -0,0 +1,139 @@
+/** \file contenthash.h
+ * \brief xxhash64 of the data region of a file, the content key of the result cache
+ *
+ * \author Copyright (C) 2014 samplemaker
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1
+ * of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free
+ * Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA
+ *
+ * @{
+ */
+
+#ifndef CONTENTHASH_H
+#define CONTENTHASH_H
+
+#include <cstring>
+#include <QtGlobal>
+#include <QtCore/qendian.h>
+
+#define PRIME64_1 Q_UINT64_C(0x9E3779B185EBCA87)
+#define PRIME64_2 Q_UINT64_C(0xC2B2AE3D27D4EB4F)
+#define PRIME64_3 Q_UINT64_C(0x165667B19E3779F9)
+#define PRIME64_4 Q_UINT64_C(0x85EBCA77C2B2AE63)
+#define PRIME64_5 Q_UINT64_C(0x27D4EB2F165667C5)
+
+
+static inline quint64 rotl64(quint64 x, int r)
+{
+  return((x << r) | (x >> (64 - r)));
+}
+
+
+static inline quint64 round64(quint64 acc, quint64 input)
+{
+  acc += input * PRIME64_2;
+  return(rotl64(acc, 31) * PRIME64_1);
+}
+
+
+static inline quint64 merge64(quint64 acc, quint64 value)
+{
+  acc ^= round64(0, value);
+  return(acc * PRIME64_1 + PRIME64_4);
+}
+
+
+/* xxhash64 with seed 0: four independent lanes over stripes of 32 bytes,
+ * fed in pieces of any size. the result does not depend on the split */
+class ContentHash
+{
+
+  public:
+    ContentHash () {
+      v[0] = PRIME64_1 + PRIME64_2;
+      v[1] = PRIME64_2;
+      v[2] = 0;
+      v[3] = (quint64)(0) - PRIME64_1;
+      total = 0;
+      fill = 0;
+    }
+    void add(const uchar *data, quint64 length){
+      total += length;
+      if (fill > 0){
+        const size_t num = (size_t)(qMin((quint64)(32 - fill), length));
+        memcpy(tail + fill, data, num);
+        fill += num;
+        data += num;
+        length -= num;
+        if (fill < 32){
+          return;
+        }
+        stripe(tail);
+        fill = 0;
+      }
+      for (; length >= 32; data += 32, length -= 32){
+        stripe(data);
+      }
+      memcpy(tail, data, (size_t)(length));
+      fill = (size_t)(length);
+    }
+    quint64 result(){
+      quint64 h;
+      if (total >= 32){
+        h = rotl64(v[0], 1) + rotl64(v[1], 7) + rotl64(v[2], 12) + rotl64(v[3], 18);
+        for (int i = 0; i < 4; i ++){
+          h = merge64(h, v[i]);
+        }
+      }
+      else{
+        h = PRIME64_5;
+      }
+      h += total;
+      size_t n = 0;
+      for (; n + 8 <= fill; n += 8){
+        h ^= round64(0, qFromLittleEndian<quint64>(tail + n));
+        h = rotl64(h, 27) * PRIME64_1 + PRIME64_4;
+      }
+      if (n + 4 <= fill){
+        h ^= (quint64)(qFromLittleEndian<quint32>(tail + n)) * PRIME64_1;
+        h = rotl64(h, 23) * PRIME64_2 + PRIME64_3;
+        n += 4;
+      }
+      for (; n < fill; n ++){
+        h ^= tail[n] * PRIME64_5;
+        h = rotl64(h, 11) * PRIME64_1;
+      }
+      h ^= h >> 33;
+      h *= PRIME64_2;
+      h ^= h >> 29;
+      h *= PRIME64_3;
+      h ^= h >> 32;
+      return(h);
+    }
+  private:
+    quint64 v[4];
+    quint64 total;
+    uchar tail[32];
+    size_t fill;
+    inline void stripe(const uchar *p){
+      v[0] = round64(v[0], qFromLittleEndian<quint64>(p));
+      v[1] = round64(v[1], qFromLittleEndian<quint64>(p + 8));
+      v[2] = round64(v[2], qFromLittleEndian<quint64>(p + 16));
+      v[3] = round64(v[3], qFromLittleEndian<quint64>(p + 24));
+    }
+};
+
+
+#endif
@@ -0,0 +1,221 @@
+/** \file eventlist.cpp
+ * \brief List mode file of the pulse events for re-binning without re-decoding
+ *
+ * \author Copyright (C) 2014 samplemaker
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1
+ * of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free
+ * Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA
+ *
+ * @{
+ */
+
+#include <cstddef>
+#include <cstring>
+#include <QDebug>
+#include "eventlist.h"
+
+#define d2i(x) ((x)<0?(int)((x)-0.5):(int)((x)+0.5))
+
+
+/* the columns of a chunk of num events starting at base */
+static void chunkColumns(char *base, size_t num, EventColumns *columns)
+{
+  columns->trigPos = (qint64 *)(base);
+  columns->max = (double *)(base + num * 8);
+  columns->min = (double *)(base + num * 16);
+  columns->baseline = (double *)(base + num * 24);
+  columns->width = (quint32 *)(base + num * 32);
+  columns->flags = (quint8 *)(base + num * 36);
+}
+
+
+EventListWriter::EventListWriter () {
+  memset(&info, 0, sizeof(info));
+  chunk = new char[EventList::chunkBytes(EVENTLIST_CHUNK)]();
+  chunkColumns(chunk, EVENTLIST_CHUNK, &columns);
+  fill = 0;
+  ok = false;
+}
+
+
+/* destructor */
+EventListWriter::~EventListWriter () {
+  if (file.isOpen()){
+    close();
+  }
+  delete[] chunk;
+}
+
+
+bool EventListWriter::open(const QString &fileName, const EventListHeader &header){
+  info = header;
+  memcpy(info.magic, EVENTLIST_MAGIC, sizeof(info.magic));
+  info.version = EVENTLIST_VERSION;
+  info.chunkEvents = EVENTLIST_CHUNK;
+  info.numEvents = 0;
+  memset(info.reserved, 0, sizeof(info.reserved));
+  fill = 0;
+  file.setFileName(fileName);
+  ok = file.open(QIODevice::WriteOnly | QIODevice::Truncate) &&
+       (file.write((const char *)(&info), sizeof(info)) == sizeof(info));
+  if (!ok){
+    qWarning() << "cannot write event list" << fileName;
+  }
+  return(ok);
+}
+
+
+/* the whole chunk goes out, padding included. then the count in the header
+ * is brought up to date */
+void EventListWriter::writeChunk(){
+  const qint64 numBytes = (qint64)(EventList::chunkBytes(EVENTLIST_CHUNK));
+  if (ok){
+    ok = (file.write(chunk, numBytes) == numBytes);
+  }
+  info.numEvents += fill;
+  fill = 0;
+  if (ok){
+    const qint64 end = file.pos();
+    ok = file.seek(offsetof(EventListHeader, numEvents)) &&
+         (file.write((const char *)(&info.numEvents), sizeof(info.numEvents)) == sizeof(info.numEvents)) &&
+         file.seek(end);
+  }
+  if (!ok){
+    qWarning() << "event list: write failed," << info.numEvents << "events";
+  }
+}
+
+
+bool EventListWriter::close(){
+  if (fill > 0){
+    writeChunk();
+  }
+  file.close();
+  return(ok);
+}
+
+
+EventList::EventList () {
+  memset(&info, 0, sizeof(info));
+  data = NULL;
+}
+
+
+/* destructor */
+EventList::~EventList () {
+  if (data != NULL){
+    file.unmap(data);
+  }
+}
+
+
+size_t EventList::chunkBytes(size_t chunkEvents){
+  /* 8 + 8 + 8 + 8 + 4 + 1 bytes per event, padded to 64 */
+  return((37 * chunkEvents + 63) & ~(size_t)(63));
+}
+
+
+bool EventList::open(const QString &fileName){
+  file.setFileName(fileName);
+  if (!file.open(QIODevice::ReadOnly) ||
+      (file.read((char *)(&info), sizeof(info)) != sizeof(info))){
+    qWarning() << "cannot read event list" << fileName;
+    return(false);
+  }
+  if ((memcmp(info.magic, EVENTLIST_MAGIC, sizeof(info.magic)) != 0) ||
+      (info.version != EVENTLIST_VERSION) || (info.chunkEvents == 0) ||
+      (info.chunkEvents % 64 != 0)){
+    qWarning() << fileName << "is no event list of this version";
+    return(false);
+  }
+  const qint64 numBytes = sizeof(info) + (qint64)(numChunks()) * chunkBytes(info.chunkEvents);
+  if (file.size() < numBytes){
+    qWarning() << fileName << "is truncated";
+    return(false);
+  }
+  if (info.numEvents == 0){
+    return(true);
+  }
+  data = file.map(0, numBytes);
+  if (data == NULL){
+    qWarning() << "cannot map" << fileName;
+    return(false);
+  }
+  return(true);
+}
+
+
+size_t EventList::chunk(size_t n, EventColumns *columns){
+  const size_t chunkSize = info.chunkEvents;
+  chunkColumns((char *)(data + sizeof(info) + n * chunkBytes(chunkSize)), chunkSize, columns);
+  const quint64 first = (quint64)(n) * chunkSize;
+  return((size_t)(qMin((quint64)(chunkSize), info.numEvents - first)));
+}
+
+
+quint32 EventList::iplnWidth(){
+  return((info.iplnWidth > 0) ? info.iplnWidth : (quint32)(EVENTLIST_IPLN_WIDTH));
+}
+
+
+/* widths w with min < w < max are counted. the recording interpolated all
+ * widths up to iplnWidth() and those within its own glitch window */
+bool EventList::approximate(const RebinSettings &s){
+  const quint64 lo = qMax((quint64)(s.minGlitchFilter), (quint64)(iplnWidth())) + 1;
+  const quint64 hi = s.maxGlitchFilter;
+  if (lo >= hi){
+    return(false);
+  }
+  return((lo <= info.minGlitchFilter) || (hi > info.maxGlitchFilter));
+}
+
+
+/**
+ *  The height is binned exactly as Analyzer::doHistogram does it (same
+ *  float cast), so with the settings of the recording run the histogram
+ *  comes out the same. Other glitch limits give the histogram of a run with
+ *  these limits, except where a peak sample of an accepted pulse took part
+ *  in the baseline (rare: the peak is above the trigger threshold). The lazy
+ *  peak mode keeps the sample extrema of pulses which are out of range at the
+ *  recording, at a finer resolution the top bin may differ.
+ *  Rejected pulses are interpolated up to iplnWidth() samples, wider (and
+ *  truncated) ones keep the extrema of their samples: a glitch window beyond
+ *  that limit counts them with these heights, not as a new analysis would.
+ *
+ *  The loop has no data dependent branches: a pulse which is not counted
+ *  goes to the extra bin behind the histogram.
+ **/
+quint64 EventList::rebin(const RebinSettings &s, unsigned int *histogram, quint64 *numDiscrete){
+  const unsigned int numBins = s.histResolution;
+  quint64 numCounted = 0;
+  quint64 discrete = 0;
+  for (size_t c = 0; c < numChunks(); c ++){
+    EventColumns col;
+    const size_t num = chunk(c, &col);
+    for (size_t n = 0; n < num; n ++){
+      const double height = col.max[n] - col.min[n];
+      const int index = (int)(d2i((float)(numBins * height)));
+      const bool counted = (col.width[n] > s.minGlitchFilter) & (col.width[n] < s.maxGlitchFilter) &
+                           (col.trigPos[n] >= s.countBegin) & (col.trigPos[n] < s.countEnd) &
+                           (height >= s.minHeight) & (height <= s.maxHeight) &
+                           (index >= 0) & (index < (int)(numBins));
+      histogram[counted ? index : numBins] ++;
+      numCounted += counted;
+      discrete += counted & ((col.flags[n] & (EVENT_ACCEPTED | EVENT_DISCRETE)) == EVENT_DISCRETE);
+    }
+  }
+  *numDiscrete = discrete;
+  return(numCounted);
+}
@@ -0,0 +1,178 @@
+/** \file eventlist.h
+ * \brief List mode file of the pulse events for re-binning without re-decoding
+ *
+ * \author Copyright (C) 2014 samplemaker
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1
+ * of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free
+ * Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA
+ *
+ * @{
+ */
+
+#ifndef EVENTLIST_H
+#define EVENTLIST_H
+
+#include <cstdlib>
+#include <QtGlobal>
+#include <QFile>
+#include <QString>
+
+#define EVENTLIST_MAGIC "W2PHEVT1"
+#define EVENTLIST_VERSION 1
+/* events per chunk, a multiple of 64: every column of every chunk starts on
+ * a cache line */
+#define EVENTLIST_CHUNK 16384
+/* rejected pulses up to this width are interpolated like accepted ones,
+ * longer ones keep the extrema of their samples (EVENT_DISCRETE) */
+#define EVENTLIST_IPLN_WIDTH 64
+
+enum EVENT_FLAGS {
+    EVENT_ACCEPTED = 1,     /* passed the glitch filter of the recording run */
+    EVENT_TRUNCATED = 2,    /* the pulse ran over the end of the block */
+    EVENT_DISCRETE = 4      /* max / min of the samples, not of the reconstruction */
+};
+
+
+/* the first 64 bytes of the file, host byte order */
+struct EventListHeader
+{
+    char magic[8];
+    quint32 version;
+    quint32 chunkEvents;
+    quint64 numEvents;
+    double sampleRate;          /* 0 if unknown */
+    /* settings of the run which wrote the file */
+    quint32 histResolution;
+    quint32 numPast;
+    quint32 minGlitchFilter;
+    quint32 maxGlitchFilter;
+    double trigThresh;
+    /* rejected pulses up to this width are interpolated (EVENTLIST_IPLN_WIDTH).
+     * 0 in files of earlier builds, see EventList::iplnWidth() */
+    quint32 iplnWidth;
+    quint8 reserved[4];
+};
+
+
+/* the columns of one chunk. height = max - min, as in the analyzer */
+struct EventColumns
+{
+    qint64 * trigPos;       /* absolute sample index of the trigger */
+    double * max;
+    double * min;
+    double * baseline;      /* at the trigger */
+    quint32 * width;        /* samples without the extra ones in the past & future */
+    quint8 * flags;         /* EVENT_FLAGS */
+};
+
+
+/* what the histogram is rebuilt with. a pulse is counted if its width passes
+ * the glitch filter, its trigger lies in [countBegin, countEnd) and its
+ * height in [minHeight, maxHeight] */
+struct RebinSettings
+{
+    unsigned int histResolution;
+    quint32 minGlitchFilter;
+    quint32 maxGlitchFilter;
+    double minHeight;
+    double maxHeight;
+    qint64 countBegin;
+    qint64 countEnd;
+};
+
+
+/**
+ *  Struct of arrays in chunks of EVENTLIST_CHUNK events: the header is
+ *  followed by full size chunks, each holding the columns of EventColumns
+ *  one after the other. The last chunk is padded, numEvents tells how much
+ *  of it is used. Thus the file can be mapped as is and every column of a
+ *  chunk is a plain array.
+ *
+ *  The writer fills one chunk in memory and writes it once it is full.
+ *  numEvents in the header is updated with every chunk, so a file of an
+ *  aborted run is readable up to its last complete chunk.
+ **/
+class EventListWriter
+{
+
+  public:
+    /* constructor */
+    EventListWriter ();
+    /* destructor */
+    ~EventListWriter ();
+    /* header: the settings fields, the rest is filled in */
+    bool open(const QString &fileName, const EventListHeader &header);
+    inline void append(qint64 trigPos, double max, double min, double baseline, size_t width, int flags){
+      columns.trigPos[fill] = trigPos;
+      columns.max[fill] = max;
+      columns.min[fill] = min;
+      columns.baseline[fill] = baseline;
+      columns.width[fill] = (width > 0xffffffff) ? 0xffffffff : (quint32)(width);
+      columns.flags[fill] = (quint8)(flags);
+      if (++fill == EVENTLIST_CHUNK){
+        writeChunk();
+      }
+    }
+    /* writes the last chunk, false if anything could not be written */
+    bool close();
+    inline quint64 size() { return info.numEvents + fill; }
+  private:
+    QFile file;
+    EventListHeader info;
+    EventColumns columns;
+    char * chunk;
+    size_t fill;
+    bool ok;
+    void writeChunk();
+};
+
+
+/* read only view of a mapped event file */
+class EventList
+{
+
+  public:
+    /* constructor */
+    EventList ();
+    /* destructor */
+    ~EventList ();
+    bool open(const QString &fileName);
+    inline const EventListHeader & header() { return info; }
+    inline quint64 size() { return info.numEvents; }
+    inline size_t numChunks() { return (size_t)((info.numEvents + info.chunkEvents - 1) / info.chunkEvents); }
+    /* columns of chunk n, returns the number of events in it */
+    size_t chunk(size_t n, EventColumns *columns);
+    /* adds the pulses to histogram[0 .. histResolution). everything not
+     * counted goes to histogram[histResolution]. returns the number counted.
+     * the result equals a new analysis with these settings only as long as
+     * every counted pulse has an interpolated height: pulses the recording
+     * rejected as wider than iplnWidth() (or truncated) carry the extrema of
+     * their samples (EVENT_DISCRETE). numDiscrete gets the number of those
+     * counted, see approximate() */
+    quint64 rebin(const RebinSettings &settings, unsigned int *histogram, quint64 *numDiscrete);
+    /* true if the glitch window of settings admits widths which the
+     * recording neither accepted nor interpolated */
+    bool approximate(const RebinSettings &settings);
+    quint32 iplnWidth();
+    /* bytes of a chunk in the file */
+    static size_t chunkBytes(size_t chunkEvents);
+  private:
+    QFile file;
+    EventListHeader info;
+    uchar * data;
+};
+
+
+#endif
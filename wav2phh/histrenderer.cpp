@@ -0,0 +1,240 @@
+/** \file histrenderer.cpp
+ * \brief Offscreen rendering of the histogram on a worker thread
+ *
+ * \author Copyright (C) 2014 samplemaker
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1
+ * of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free
+ * Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA
+ *
+ * @{
+ */
+
+#include <cmath>
+#include <cstring>
+#include <QPainter>
+#include <QMetaObject>
+
+#include "histrenderer.h"
+
+/* same layout as the former QDrawBoxWidget::drawHistogram */
+#define X_MARGIN 20
+#define Y_MARGIN 25
+
+
+HistogramRenderer::HistogramRenderer(int w, int h, QObject *parent) : QObject(parent)
+{
+    width = w;
+    height = h;
+    mSource = NULL;
+    pending.store(false);
+    logScale = false;
+    firstBin = 0;
+    lastBin = 0;
+    percent = 0;
+}
+
+
+void HistogramRenderer::schedule()
+{
+    /* coalesce: at most one render request in the queue */
+    if (!pending.exchange(true)){
+        QMetaObject::invokeMethod(this, "renderLatest", Qt::QueuedConnection);
+    }
+}
+
+
+void HistogramRenderer::setSource(HistogramSnapshot * snapshot)
+{
+    mSource = snapshot;
+    pyrMax.clear();
+    pyrMin.clear();
+    pyrArgMax.clear();
+    firstBin = 0;
+    lastBin = 0;
+}
+
+
+void HistogramRenderer::setView(bool log, unsigned int first, unsigned int last)
+{
+    logScale = log;
+    firstBin = first;
+    lastBin = last;
+    /* the pyramid is still valid: no new snapshot needed */
+    if (!pyrMax.isEmpty()){
+        render();
+    }
+}
+
+
+void HistogramRenderer::renderLatest()
+{
+    pending.store(false);
+    if (mSource == NULL){
+        return;
+    }
+    if (mSource->update() || pyrMax.isEmpty()){
+        buildPyramid(mSource->bins(), mSource->size());
+        percent = mSource->percent();
+        render();
+    }
+}
+
+
+void HistogramRenderer::buildPyramid(const unsigned int *bins, unsigned int numBins)
+{
+    pyrMax.resize(1);
+    pyrMin.resize(1);
+    pyrArgMax.resize(1);
+    pyrMax[0].resize(numBins);
+    memcpy(pyrMax[0].data(), bins, sizeof(bins[0]) * numBins);
+    pyrMin[0] = pyrMax[0];
+    pyrArgMax[0].resize(numBins);
+    for (unsigned int i = 0; i < numBins; i ++){
+        pyrArgMax[0][i] = i;
+    }
+    for (int l = 1; pyrMax[l - 1].size() > 1; l ++){
+        const QVector<unsigned int> &lowMax = pyrMax[l - 1];
+        const QVector<unsigned int> &lowMin = pyrMin[l - 1];
+        const QVector<unsigned int> &lowArg = pyrArgMax[l - 1];
+        const int num = (lowMax.size() + 1) / 2;
+        QVector<unsigned int> upMax(num);
+        QVector<unsigned int> upMin(num);
+        QVector<unsigned int> upArg(num);
+        for (int i = 0; i < num; i ++){
+            const int j = 2 * i + 1 < lowMax.size() ? 2 * i + 1 : 2 * i;
+            const int k = lowMax[2 * i] >= lowMax[j] ? 2 * i : j;
+            upMax[i] = lowMax[k];
+            upMin[i] = qMin(lowMin[2 * i], lowMin[j]);
+            upArg[i] = lowArg[k];
+        }
+        pyrMax.append(upMax);
+        pyrMin.append(upMin);
+        pyrArgMax.append(upArg);
+    }
+}
+
+
+/* min and max of the bins [a, b), b > a, and optionally the bin of the max
+ * (the lowest one on a tie). climbs the pyramid from both ends */
+void HistogramRenderer::rangeMinMax(unsigned int a, unsigned int b, unsigned int *vMin, unsigned int *vMax,
+                                    unsigned int *argMax)
+{
+    unsigned int mx = 0;
+    unsigned int mn = ~0u;
+    unsigned int arg = ~0u;
+    for (int l = 0; a < b; l ++){
+        if (a & 1){
+            if ((pyrMax[l][a] > mx) || ((pyrMax[l][a] == mx) && (pyrArgMax[l][a] < arg))){
+                mx = pyrMax[l][a];
+                arg = pyrArgMax[l][a];
+            }
+            mn = qMin(mn, pyrMin[l][a]);
+            a ++;
+        }
+        if (b & 1){
+            b --;
+            if ((pyrMax[l][b] > mx) || ((pyrMax[l][b] == mx) && (pyrArgMax[l][b] < arg))){
+                mx = pyrMax[l][b];
+                arg = pyrArgMax[l][b];
+            }
+            mn = qMin(mn, pyrMin[l][b]);
+        }
+        a >>= 1;
+        b >>= 1;
+    }
+    *vMin = mn;
+    *vMax = mx;
+    if (argMax != NULL){
+        *argMax = arg;
+    }
+}
+
+
+void HistogramRenderer::render()
+{
+    const unsigned int numBins = pyrMax[0].size();
+    if (numBins == 0){
+        return;
+    }
+    unsigned int first = firstBin < numBins ? firstBin : 0;
+    unsigned int last = (lastBin > first) && (lastBin <= numBins) ? lastBin : numBins;
+    const unsigned int span = last - first;
+
+    QImage frame(width, height, QImage::Format_RGB32);
+    frame.fill(QColor(Qt::darkBlue));
+
+    /* the maximum within the view scales the y axis */
+    unsigned int viewMin, viewMax, binMaxX;
+    rangeMinMax(first, last, &viewMin, &viewMax, &binMaxX);
+    const double scale = logScale ? log10(1.0 + viewMax) : (double)(viewMax);
+
+    const int plotWidth = width - 3 * X_MARGIN;
+    const int plotHeight = height - 2 * Y_MARGIN;
+    const int yBase = height - Y_MARGIN;
+    const QRgb solid = QColor(Qt::red).rgb();
+    const QRgb range = QColor(255, 150, 150).rgb();
+    for (int c = 0; (c < plotWidth) && (scale > 0.0); c ++){
+        /* all bins which fall into this column, at least one */
+        const unsigned int a = first + (unsigned int)((quint64)(span) * c / plotWidth);
+        unsigned int b = first + (unsigned int)((quint64)(span) * (c + 1) / plotWidth);
+        if (b <= a) b = a + 1;
+        unsigned int vMin, vMax;
+        rangeMinMax(a, b, &vMin, &vMax);
+        const double fMin = logScale ? log10(1.0 + vMin) : (double)(vMin);
+        const double fMax = logScale ? log10(1.0 + vMax) : (double)(vMax);
+        const int yMin = (int)((double)(plotHeight) * fMin / scale);
+        const int yMax = (int)((double)(plotHeight) * fMax / scale);
+        const int x = c + X_MARGIN;
+        for (int y = 0; y < yMax; y ++){
+            QRgb * line = (QRgb *)(frame.scanLine(yBase - 1 - y));
+            line[x] = y < yMin ? solid : range;
+        }
+    }
+
+    QPainter paintToMap(&frame);
+    /* draw some graticule */
+    paintToMap.setPen(QPen(Qt::white, 2));
+    /* x-Axis */
+    paintToMap.drawLine(X_MARGIN/2, yBase, width - X_MARGIN/2, yBase);
+    /* y-Axis */
+    paintToMap.drawLine(X_MARGIN, yBase + Y_MARGIN/4, X_MARGIN, Y_MARGIN/2);
+    /* draw some ticks */
+    const unsigned int xBinMax = width - 2*X_MARGIN;
+    paintToMap.drawLine(xBinMax, yBase + Y_MARGIN/4, xBinMax, yBase - Y_MARGIN/4);
+
+    paintToMap.drawText(xBinMax - 15, height - 5, QString::number(last));
+    paintToMap.drawText(15, height - 5, QString::number(first));
+    if (logScale){
+        paintToMap.drawText(X_MARGIN + 5, Y_MARGIN, "log");
+    }
+
+    if (percent >= 100.0){
+        paintToMap.drawText(width/2 + width/4, 50, "Progress: Stopped");
+    }
+    else{
+        QString displayStr = QString::number(percent, 'f', 0);
+        paintToMap.drawText(width/2 + width/4, 50, "Progress: " + displayStr + '%');
+    }
+
+    /* peak stats: position of the maximum within the view */
+    QString displayStr1 = QString::number(viewMax);
+    QString displayStr2 = QString::number(binMaxX);
+    unsigned int xptr = (unsigned int)((double)(plotWidth) * (double)(binMaxX - first) / (double)(span)) + X_MARGIN;
+    paintToMap.setFont(QFont("times",10,QFont::Bold));
+    paintToMap.drawText(xptr, Y_MARGIN, displayStr2 + '/' + displayStr1);
+    paintToMap.end();
+
+    emit frameReady(frame);
+}
@@ -0,0 +1,86 @@
+/** \file histrenderer.h
+ * \brief Offscreen rendering of the histogram on a worker thread
+ *
+ * \author Copyright (C) 2014 samplemaker
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1
+ * of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free
+ * Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA
+ *
+ * @{
+ */
+
+#ifndef HISTRENDERER_H
+#define HISTRENDERER_H
+
+#include <atomic>
+#include <QObject>
+#include <QImage>
+#include <QVector>
+
+#include "histsnapshot.h"
+
+
+/**
+ *  Turns the newest histogram snapshot into a QImage of the widget's size.
+ *  Lives on a thread of its own, the gui only ever gets finished images.
+ *
+ *  Every new snapshot is reduced into a min/max pyramid (level l holds the
+ *  min and max of 2^l neighbouring bins and the bin of the max). A pixel
+ *  column or the whole view is then looked up in O(log n) instead of
+ *  touching all of its bins, which keeps zooming and 16k+ bins cheap. Columns show the range
+ *  min..max in a lighter color on top of the solid 0..min bar.
+ **/
+class HistogramRenderer : public QObject
+{
+    Q_OBJECT
+
+public:
+   explicit HistogramRenderer(int width, int height, QObject *parent = 0);
+   /* may be called from any thread: queues a render of the newest snapshot
+    * unless one is still waiting */
+   void schedule();
+
+public slots:
+   /* the snapshot has to outlive its use, see QDrawBoxWidget::setSource */
+   void setSource(HistogramSnapshot * snapshot);
+   /* bins [firstBin, lastBin) are shown, lastBin = 0 shows all */
+   void setView(bool logScale, unsigned int firstBin, unsigned int lastBin);
+   void renderLatest();
+
+signals:
+   void frameReady(const QImage &frame);
+
+private:
+   int width;
+   int height;
+   HistogramSnapshot * mSource;
+   std::atomic<bool> pending;
+   bool logScale;
+   unsigned int firstBin;
+   unsigned int lastBin;
+   float percent;
+   /* level 0 is a copy of the snapshot */
+   QVector< QVector<unsigned int> > pyrMax;
+   QVector< QVector<unsigned int> > pyrMin;
+   /* the bin of pyrMax, the lowest one on a tie */
+   QVector< QVector<unsigned int> > pyrArgMax;
+   void buildPyramid(const unsigned int *bins, unsigned int numBins);
+   void rangeMinMax(unsigned int a, unsigned int b, unsigned int *vMin, unsigned int *vMax,
+                    unsigned int *argMax = NULL);
+   void render();
+};
+
+
+#endif
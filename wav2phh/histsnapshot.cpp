@@ -0,0 +1,65 @@
+/** \file histsnapshot.cpp
+ * \brief Lock-free publication of histogram snapshots to the gui
+ *
+ * \author Copyright (C) 2014 samplemaker
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1
+ * of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free
+ * Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA
+ *
+ * @{
+ */
+
+#include <cstring>
+#include "histsnapshot.h"
+
+/* marks the middle buffer as not yet seen by the reader */
+#define SNAPSHOT_FRESH 4
+
+
+HistogramSnapshot::HistogramSnapshot (unsigned int num) {
+  numBins = num;
+  for (int n = 0; n < 3; n ++){
+    buf[n].bins = new unsigned int[numBins + 1]();
+    buf[n].percent = 0;
+  }
+  back = 0;
+  middle.store(1);
+  front = 2;
+}
+
+
+/* destructor */
+HistogramSnapshot::~HistogramSnapshot () {
+  for (int n = 0; n < 3; n ++){
+    delete[] buf[n].bins;
+  }
+}
+
+
+void HistogramSnapshot::publish(const unsigned int *histogram, float percent) {
+  memcpy(buf[back].bins, histogram, sizeof(histogram[0]) * numBins);
+  buf[back].percent = percent;
+  /* release: the copy is visible before the index */
+  back = middle.exchange(back | SNAPSHOT_FRESH, std::memory_order_acq_rel) & 3;
+}
+
+
+bool HistogramSnapshot::update() {
+  if ((middle.load(std::memory_order_relaxed) & SNAPSHOT_FRESH) == 0){
+    return(false);
+  }
+  front = middle.exchange(front, std::memory_order_acq_rel) & 3;
+  return(true);
+}
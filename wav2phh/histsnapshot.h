@@ -0,0 +1,69 @@
+/** \file histsnapshot.h
+ * \brief Lock-free publication of histogram snapshots to the gui
+ *
+ * \author Copyright (C) 2014 samplemaker
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1
+ * of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free
+ * Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA
+ *
+ * @{
+ */
+
+#ifndef HISTSNAPSHOT_H
+#define HISTSNAPSHOT_H
+
+#include <atomic>
+
+
+/**
+ *  Triple buffer between one writer (the analyzer thread) and one reader (the
+ *  gui thread). The writer copies the live histogram into its back buffer and
+ *  swaps it with the middle one, the reader swaps its front buffer with the
+ *  middle one if that holds something newer. Both sides only ever exchange
+ *  one atomic index: neither waits for the other, and the buffer the reader
+ *  holds stays untouched until the reader itself lets go of it.
+ **/
+class HistogramSnapshot
+{
+
+  public:
+    /* constructor */
+    HistogramSnapshot (unsigned int numBins);
+    /* destructor */
+    ~HistogramSnapshot ();
+    /* writer */
+    void publish(const unsigned int *histogram, float percent);
+    /* reader: true if a newer snapshot than the last one is now in front */
+    bool update();
+    inline const unsigned int * bins() { return buf[front].bins; }
+    inline float percent() { return buf[front].percent; }
+    inline unsigned int size() { return numBins; }
+  private:
+    struct Buffer
+    {
+      unsigned int * bins;
+      float percent;
+    };
+    Buffer buf[3];
+    unsigned int numBins;
+    /* owned by the writer / by the reader */
+    int back;
+    int front;
+    /* index of the middle buffer plus FRESH if the writer put it there */
+    std::atomic<int> middle;
+};
+
+
+#endif
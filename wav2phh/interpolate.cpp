@@ -23,9 +23,14 @@
 
 #include <cmath>
 #include <cstdlib>
+#include <cstring>
 #include <QDebug>
 #include "interpolate.h"
 
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
 #define d2i(x) ((x)<0?(int)((x)-0.5):(int)((x)+0.5)
 
 /**
@@ -83,11 +88,33 @@ Interpolator::Interpolator (const unsigned int k, const size_t N_kernel) {
      }
 //qWarning() << filter_lookup[m];
   }
+
+  /* polyphase decomposition: write m = k*q + p (phase p = 0 .. k-1). then
+   *  y[kq+p] = \sum_{n}x[n]f[k(q-n)+p]
+   *  and f[k(q-n)+p] is non zero for q-(N_kernel-1) <= n <= q+(N_kernel-1) only.
+   *  with i := n - q + (N_kernel-1) this becomes a dot product of fixed length
+   *  y[kq+p] = \sum_{i=0}^{2N_kernel-1}x[q-(N_kernel-1)+i]h_p[i]
+   *  with h_p[i] := f[k(N_kernel-1-i)+p] (zero outside the kernel range). The last
+   *  tap is always zero and pads the filter to an even length */
+  num_taps = 2 * N_kernel;
+  phase_filter = new double[k * num_taps];
+  const int kernelMax = k * (N_kernel - 1);
+  for (unsigned int p = 0; p < k; p ++){
+     for (int i = 0; i < num_taps; i ++){
+        const int u = k * (N_kernel - 1 - i) + p;
+        phase_filter[p * num_taps + i] = ((-kernelMax <= u) && (u <= kernelMax)) ? filter_kernel(u) : 0.0;
+     }
+  }
+  pad_buf = NULL;
+  pad_len = 0;
+  setSpecialized(true);
 }
 
 /* destructor */
 Interpolator::~Interpolator () {
   delete [] filter_lookup;
+  delete [] phase_filter;
+  delete [] pad_buf;
 }
 
 double Interpolator::filter_kernel(int m){
@@ -99,6 +126,309 @@ double Interpolator::filter_kernel(int m){
  }
 }
 
+/* branch free dot product over num_taps (even) elements */
+static inline double dotProduct(const double *x, const double *h, int num)
+{
+#ifdef __SSE2__
+  __m128d acc0 = _mm_setzero_pd();
+  __m128d acc1 = _mm_setzero_pd();
+  int i = 0;
+  for (; i + 4 <= num; i += 4){
+    acc0 = _mm_add_pd(acc0, _mm_mul_pd(_mm_loadu_pd(x + i), _mm_loadu_pd(h + i)));
+    acc1 = _mm_add_pd(acc1, _mm_mul_pd(_mm_loadu_pd(x + i + 2), _mm_loadu_pd(h + i + 2)));
+  }
+  if (i < num){
+    acc0 = _mm_add_pd(acc0, _mm_mul_pd(_mm_loadu_pd(x + i), _mm_loadu_pd(h + i)));
+  }
+  acc0 = _mm_add_pd(acc0, acc1);
+  return(_mm_cvtsd_f64(_mm_add_sd(acc0, _mm_unpackhi_pd(acc0, acc0))));
+#else
+  double acc = 0.0;
+  for (int i = 0; i < num; i ++){
+    acc += x[i] * h[i];
+  }
+  return(acc);
+#endif
+}
+
+/**
+ *  Compile time specialized kernels for the presets (IPLN_PRESET_*).
+ *
+ *  The polyphase table (see the constructor) is built by the compiler:
+ *  sin(pi*u/k) is reduced exactly in integers to [0, pi/2] and evaluated as a
+ *  taylor series, therefore the zeros of the sinc are exact. It is stored
+ *  transposed, h[i][p], with the phases padded to a multiple of four. One pass
+ *  over the taps i then yields all k phases y[kq+p] of a source position q at
+ *  once: k independent sums which vectorize across p (avx2) without any
+ *  horizontal add. The taps falling onto the zero padding are skipped as in
+ *  phaseValue(). With sse2 only this layout is not faster than the runtime
+ *  kernels, hence the specialized kernels are avx2 only and selected at
+ *  runtime like the pcm conversion.
+ *
+ *  The table equals the one of the constructor up to the last bit and the
+ *  sums are accumulated in a different order, hence the results agree with
+ *  the runtime kernels to the rounding error (< 1e-15 for |x| <= 1), not
+ *  bitwise.
+ **/
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define IPLN_HAVE_X86_KERNELS 1
+#include <immintrin.h>
+#endif
+
+#define PI_LONG 3.141592653589793238462643383279502884L
+
+/* sin(pi * u / k) */
+static constexpr long double sinPiFraction (int u, int k)
+{
+  int r = u % (2 * k);
+  if (r < 0){
+    r += 2 * k;
+  }
+  long double sign = 1.0L;
+  if (r >= k){
+    r -= k;
+    sign = -1.0L;
+  }
+  if (2 * r > k){
+    r = k - r;
+  }
+  const long double x = PI_LONG * (long double)(r) / (long double)(k);
+  long double term = x;
+  long double sum = x;
+  for (int n = 1; n < 16; n ++){
+    term *= -x * x / (long double)((2 * n) * (2 * n + 1));
+    sum += term;
+  }
+  return(sign * sum);
+}
+
+
+static constexpr double sincFraction (int u, int k)
+{
+  return((u == 0) ? 1.0 : (double)(sinPiFraction(u, k) / (PI_LONG * (long double)(u) / (long double)(k))));
+}
+
+
+template <int K, int N>
+struct PhaseTable
+{
+  /* number of phases rounded up to full avx registers */
+  static constexpr int numPhases = (K + 3) & ~3;
+  alignas(32) double h[2 * N][numPhases];
+  constexpr PhaseTable () : h() {
+    for (int i = 0; i < 2 * N; i ++){
+      for (int p = 0; p < K; p ++){
+        const int u = K * (N - 1 - i) + p;
+        h[i][p] = ((-K * (N - 1) <= u) && (u <= K * (N - 1))) ? sincFraction(u, K) : 0.0;
+      }
+    }
+  }
+};
+
+static constexpr PhaseTable<IPLN_PRESET_FACTOR, IPLN_PRESET_WINDOW_6SPP> table6Spp;
+static constexpr PhaseTable<IPLN_PRESET_FACTOR, IPLN_PRESET_WINDOW_10SPP> table10Spp;
+
+
+#ifdef IPLN_HAVE_X86_KERNELS
+
+/* y[kq+p] for all phases p of the source position q (padded source) */
+template <int K, int N>
+__attribute__((target("avx2")))
+static inline void phaseVector (const PhaseTable<K, N> &table, const double *pad,
+                                int q, const size_t numSampleSrc, double *y)
+{
+  const int numVec = PhaseTable<K, N>::numPhases / 4;
+  const int lead = N - 1;
+  const int first = (lead - q) > 0 ? (lead - q) : 0;
+  const int end = lead + (int)(numSampleSrc) - q;
+  const int last = (end < 2 * N) ? end : 2 * N;
+  /* even and odd taps in separate sums: twice the independent additions */
+  __m256d acc0[numVec];
+  __m256d acc1[numVec];
+  for (int j = 0; j < numVec; j ++){
+    acc0[j] = _mm256_setzero_pd();
+    acc1[j] = _mm256_setzero_pd();
+  }
+  int i = first;
+  for (; i + 2 <= last; i += 2){
+    const __m256d x0 = _mm256_set1_pd(pad[q + i]);
+    const __m256d x1 = _mm256_set1_pd(pad[q + i + 1]);
+    for (int j = 0; j < numVec; j ++){
+      acc0[j] = _mm256_add_pd(acc0[j], _mm256_mul_pd(x0, _mm256_load_pd(table.h[i] + 4 * j)));
+      acc1[j] = _mm256_add_pd(acc1[j], _mm256_mul_pd(x1, _mm256_load_pd(table.h[i + 1] + 4 * j)));
+    }
+  }
+  if (i < last){
+    const __m256d x0 = _mm256_set1_pd(pad[q + i]);
+    for (int j = 0; j < numVec; j ++){
+      acc0[j] = _mm256_add_pd(acc0[j], _mm256_mul_pd(x0, _mm256_load_pd(table.h[i] + 4 * j)));
+    }
+  }
+  for (int j = 0; j < numVec; j ++){
+    _mm256_storeu_pd(y + 4 * j, _mm256_add_pd(acc0[j], acc1[j]));
+  }
+}
+
+
+/* upsample() on the padded source */
+template <int K, int N>
+__attribute__((target("avx2")))
+static void upsampleFixed (const PhaseTable<K, N> &table, const double *pad,
+                           double *sampleDst, const size_t numSampleSrc)
+{
+  double y[PhaseTable<K, N>::numPhases];
+  for (size_t q = 0; q + 1 < numSampleSrc; q ++){
+    phaseVector(table, pad, q, numSampleSrc, y);
+    for (int p = 0; p < K; p ++){
+      sampleDst[K * q + p] = y[p];
+    }
+  }
+  phaseVector(table, pad, numSampleSrc - 1, numSampleSrc, y);
+  sampleDst[K * (numSampleSrc - 1)] = y[0];
+}
+
+
+/* refineExtrema() on the padded source */
+template <int K, int N>
+__attribute__((target("avx2")))
+static void refineFixed (const PhaseTable<K, N> &table, const double *pad,
+                         const size_t numSampleSrc, size_t posMax, size_t posMin,
+                         double *valMax, double *valMin)
+{
+  double y[PhaseTable<K, N>::numPhases];
+  for (int n = -1; n <= 0; n ++){
+    const int qHigh = (int)(posMax) + n;
+    if ((qHigh >= 0) && (qHigh + 1 < (int)(numSampleSrc))){
+      phaseVector(table, pad, qHigh, numSampleSrc, y);
+      for (int p = 1; p < K; p ++){
+        if (y[p] > *valMax) *valMax = y[p];
+      }
+    }
+    const int qLow = (int)(posMin) + n;
+    if ((qLow >= 0) && (qLow + 1 < (int)(numSampleSrc))){
+      phaseVector(table, pad, qLow, numSampleSrc, y);
+      for (int p = 1; p < K; p ++){
+        if (y[p] < *valMin) *valMin = y[p];
+      }
+    }
+  }
+}
+
+#endif
+
+
+/* picks the specialized kernel if the parameters match a preset */
+void Interpolator::setSpecialized (bool enable) {
+  specialized = enable;
+  kernel = KERNEL_RUNTIME;
+#ifdef IPLN_HAVE_X86_KERNELS
+  __builtin_cpu_init();
+  if (specialized && __builtin_cpu_supports("avx2") && (ipln_factor == IPLN_PRESET_FACTOR)){
+    if (num_kernel == IPLN_PRESET_WINDOW_6SPP){
+      kernel = KERNEL_7_15;
+    }
+    else if (num_kernel == IPLN_PRESET_WINDOW_10SPP){
+      kernel = KERNEL_7_22;
+    }
+  }
+#endif
+}
+
+
+const char * Interpolator::kernelName () {
+  switch (kernel){
+    case KERNEL_7_15:
+      return("7x15-fixed");
+    case KERNEL_7_22:
+      return("7x22-fixed");
+    default:
+      return("runtime");
+  }
+}
+
+
+/** Sample rate conversion (upsampling), polyphase implementation
+ *
+ *  Same result as upsampleReference() but each output point costs one dot
+ *  product of length 2*N_kernel instead of a loop over the whole source with
+ *  range checks, i.e. O(numDst*N_kernel) instead of O(numDst*numSrc).
+ *
+ *  The summation order differs from the reference, hence the results are not
+ *  bitwise identical. The deviation is in the order of the rounding error of
+ *  the sum, for normalized input (|x| <= 1) well below 1e-12.
+ *
+ **/
+void Interpolator::upsample (const double *sampleSrc,
+                             double *sampleDst,
+                             const size_t numSampleSrc,
+                             double offset) {
+
+  const int numSampleDst = ipln_factor*(numSampleSrc-1)+1;
+
+  padSource(sampleSrc, numSampleSrc, offset);
+#ifdef IPLN_HAVE_X86_KERNELS
+  switch (kernel){
+    case KERNEL_7_15:
+      upsampleFixed(table6Spp, pad_buf, sampleDst, numSampleSrc);
+      return;
+    case KERNEL_7_22:
+      upsampleFixed(table10Spp, pad_buf, sampleDst, numSampleSrc);
+      return;
+    default:
+    break;
+  }
+#endif
+  int m = 0;
+  for (size_t q = 0; q < numSampleSrc; q ++){
+    for (int p = 0; (p < ipln_factor) && (m < numSampleDst); p ++, m ++){
+      sampleDst[m] = phaseValue(q, p, numSampleSrc);
+    }
+  }
+}
+
+
+void Interpolator::reserve (const size_t numSampleSrc) {
+  const size_t numPad = numSampleSrc + num_taps;
+  if (numPad > pad_len){
+    delete [] pad_buf;
+    pad_len = numPad;
+    pad_buf = new double[pad_len];
+  }
+}
+
+
+/* copy the source with num_kernel-1 zeros in front and enough zeros at the
+ * end: no bounds check in the dot product. the buffer only ever grows */
+void Interpolator::padSource (const double *sampleSrc,
+                              const size_t numSampleSrc,
+                              double offset) {
+
+  const size_t lead = num_kernel - 1;
+  const size_t numPad = numSampleSrc + num_taps;
+
+  reserve(numSampleSrc);
+  memset(pad_buf, 0, sizeof(double) * lead);
+  for (size_t n = 0; n < numSampleSrc; n ++){
+    pad_buf[lead + n] = sampleSrc[n] - offset;
+  }
+  memset(pad_buf + lead + numSampleSrc, 0, sizeof(double) * (numPad - lead - numSampleSrc));
+}
+
+
+/* y[kq+p] from the padded source */
+inline double Interpolator::phaseValue (size_t q, int p, const size_t numSampleSrc) {
+
+  const int lead = num_kernel - 1;
+  /* short pulses: skip the taps which fall onto the zero padding only. the
+   * range is rounded to even boundaries (the padding reads as zero) */
+  const int first = (lead - (int)(q)) > 0 ? ((lead - (int)(q)) & ~1) : 0;
+  int last = lead + (int)(numSampleSrc) - (int)(q);
+  last = (last < num_taps) ? ((last + 1) & ~1) : num_taps;
+  return(dotProduct(pad_buf + q + first, phase_filter + p * num_taps + first, last - first));
+}
+
+
 /** Sample rate conversion (upsampling)
  *
  *  Interpolates k - 1 points between two adjacent sampling points
@@ -115,10 +445,10 @@ double Interpolator::filter_kernel(int m){
  *  see the constructor for more details.
  *
  **/
-void Interpolator::upsample (const double *sampleSrc,
-                             double *sampleDst,
-                             const size_t numSampleSrc,
-                             double offset) {
+void Interpolator::upsampleReference (const double *sampleSrc,
+                                      double *sampleDst,
+                                      const size_t numSampleSrc,
+                                      double offset) {
 
   const int  numSampleDst =  ipln_factor*(numSampleSrc-1)+1;
 
@@ -146,31 +476,55 @@ void Interpolator::upsample (const double *sampleSrc,
 }
 
 
-MovingAverage::MovingAverage (int numElements) {
-  maxBufPos = numElements - 1;
-  ringBufData = new double[maxBufPos + 1]();
-  headPos = 0;
-  numRecords = 0;
-  ringBufSum = 0.0;
-}
-
-/* destructor */
-MovingAverage::~MovingAverage () {
-  delete[] ringBufData;
-}
-
+/** Largest and smallest value of the upsampled pulse near given positions
+ *
+ *  Evaluates only the interpolation points strictly between posMax-1 and
+ *  posMax+1 (resp. posMin) - the same grid upsample() works on, but 2k-1
+ *  points per extremum instead of k*(N-1)+1 for the whole pulse. The result
+ *  equals the global search of upsample() whenever the extrema of the
+ *  reconstruction lie within one sample of the discrete extrema, which holds
+ *  for the pulse maximum. The minimum of the full upsampled pulse can sit in
+ *  the ringing at the pulse edges instead and is not found by this search.
+ *
+ **/
+void Interpolator::refineExtrema (const double *sampleSrc,
+                                  const size_t numSampleSrc,
+                                  size_t posMax,
+                                  size_t posMin,
+                                  double offset,
+                                  double *valMax,
+                                  double *valMin) {
 
-double MovingAverage::doMovingAverage(double value) {
-  ringBufData[headPos] = value;
-  numRecords++;
-  headPos ++;
-  /* end of buffer reached */
-  if (headPos == maxBufPos){
-     ringBufSum += value - ringBufData[0];
-     headPos = 0;
-   }
-  else{
-     ringBufSum += value - ringBufData[headPos];
+  padSource(sampleSrc, numSampleSrc, offset);
+  *valMax = sampleSrc[posMax] - offset;
+  *valMin = sampleSrc[posMin] - offset;
+#ifdef IPLN_HAVE_X86_KERNELS
+  switch (kernel){
+    case KERNEL_7_15:
+      refineFixed(table6Spp, pad_buf, numSampleSrc, posMax, posMin, valMax, valMin);
+      return;
+    case KERNEL_7_22:
+      refineFixed(table10Spp, pad_buf, numSampleSrc, posMax, posMin, valMax, valMin);
+      return;
+    default:
+    break;
+  }
+#endif
+  for (int n = -1; n <= 0; n ++){
+    /* interval [pos + n, pos + n + 1] */
+    const int qHigh = (int)(posMax) + n;
+    if ((qHigh >= 0) && (qHigh + 1 < (int)(numSampleSrc))){
+      for (int p = 1; p < ipln_factor; p ++){
+        const double y = phaseValue(qHigh, p, numSampleSrc);
+        if (y > *valMax) *valMax = y;
+      }
+    }
+    const int qLow = (int)(posMin) + n;
+    if ((qLow >= 0) && (qLow + 1 < (int)(numSampleSrc))){
+      for (int p = 1; p < ipln_factor; p ++){
+        const double y = phaseValue(qLow, p, numSampleSrc);
+        if (y < *valMin) *valMin = y;
+      }
+    }
   }
-  return(ringBufSum/(double)(numRecords));
 }
@@ -26,6 +26,12 @@
 
 #include <cstdlib>
 
+/* interpolation factor and window size of the presets in the settings dialog.
+ * these combinations run on compile time specialized kernels */
+#define IPLN_PRESET_FACTOR 7
+#define IPLN_PRESET_WINDOW_6SPP 15
+#define IPLN_PRESET_WINDOW_10SPP 22
+
 
 class Interpolator
 {
@@ -39,31 +45,41 @@ class Interpolator
                    double *sampleDst,
                    const size_t numSampleSrc,
                    double offset);
+    /* preallocate the scratch memory for pulses up to numSampleSrc */
+    void reserve (const size_t numSampleSrc);
+    /* direct evaluation of the cardinal series (former upsample) */
+    void upsampleReference (const double *sampleSrc,
+                            double *sampleDst,
+                            const size_t numSampleSrc,
+                            double offset);
+    void refineExtrema (const double *sampleSrc,
+                        const size_t numSampleSrc,
+                        size_t posMax,
+                        size_t posMin,
+                        double offset,
+                        double *valMax,
+                        double *valMin);
+    inline unsigned int factor() { return ipln_factor; }
+    inline size_t kernelSize() { return num_kernel; }
+    /* false: always use the runtime parameter kernels (for comparison) */
+    void setSpecialized (bool enable);
+    const char * kernelName ();
   private:
     int ipln_factor;
     int num_kernel;
+    enum { KERNEL_RUNTIME, KERNEL_7_15, KERNEL_7_22 } kernel;
+    bool specialized;
     double * filter_lookup;
     double filter_kernel(int m);
+    /* polyphase decomposition of filter_lookup */
+    int num_taps;
+    double * phase_filter;
+    /* zero padded copy of the source */
+    double * pad_buf;
+    size_t pad_len;
+    void padSource (const double *sampleSrc, const size_t numSampleSrc, double offset);
+    double phaseValue (size_t q, int p, const size_t numSampleSrc);
 };
 
-class MovingAverage
-{
-
-  public:
-    /* constructor */
-    MovingAverage (int numElements);
-    /* destructor */
-    ~MovingAverage ();
-    double doMovingAverage(double value);
-  private:
-    double * ringBufData;
-    int headPos;
-    int numRecords;
-    int maxBufPos;
-    double ringBufSum;
-
-};
-
-
 #endif
 
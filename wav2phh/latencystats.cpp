@@ -0,0 +1,78 @@
+/** \file latencystats.cpp
+ * \brief Distribution of the sample to histogram latency in live mode
+ *
+ * \author Copyright (C) 2014 samplemaker
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1
+ * of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free
+ * Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA
+ *
+ * @{
+ */
+
+#include <cstring>
+#include "latencystats.h"
+
+
+LatencyStats::LatencyStats () {
+  bins = new quint32[LATENCY_NUM_BINS];
+  reset();
+}
+
+
+/* destructor */
+LatencyStats::~LatencyStats () {
+  delete[] bins;
+}
+
+
+void LatencyStats::reset() {
+  memset(bins, 0, sizeof(bins[0]) * LATENCY_NUM_BINS);
+  numValues = 0;
+  maxValue = 0;
+}
+
+
+void LatencyStats::add(qint64 nsecs) {
+  if (nsecs < 0){
+    nsecs = 0;
+  }
+  qint64 bin = nsecs / LATENCY_BIN_NSECS;
+  if (bin >= LATENCY_NUM_BINS){
+    bin = LATENCY_NUM_BINS - 1;
+  }
+  bins[bin] ++;
+  numValues ++;
+  if (nsecs > maxValue){
+    maxValue = nsecs;
+  }
+}
+
+
+qint64 LatencyStats::percentile(double p) const {
+  if (numValues == 0){
+    return(0);
+  }
+  /* smallest bin with at least p percent of the values at or below it */
+  const double need = p * 0.01 * (double)(numValues);
+  quint64 sum = 0;
+  for (int n = 0; n < LATENCY_NUM_BINS; n ++){
+    sum += bins[n];
+    if ((double)(sum) >= need){
+      const qint64 edge = (qint64)(n + 1) * LATENCY_BIN_NSECS;
+      return(edge < maxValue ? edge : maxValue);
+    }
+  }
+  return(maxValue);
+}
@@ -0,0 +1,60 @@
+/** \file latencystats.h
+ * \brief Distribution of the sample to histogram latency in live mode
+ *
+ * \author Copyright (C) 2014 samplemaker
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1
+ * of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free
+ * Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA
+ *
+ * @{
+ */
+
+#ifndef LATENCYSTATS_H
+#define LATENCYSTATS_H
+
+#include <QtGlobal>
+
+/* resolution and range of the recorded latencies */
+#define LATENCY_BIN_NSECS 100000
+#define LATENCY_NUM_BINS 20000
+
+
+/**
+ *  Histogram of latencies with 0.1 ms bins up to 2 s, larger values go into
+ *  the last bin (the exact maximum is kept aside). add() is O(1) and does
+ *  not allocate, hence it can be called for every block.
+ **/
+class LatencyStats
+{
+
+  public:
+    /* constructor */
+    LatencyStats ();
+    /* destructor */
+    ~LatencyStats ();
+    void reset();
+    void add(qint64 nsecs);
+    quint64 count() const { return numValues; }
+    qint64 max() const { return maxValue; }
+    /* upper edge of the bin which contains the p-th percentile (0..100) */
+    qint64 percentile(double p) const;
+  private:
+    quint32 * bins;
+    quint64 numValues;
+    qint64 maxValue;
+};
+
+
+#endif
@@ -26,6 +26,7 @@
 
 #include <QMessageBox>
 #include <QFileDialog>
+#include <QJsonDocument>
 
 #include "mainwindow.h"
 #include "ui_mainwindow.h"
@@ -33,10 +34,6 @@
 #include "analyzer.h"
 #include "audioinput.h"
 
-// \Todo: put this into a Analyzer Objects which is given to AudioInfo - Ringbuffer
-#define NUM_ELEMENTS_RINGBUF 4096
-#define NUM_FUTUREPAST_RINGBUF 1024
-
 
 MainWindow::MainWindow(QWidget *parent) :
     QMainWindow(parent),
@@ -48,6 +45,9 @@ MainWindow::MainWindow(QWidget *parent) :
     connect(ui->actionHelp , SIGNAL(triggered()), this, SLOT(onActionHelp()) );
     connect(ui->actionExit, SIGNAL(triggered()), qApp, SLOT(quit()) );
     connect(ui->actionSaveHistogram, SIGNAL(triggered()), this, SLOT(onActionSaveHistogram()) );
+    connect(ui->actionSaveStatistics, SIGNAL(triggered()), this, SLOT(onActionSaveStatistics()) );
+    connect(ui->actionSaveTimeSlices, SIGNAL(triggered()), this, SLOT(onActionSaveTimeSlices()) );
+    connect(ui->actionShowWaterfall, SIGNAL(triggered()), this, SLOT(onActionShowWaterfall()) );
     connect(ui->actionAboutThis, SIGNAL(triggered()), this, SLOT(onActionAboutThis()) );
 
 
@@ -58,6 +58,8 @@ MainWindow::MainWindow(QWidget *parent) :
     unsigned int mNumBinsHist = mAnalyzerSetting.mNumBinsHist;
 
     m_Analyzer  = new Analyzer(mNumBinsHist, NUM_FUTUREPAST_RINGBUF,NUM_ELEMENTS_RINGBUF, mBaseline, mPulseEvent);
+    ui->paintArea->setSource(m_Analyzer->snapshot);
+    waterfall = new WaterfallView(this);
 
     /*
     Qt::DirectConnection 1
@@ -73,11 +75,11 @@ MainWindow::MainWindow(QWidget *parent) :
         as with Qt::DirectConnection; otherwise the signal is queued, as with Qt::QueuedConnection.
     */
 
-    QObject::connect(m_Analyzer,
-                     SIGNAL( histogramReady(unsigned int *, const unsigned int, float) ),
-                     ui->paintArea,
-                     SLOT( drawHistogram(unsigned int *, const unsigned int, float) ),
-                     Qt::BlockingQueuedConnection);
+    /* the analyzer never waits for the gui: it publishes snapshots of the
+     * histogram which are fetched here at the gui's own pace */
+    refreshTimer = new QTimer(this);
+    refreshTimer->setInterval(HIST_PUBLISH_MSECS);
+    connect(refreshTimer, SIGNAL(timeout()), this, SLOT(onRefreshTimer()));
 
     /* before changes on the Analyzer are allowed a wav file has to be selected and a AudioInfo has to be created */
     ui->menu_Configure->setDisabled(true);
@@ -92,9 +94,54 @@ MainWindow::~MainWindow()
 }
 
 
+void MainWindow::onRefreshTimer(){
+    /* drawn in the background, only if there is something new */
+    ui->paintArea->refresh();
+    showStatistics();
+}
+
+
+/* decoder and analyzer counters as far as published by their threads */
+PipelineStats MainWindow::statistics(){
+    if (fromCache)
+        return cachedStats;
+    PipelineStats stats = m_Analyzer->statistics();
+    if (m_audioInfo != NULL)
+        stats.add(m_audioInfo->statistics());
+    return stats;
+}
+
+
+void MainWindow::showStatistics(){
+    if (fromCache)
+        ui->statsLabel->setText("from the result cache: " + cachedStats.summary());
+    else
+        ui->statsLabel->setText(statistics().summary());
+}
+
+
 void MainWindow::onDecodeFinished(){
     qWarning() << "onDecodeFinished";
-    ui->paintArea->drawHistogram(m_Analyzer->histogram, m_Analyzer->histResolution, 100.0);
+    refreshTimer->stop();
+    /* the decode thread has finished: publish the complete histogram */
+    m_Analyzer->snapshot->publish(m_Analyzer->histogram, 100.0);
+    m_Analyzer->publishStatistics();
+    /* pulses of an aborted run go up to the last analyzed block */
+    timeSlices.finish(m_Analyzer->statistics().samplesAnalyzed);
+    if (waterfall->isVisible())
+        waterfall->setSlices(&timeSlices, sliceSeconds());
+    ui->paintArea->refresh();
+    showStatistics();
+    if (!cacheParameters.isEmpty()){
+        /* a file seen for the first time: the decode thread has hashed it */
+        quint64 contentHash;
+        if (cacheKey.isEmpty() && m_audioInfo->contentHash(&contentHash))
+            cacheKey = resultCache.remember(wavFile, m_audioInfo->headerLength(), m_audioInfo->dataLength(),
+                                            contentHash, cacheParameters);
+        resultCache.store(cacheKey, m_Analyzer->histogram, m_Analyzer->histResolution, statistics(), &timeSlices);
+        cacheParameters.clear();
+        cacheKey.clear();
+    }
     ui->menu_Configure->setEnabled(true);
     ui->menu_File->setEnabled(true);
     ui->recordButton->setChecked(false);
@@ -106,15 +153,45 @@ void MainWindow::onDecodeFinished(){
 
 void MainWindow::recordButtonStartRec()
 {
+    /* the same data analyzed with the same settings before: show that result */
+    fromCache = false;
+    cacheParameters = ResultCache::parameters(*mBaseline, *mPulseEvent, mAnalyzerSetting.mSoftGain,
+                                              m_Analyzer->histResolution, 0);
+    /* the gui thread does not read the file: without a remembered content
+     * hash there is nothing to look up, the decode thread hashes the data */
+    cacheKey = resultCache.knownKey(wavFile, m_audioInfo->headerLength(), m_audioInfo->dataLength(),
+                                    cacheParameters);
+    m_audioInfo->setContentHash(cacheKey.isEmpty());
+    /* the waterfall lets go of the slices until the run has finished */
+    waterfall->setSlices(NULL, 0.0);
+    const double sampleRate = (double)(m_audioInfo->fileFormat().sampleRate());
+    const quint64 sliceLength = (quint64)(TIMESLICES_SECONDS_DEFAULT * sampleRate);
+    /* an entry is only taken together with its time slices */
+    if (resultCache.lookup(cacheKey, m_Analyzer->histogram, m_Analyzer->histResolution, &cachedStats, &timeSlices) &&
+        (timeSlices.sliceLength() == qMax(sliceLength, (quint64)(1)))){
+        fromCache = true;
+        cacheParameters.clear();
+        cacheKey.clear();
+        m_Analyzer->snapshot->publish(m_Analyzer->histogram, 100.0);
+        if (waterfall->isVisible())
+            waterfall->setSlices(&timeSlices, sliceSeconds());
+        ui->paintArea->refresh();
+        showStatistics();
+        ui->recordButton->setChecked(false);
+        return;
+    }
+    /* reset baseline and other stuff from a previous export */
+    m_Analyzer->reset();
+    timeSlices.reset(m_Analyzer->histResolution, sliceLength);
+    m_Analyzer->setTimeSlices(&timeSlices);
     /* redirect central button to "stop export" */
     disconnect(ui->recordButton, SIGNAL(clicked()), this, SLOT(recordButtonStartRec()));
     /* menubar only accessible if stopped */
     ui->menu_Configure->setDisabled(true);
     ui->menu_File->setDisabled(true);
-    /* reset baseline and other stuff from a previous export */
-    m_Analyzer->reset();
     /* start a new export thread (decode) */
     m_audioInfo->start();
+    refreshTimer->start();
     connect(ui->recordButton, SIGNAL(clicked()), this, SLOT(recordButtonStopRec()));
 }
 
@@ -122,6 +199,9 @@ void MainWindow::recordButtonStartRec()
 void MainWindow::recordButtonStopRec()
 {
     disconnect(ui->recordButton, SIGNAL(clicked()), this, SLOT(recordButtonStopRec()));
+    /* an aborted run does not go into the result cache */
+    cacheParameters.clear();
+    cacheKey.clear();
     /* stop a running export thread */
     m_audioInfo->stopProcess();
     ui->menu_Configure->setEnabled(true);
@@ -147,6 +227,7 @@ void MainWindow::onActionOpenWavfile()
                 "Wav (*.wav);;All Files (*.*)");
     if (!fileName.isEmpty()){
         wavFile = fileName;
+        fromCache = false;
         /* if there is a previous incident delete it */
         if(m_audioInfo != NULL)
         {
@@ -163,10 +244,20 @@ void MainWindow::onActionOpenWavfile()
             m_audioInfo = NULL;
 
         }
+        /* the slices belong to the previous file */
+        waterfall->setSlices(NULL, 0.0);
+        timeSlices.reset(timeSlices.numBins(), timeSlices.sliceLength());
         m_audioInfo  = new AudioInfo(NUM_ELEMENTS_RINGBUF, NUM_FUTUREPAST_RINGBUF, this);
         m_audioInfo->resetSoftGain(mAnalyzerSetting.mSoftGain);
+        /* runs with other settings read the samples of the first run from memory */
+        m_audioInfo->setSidecar(SIDECAR_MEMORY);
         if ( m_audioInfo->open(wavFile) ){
-            ui->audioDeviceLabel->setText("Wav file opened");
+            /* the gui analyzes the first channel of a multi channel file */
+            const int numChannels = m_audioInfo->fileFormat().channelCount();
+            if (numChannels > 1)
+                ui->audioDeviceLabel->setText(QString("Wav file opened (channel 0 of %1)").arg(numChannels));
+            else
+                ui->audioDeviceLabel->setText("Wav file opened");
             connect(ui->recordButton, SIGNAL(clicked()), this, SLOT(recordButtonStartRec()));
             m_Analyzer->reset();
             ui->recordButton->setCheckable(true);
@@ -186,7 +277,7 @@ void MainWindow::onActionOpenWavfile()
         }
         else{
             QMessageBox msgBox;
-            msgBox.setText("Unknown format: 16bit, 1 channel, SignedInt - WAV only!");
+            msgBox.setText("Unknown format: 8/16/24/32bit int or 32bit float, 1-8 channels - WAV only!");
             msgBox.exec();
             ui->menu_Configure->setDisabled(true);
             ui->audioDeviceLabel->setText("No wav file loaded");
@@ -212,23 +303,15 @@ void MainWindow::actionConfigFilter()
         unsigned int mNumBinsHist = mAnalyzerSetting.mNumBinsHist;
 
         /* create a new Analyzer object and update all Analyzer signals and slots */
-        QObject::disconnect(m_Analyzer,
-                         SIGNAL( histogramReady(unsigned int *, const unsigned int, float) ),
-                         ui->paintArea,
-                         SLOT( drawHistogram(unsigned int *, const unsigned int, float) ));
-
         QObject::disconnect(m_audioInfo,
                           SIGNAL( audioDataReady(const double *, size_t, float) ),
                           m_Analyzer,
                           SLOT( doHistogram(const double *, size_t, float)) );
+        ui->paintArea->setSource(NULL);
         delete m_Analyzer;
 
         m_Analyzer  = new Analyzer(mNumBinsHist, NUM_FUTUREPAST_RINGBUF, NUM_ELEMENTS_RINGBUF,mBaseline, mPulseEvent);
-        QObject::connect(m_Analyzer,
-                         SIGNAL( histogramReady(unsigned int *, const unsigned int, float) ),
-                         ui->paintArea,
-                         SLOT( drawHistogram(unsigned int *, const unsigned int, float) ),
-                         Qt::BlockingQueuedConnection);
+        ui->paintArea->setSource(m_Analyzer->snapshot);
 
         QObject::connect(m_audioInfo,
                           SIGNAL( audioDataReady(const double *, size_t, float) ),
@@ -258,6 +341,8 @@ void MainWindow::onActionHelp()
                           "baseline: samples which are higher than this value are not recognized (noise supression)<br>" \
                           "<b>Num Average</b>:<br>" \
                           "baseline: total number of samples considered for baseline calculation (moving average)<br>" \
+                          "<b>Estimator</b>:<br>" \
+                          "baseline: filter over these samples, the original moving average, an exact sliding mean, an exponential average or a sliding median (robust against pile up)<br>" \
                           "<b>Trigger Threshold</b>:<br>" \
                           "pulse: samples with an excursion greater than this value from the baseline are recognized as a pulse<br>" \
                           "<b>Num Past</b>:<br>" \
@@ -270,8 +355,14 @@ void MainWindow::onActionHelp()
                           "upsampling for peak detection: create 'number-1' of intermediate interpolation points<br>" \
                           "<b>Window Size</b>:<br>" \
                           "half the window size, convolution length of the low pass filter (sinus cardinalis with rectangular window)<br>" \
+                          "<b>Peak Search</b>:<br>" \
+                          "upsample the whole pulse, or refine only the largest and smallest sample by a local search (faster)<br>" \
                           "<b>Soft Gain</b>:<br>" \
-                          "factor to amplify or attenuate the audiostream before it is processed</p>"));
+                          "factor to amplify or attenuate the audiostream before it is processed<br>" \
+                          "<b>Histogram view</b>:<br>" \
+                          "mouse wheel zooms around the cursor, double click shows all bins, right click toggles the logarithmic scale<br>" \
+                          "<b>Waterfall</b>:<br>" \
+                          "one histogram per minute of the record, time running downwards. right click toggles the logarithmic scale</p>"));
 }
 
 
@@ -289,6 +380,72 @@ void MainWindow::onActionSaveHistogram()
 }
 
 
+void MainWindow::onActionSaveStatistics()
+{
+    QString fileName = QFileDialog::getSaveFileName(
+                this,
+                "Save statistics as",
+                "./",
+                "json Files (*.json);;All Files (*.*)");
+    if (!fileName.isEmpty()){
+        QFile file(fileName);
+        if (!file.open(QIODevice::WriteOnly) ||
+            (file.write(QJsonDocument(statistics().toJson()).toJson()) < 0)){
+            QMessageBox::warning(
+                        this,
+                        "Save statistics as",
+                        tr("Cannot write file %1.\nError: %2")
+                        .arg(fileName)
+                        .arg(file.errorString()));
+        }
+    }
+}
+
+
+/* pulses per time slice and bin, as written by wav2phh-cli --slices */
+void MainWindow::onActionSaveTimeSlices()
+{
+    if (timeSlices.size() == 0){
+        QMessageBox::information(this, "Save time slices",
+                                 "No time slices: run the analysis first.");
+        return;
+    }
+    QString fileName = QFileDialog::getSaveFileName(
+                this,
+                "Save time slices as",
+                "./",
+                "txt Files (*.txt);;All Files (*.*)");
+    if (!fileName.isEmpty()){
+        if (!timeSlices.save(fileName, (double)(m_audioInfo->fileFormat().sampleRate()))){
+            QMessageBox::warning(
+                        this,
+                        "Save time slices as",
+                        tr("Cannot write file %1.").arg(fileName));
+        }
+    }
+}
+
+
+void MainWindow::onActionShowWaterfall()
+{
+    if (timeSlices.size() == 0){
+        QMessageBox::information(this, "Waterfall",
+                                 "No time slices: run the analysis first.");
+        return;
+    }
+    waterfall->setSlices(&timeSlices, sliceSeconds());
+    waterfall->show();
+    waterfall->raise();
+}
+
+
+double MainWindow::sliceSeconds()
+{
+    const int sampleRate = m_audioInfo != NULL ? m_audioInfo->fileFormat().sampleRate() : 0;
+    return sampleRate > 0 ? (double)(timeSlices.sliceLength()) / (double)(sampleRate) : 0.0;
+}
+
+
 void MainWindow::saveFile()
 {
     QFile file(fileToSave);
@@ -28,7 +28,11 @@
 #include "analyzer.h"
 
 #include "analyzersettings.h"
+#include "resultcache.h"
+#include "timeslices.h"
+#include "waterfallview.h"
 #include <QMainWindow>
+#include <QTimer>
 
 
 namespace Ui {
@@ -49,6 +53,7 @@ private:
     AnalyzerSettings mAnalyzerSetting;
 
 private slots:
+    void onRefreshTimer();
     void onDecodeFinished();
     void recordButtonStartRec();
     void recordButtonStopRec();
@@ -56,6 +61,9 @@ private slots:
     void onActionOpenWavfile();
     void actionConfigFilter();
     void onActionSaveHistogram();
+    void onActionSaveStatistics();
+    void onActionSaveTimeSlices();
+    void onActionShowWaterfall();
     void onActionAboutThis();
     void onActionHelp();
 
@@ -63,9 +71,23 @@ private:
     Ui::MainWindow *ui;
     Analyzer *m_Analyzer;
     AudioInfo * m_audioInfo = NULL;
+    QTimer * refreshTimer;
     QString fileToSave;
     QString wavFile;
     void saveFile();
+    PipelineStats statistics();
+    void showStatistics();
+    /* cacheParameters: the run in progress is stored when it finishes (empty:
+     * not). cacheKey is empty until the content hash of the file is known */
+    ResultCache resultCache;
+    QString cacheParameters;
+    QString cacheKey;
+    bool fromCache = false;
+    PipelineStats cachedStats;
+    /* filled by the analyzer thread while a run is going on */
+    TimeSlices timeSlices;
+    double sliceSeconds();
+    WaterfallView * waterfall;
 };
 
 #endif // MAINWINDOW_H
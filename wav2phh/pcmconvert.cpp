@@ -0,0 +1,324 @@
+/** \file pcmconvert.cpp
+ * \brief Block conversion of raw pcm samples into normalized doubles
+ *
+ * \author Copyright (C) 2014 samplemaker
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1
+ * of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free
+ * Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA
+ *
+ * @{
+ */
+
+#include <cmath>
+#include <cstring>
+#include <QtCore/qendian.h>
+#include "pcmconvert.h"
+
+/* the simd kernels are compiled with function level target attributes and
+ * selected at runtime, so the binary still runs on cpus without avx2 */
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define PCM_HAVE_X86_KERNELS 1
+#include <immintrin.h>
+#endif
+
+
+/**
+ *  The scale to full range (1/32767 for 16 bit) and the soft gain are folded
+ *  into one factor: y = (gain * fullscale) * x. Compared to the former
+ *  gain * (fullscale * x) the result may differ in the last bit. All kernels
+ *  convert x exactly into a double and do a single multiply, hence the simd
+ *  kernels and the reference give bitwise identical output.
+ *
+ *  The strided kernels read every stride-th byte position: the same code
+ *  extracts one channel out of interleaved frames. Byte order is fixed per
+ *  kernel, the format is resolved once in the constructor.
+ **/
+
+static void convertU8Ref(const unsigned char *src, double *dst, size_t num, double factor)
+{
+  for (size_t n = 0; n < num; n ++){
+    dst[n] = factor * (double)((int)(src[n]) - 128);
+  }
+}
+
+
+static void convertS16Ref(const unsigned char *src, double *dst, size_t num, double factor)
+{
+  for (size_t n = 0; n < num; n ++){
+    dst[n] = factor * (double)(qFromLittleEndian<qint16>(src + 2 * n));
+  }
+}
+
+
+static void stridedU8(const unsigned char *src, double *dst, size_t num, size_t stride, double factor)
+{
+  for (size_t n = 0; n < num; n ++, src += stride){
+    dst[n] = factor * (double)((int)(src[0]) - 128);
+  }
+}
+
+
+static void stridedS16LE(const unsigned char *src, double *dst, size_t num, size_t stride, double factor)
+{
+  for (size_t n = 0; n < num; n ++, src += stride){
+    dst[n] = factor * (double)(qFromLittleEndian<qint16>(src));
+  }
+}
+
+
+static void stridedS16BE(const unsigned char *src, double *dst, size_t num, size_t stride, double factor)
+{
+  for (size_t n = 0; n < num; n ++, src += stride){
+    dst[n] = factor * (double)(qFromBigEndian<qint16>(src));
+  }
+}
+
+
+/* 24 bit: assemble in the upper three bytes of an int32, shift back with sign */
+static void stridedS24LE(const unsigned char *src, double *dst, size_t num, size_t stride, double factor)
+{
+  for (size_t n = 0; n < num; n ++, src += stride){
+    const qint32 v = (qint32)(((quint32)(src[2]) << 24) | ((quint32)(src[1]) << 16) | ((quint32)(src[0]) << 8)) >> 8;
+    dst[n] = factor * (double)(v);
+  }
+}
+
+
+static void stridedS24BE(const unsigned char *src, double *dst, size_t num, size_t stride, double factor)
+{
+  for (size_t n = 0; n < num; n ++, src += stride){
+    const qint32 v = (qint32)(((quint32)(src[0]) << 24) | ((quint32)(src[1]) << 16) | ((quint32)(src[2]) << 8)) >> 8;
+    dst[n] = factor * (double)(v);
+  }
+}
+
+
+static void stridedS32LE(const unsigned char *src, double *dst, size_t num, size_t stride, double factor)
+{
+  for (size_t n = 0; n < num; n ++, src += stride){
+    dst[n] = factor * (double)(qFromLittleEndian<qint32>(src));
+  }
+}
+
+
+static void stridedS32BE(const unsigned char *src, double *dst, size_t num, size_t stride, double factor)
+{
+  for (size_t n = 0; n < num; n ++, src += stride){
+    dst[n] = factor * (double)(qFromBigEndian<qint32>(src));
+  }
+}
+
+
+static void stridedF32LE(const unsigned char *src, double *dst, size_t num, size_t stride, double factor)
+{
+  for (size_t n = 0; n < num; n ++, src += stride){
+    const quint32 bits = qFromLittleEndian<quint32>(src);
+    float v;
+    memcpy(&v, &bits, sizeof(v));
+    dst[n] = factor * (double)(v);
+  }
+}
+
+
+static void stridedF32BE(const unsigned char *src, double *dst, size_t num, size_t stride, double factor)
+{
+  for (size_t n = 0; n < num; n ++, src += stride){
+    const quint32 bits = qFromBigEndian<quint32>(src);
+    float v;
+    memcpy(&v, &bits, sizeof(v));
+    dst[n] = factor * (double)(v);
+  }
+}
+
+
+#ifdef PCM_HAVE_X86_KERNELS
+
+__attribute__((target("sse2")))
+static void convertS16Sse2(const unsigned char *src, double *dst, size_t num, double factor)
+{
+  const __m128d f = _mm_set1_pd(factor);
+  size_t n = 0;
+  /* 8 samples per round: sign extend 16 -> 32 bit, convert pairwise to double */
+  for (; n + 8 <= num; n += 8){
+    const __m128i v = _mm_loadu_si128((const __m128i *)(src + 2 * n));
+    const __m128i lo = _mm_srai_epi32(_mm_unpacklo_epi16(v, v), 16);
+    const __m128i hi = _mm_srai_epi32(_mm_unpackhi_epi16(v, v), 16);
+    _mm_storeu_pd(dst + n,     _mm_mul_pd(_mm_cvtepi32_pd(lo), f));
+    _mm_storeu_pd(dst + n + 2, _mm_mul_pd(_mm_cvtepi32_pd(_mm_shuffle_epi32(lo, 0xee)), f));
+    _mm_storeu_pd(dst + n + 4, _mm_mul_pd(_mm_cvtepi32_pd(hi), f));
+    _mm_storeu_pd(dst + n + 6, _mm_mul_pd(_mm_cvtepi32_pd(_mm_shuffle_epi32(hi, 0xee)), f));
+  }
+  convertS16Ref(src + 2 * n, dst + n, num - n, factor);
+}
+
+
+__attribute__((target("avx2")))
+static void convertS16Avx2(const unsigned char *src, double *dst, size_t num, double factor)
+{
+  const __m256d f = _mm256_set1_pd(factor);
+  size_t n = 0;
+  /* 16 samples per round */
+  for (; n + 16 <= num; n += 16){
+    const __m256i v0 = _mm256_cvtepi16_epi32(_mm_loadu_si128((const __m128i *)(src + 2 * n)));
+    const __m256i v1 = _mm256_cvtepi16_epi32(_mm_loadu_si128((const __m128i *)(src + 2 * n + 16)));
+    _mm256_storeu_pd(dst + n,      _mm256_mul_pd(_mm256_cvtepi32_pd(_mm256_castsi256_si128(v0)), f));
+    _mm256_storeu_pd(dst + n + 4,  _mm256_mul_pd(_mm256_cvtepi32_pd(_mm256_extracti128_si256(v0, 1)), f));
+    _mm256_storeu_pd(dst + n + 8,  _mm256_mul_pd(_mm256_cvtepi32_pd(_mm256_castsi256_si128(v1)), f));
+    _mm256_storeu_pd(dst + n + 12, _mm256_mul_pd(_mm256_cvtepi32_pd(_mm256_extracti128_si256(v1, 1)), f));
+  }
+  convertS16Ref(src + 2 * n, dst + n, num - n, factor);
+}
+
+#endif
+
+
+PcmConverter::PcmConverter (int sampleBits, bool isFloat, bool bigEndian, int numChannels) {
+  bits = sampleBits;
+  channels = numChannels;
+  sampleBytes = bits / 8;
+  kernel = NULL;
+  strided = NULL;
+  s16Native = false;
+  name = "unsupported";
+  fullScale = 0.0;
+  if (isFloat){
+    if (bits == 32){
+      fullScale = 1.0;
+      strided = bigEndian ? stridedF32BE : stridedF32LE;
+      name = "f32-scalar";
+    }
+  }
+  else{
+    switch (bits){
+      case 8:
+        fullScale = 1.0 / (double)(127);
+        kernel = convertU8Ref;
+        strided = stridedU8;
+        name = "u8-scalar";
+      break;
+      case 16:
+        fullScale = 1.0 / (double)(32767);
+        strided = bigEndian ? stridedS16BE : stridedS16LE;
+        name = "s16-scalar";
+        if (!bigEndian && (channels == 1)){
+          s16Native = true;
+          if (!selectKernel("avx2") && !selectKernel("sse2")){
+            selectKernel("scalar");
+          }
+        }
+      break;
+      case 24:
+        fullScale = 1.0 / (double)(8388607);
+        strided = bigEndian ? stridedS24BE : stridedS24LE;
+        name = "s24-scalar";
+      break;
+      case 32:
+        fullScale = 1.0 / (double)(2147483647);
+        strided = bigEndian ? stridedS32BE : stridedS32LE;
+        name = "s32-scalar";
+      break;
+      default:
+      break;
+    }
+  }
+  /* float32 has a 24 bit mantissa */
+  normScale = 0.0;
+  if (isFloat){
+    normScale = (fullScale != 0.0) ? 1.0 : 0.0;
+  }
+  else if ((fullScale != 0.0) && (bits <= 24)){
+    normScale = ldexp(1.0, 1 - bits);
+  }
+  /* the contiguous kernels only work on single channel data */
+  if (channels != 1){
+    kernel = NULL;
+  }
+  setGain(1.0);
+}
+
+
+bool PcmConverter::isSupported(){
+  return(strided != NULL);
+}
+
+
+void PcmConverter::setGain(double gain){
+  factor = gain * fullScale;
+}
+
+
+void PcmConverter::convert(const unsigned char *src, double *dst, size_t numFrames, int channel){
+  if (kernel != NULL){
+    kernel(src, dst, numFrames, factor);
+  }
+  else{
+    strided(src + channel * sampleBytes, dst, numFrames, channels * sampleBytes, factor);
+  }
+}
+
+
+void PcmConverter::convertReference(const unsigned char *src, double *dst, size_t numFrames, int channel){
+  strided(src + channel * sampleBytes, dst, numFrames, channels * sampleBytes, factor);
+}
+
+
+bool PcmConverter::selectKernel(const char *simd){
+  if (strcmp(simd, "scalar") == 0){
+    if (s16Native){
+      kernel = convertS16Ref;
+      name = "s16-scalar";
+    }
+    return(isSupported());
+  }
+#ifdef PCM_HAVE_X86_KERNELS
+  __builtin_cpu_init();
+  if (s16Native && (strcmp(simd, "sse2") == 0) && __builtin_cpu_supports("sse2")){
+    kernel = convertS16Sse2;
+    name = "s16-sse2";
+    return(true);
+  }
+  if (s16Native && (strcmp(simd, "avx2") == 0) && __builtin_cpu_supports("avx2")){
+    kernel = convertS16Avx2;
+    name = "s16-avx2";
+    return(true);
+  }
+#endif
+  return(false);
+}
+
+
+const char * PcmConverter::kernelName(){
+  return(name);
+}
+
+
+double PcmConverter::normalizedScale(){
+  return(normScale);
+}
+
+
+void PcmConverter::setNormalized(){
+  factor = normScale;
+}
+
+
+/* normScale is a power of two: factor / normScale * (x * normScale) rounds
+ * exactly as factor * x */
+void PcmConverter::convertNormalized(const float *src, double *dst, size_t num){
+  const double f = factor / normScale;
+  for (size_t n = 0; n < num; n ++){
+    dst[n] = f * (double)(src[n]);
+  }
+}
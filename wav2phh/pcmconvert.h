@@ -0,0 +1,72 @@
+/** \file pcmconvert.h
+ * \brief Block conversion of raw pcm samples into normalized doubles
+ *
+ * \author Copyright (C) 2014 samplemaker
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1
+ * of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free
+ * Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA
+ *
+ * @{
+ */
+
+#ifndef PCMCONVERT_H
+#define PCMCONVERT_H
+
+#include <cstdlib>
+
+
+class PcmConverter
+{
+
+  public:
+    /* sampleBits: 8 (unsigned), 16, 24, 32 (signed) or 32 with isFloat.
+     * numChannels interleaved channels per frame */
+    PcmConverter (int sampleBits, bool isFloat = false, bool bigEndian = false, int numChannels = 1);
+    bool isSupported();
+    void setGain(double gain);
+    /* dst[n] = gain * fullscale * src[n] for numFrames frames of one channel */
+    void convert(const unsigned char *src, double *dst, size_t numFrames, int channel = 0);
+    /* plain c++ version of convert() with identical results */
+    void convertReference(const unsigned char *src, double *dst, size_t numFrames, int channel = 0);
+    const char * kernelName();
+    /* use the kernel with this suffix ("scalar", "sse2" or "avx2") instead of
+     * the fastest one. false if the format or the cpu has no such kernel */
+    bool selectKernel(const char *simd);
+    /* scale at which float32 holds the samples exactly: 2^-(bits - 1) for
+     * integers up to 24 bit, 1 for float. 0 for 32 bit integers */
+    double normalizedScale();
+    /* convert() delivers the samples times normalizedScale(), without gain */
+    void setNormalized();
+    /* from normalized samples to exactly what convert() gives (see sidecar.h) */
+    void convertNormalized(const float *src, double *dst, size_t num);
+  private:
+    typedef void (*Kernel)(const unsigned char *src, double *dst, size_t num, double factor);
+    /* generic: samples are stride bytes apart */
+    typedef void (*StridedKernel)(const unsigned char *src, double *dst, size_t num, size_t stride, double factor);
+    int bits;
+    int channels;
+    /* 16 bit little endian mono: the simd kernels apply */
+    bool s16Native;
+    size_t sampleBytes;
+    double fullScale;
+    double normScale;
+    double factor;
+    Kernel kernel;
+    StridedKernel strided;
+    const char * name;
+};
+
+
+#endif
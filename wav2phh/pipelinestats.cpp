@@ -0,0 +1,176 @@
+/** \file pipelinestats.cpp
+ * \brief Counters and stage timings of the decode and analysis pipeline
+ *
+ * \author Copyright (C) 2014 samplemaker
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1
+ * of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free
+ * Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA
+ *
+ * @{
+ */
+
+#include <QMutexLocker>
+#include "pipelinestats.h"
+
+
+PipelineStats::PipelineStats () {
+  clear();
+}
+
+
+void PipelineStats::clear(){
+  bytesDecoded = 0;
+  framesDecoded = 0;
+  blocksDecoded = 0;
+  blocksAnalyzed = 0;
+  samplesAnalyzed = 0;
+  baselineUpdates = 0;
+  quietSamples = 0;
+  triggers = 0;
+  accepted = 0;
+  counted = 0;
+  glitchShort = 0;
+  glitchLong = 0;
+  outOfRange = 0;
+  outsideWindow = 0;
+  truncated = 0;
+  nsDecode = 0;
+  nsRead = 0;
+  nsConvert = 0;
+  nsHandover = 0;
+  nsAnalyze = 0;
+  nsHeight = 0;
+  nsPublish = 0;
+}
+
+
+void PipelineStats::add(const PipelineStats &other){
+  bytesDecoded += other.bytesDecoded;
+  framesDecoded += other.framesDecoded;
+  blocksDecoded += other.blocksDecoded;
+  blocksAnalyzed += other.blocksAnalyzed;
+  samplesAnalyzed += other.samplesAnalyzed;
+  baselineUpdates += other.baselineUpdates;
+  quietSamples += other.quietSamples;
+  triggers += other.triggers;
+  accepted += other.accepted;
+  counted += other.counted;
+  glitchShort += other.glitchShort;
+  glitchLong += other.glitchLong;
+  outOfRange += other.outOfRange;
+  outsideWindow += other.outsideWindow;
+  truncated += other.truncated;
+  nsDecode += other.nsDecode;
+  nsRead += other.nsRead;
+  nsConvert += other.nsConvert;
+  nsHandover += other.nsHandover;
+  nsAnalyze += other.nsAnalyze;
+  nsHeight += other.nsHeight;
+  nsPublish += other.nsPublish;
+}
+
+
+/* pulses outside of the count window are counted by another segment */
+quint64 PipelineStats::lost() const{
+  return(glitchShort + glitchLong + outOfRange);
+}
+
+
+QJsonObject PipelineStats::toJson() const{
+  QJsonObject decoder;
+  decoder["bytes"] = (double)(bytesDecoded);
+  decoder["frames"] = (double)(framesDecoded);
+  decoder["blocks"] = (double)(blocksDecoded);
+  QJsonObject analyzer;
+  analyzer["blocks"] = (double)(blocksAnalyzed);
+  analyzer["samples"] = (double)(samplesAnalyzed);
+  analyzer["baselineUpdates"] = (double)(baselineUpdates);
+  analyzer["quietSamples"] = (double)(quietSamples);
+  analyzer["triggers"] = (double)(triggers);
+  analyzer["accepted"] = (double)(accepted);
+  analyzer["counted"] = (double)(counted);
+  analyzer["truncated"] = (double)(truncated);
+  QJsonObject rejected;
+  rejected["glitchShort"] = (double)(glitchShort);
+  rejected["glitchLong"] = (double)(glitchLong);
+  rejected["outOfRange"] = (double)(outOfRange);
+  rejected["outsideWindow"] = (double)(outsideWindow);
+  QJsonObject nsecs;
+  nsecs["decode"] = (double)(nsDecode);
+  nsecs["read"] = (double)(nsRead);
+  nsecs["convert"] = (double)(nsConvert);
+  nsecs["handover"] = (double)(nsHandover);
+  nsecs["analyze"] = (double)(nsAnalyze);
+  nsecs["height"] = (double)(nsHeight);
+  nsecs["publish"] = (double)(nsPublish);
+  QJsonObject all;
+  all["decoder"] = decoder;
+  all["analyzer"] = analyzer;
+  all["rejected"] = rejected;
+  all["nsecs"] = nsecs;
+  return(all);
+}
+
+
+PipelineStats PipelineStats::fromJson(const QJsonObject &json){
+  const QJsonObject decoder = json.value("decoder").toObject();
+  const QJsonObject analyzer = json.value("analyzer").toObject();
+  const QJsonObject rejected = json.value("rejected").toObject();
+  const QJsonObject nsecs = json.value("nsecs").toObject();
+  PipelineStats s;
+  s.bytesDecoded = (quint64)(decoder.value("bytes").toDouble());
+  s.framesDecoded = (quint64)(decoder.value("frames").toDouble());
+  s.blocksDecoded = (quint64)(decoder.value("blocks").toDouble());
+  s.blocksAnalyzed = (quint64)(analyzer.value("blocks").toDouble());
+  s.samplesAnalyzed = (quint64)(analyzer.value("samples").toDouble());
+  s.baselineUpdates = (quint64)(analyzer.value("baselineUpdates").toDouble());
+  s.quietSamples = (quint64)(analyzer.value("quietSamples").toDouble());
+  s.triggers = (quint64)(analyzer.value("triggers").toDouble());
+  s.accepted = (quint64)(analyzer.value("accepted").toDouble());
+  s.counted = (quint64)(analyzer.value("counted").toDouble());
+  s.truncated = (quint64)(analyzer.value("truncated").toDouble());
+  s.glitchShort = (quint64)(rejected.value("glitchShort").toDouble());
+  s.glitchLong = (quint64)(rejected.value("glitchLong").toDouble());
+  s.outOfRange = (quint64)(rejected.value("outOfRange").toDouble());
+  s.outsideWindow = (quint64)(rejected.value("outsideWindow").toDouble());
+  s.nsDecode = (qint64)(nsecs.value("decode").toDouble());
+  s.nsRead = (qint64)(nsecs.value("read").toDouble());
+  s.nsConvert = (qint64)(nsecs.value("convert").toDouble());
+  s.nsHandover = (qint64)(nsecs.value("handover").toDouble());
+  s.nsAnalyze = (qint64)(nsecs.value("analyze").toDouble());
+  s.nsHeight = (qint64)(nsecs.value("height").toDouble());
+  s.nsPublish = (qint64)(nsecs.value("publish").toDouble());
+  return(s);
+}
+
+
+QString PipelineStats::summary() const{
+  const double perSample = samplesAnalyzed > 0 ? (double)(nsAnalyze) / (double)(samplesAnalyzed) : 0.0;
+  return(QString("triggers %1, counted %2, rejected: glitch %3/%4, range %5, truncated %6, analyzer %7 ns/sample")
+         .arg(triggers).arg(counted).arg(glitchShort).arg(glitchLong)
+         .arg(outOfRange).arg(truncated).arg(perSample, 0, 'f', 1));
+}
+
+
+void StatsBoard::publish(const PipelineStats &stats){
+  QMutexLocker locker(&mutex);
+  data = stats;
+}
+
+
+PipelineStats StatsBoard::read(){
+  QMutexLocker locker(&mutex);
+  return(data);
+}
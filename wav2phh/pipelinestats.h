@@ -0,0 +1,100 @@
+/** \file pipelinestats.h
+ * \brief Counters and stage timings of the decode and analysis pipeline
+ *
+ * \author Copyright (C) 2014 samplemaker
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1
+ * of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free
+ * Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA
+ *
+ * @{
+ */
+
+#ifndef PIPELINESTATS_H
+#define PIPELINESTATS_H
+
+#include <QtGlobal>
+#include <QJsonObject>
+#include <QMutex>
+#include <QString>
+
+
+/**
+ *  Every stage owns an instance of its own which only its thread writes:
+ *  plain integers, no atomics, no locks in the sample loop. AudioInfo fills
+ *  the decoder fields, Analyzer the analyzer fields, the others stay zero, so
+ *  add() combines the stages (or the analyzers of several channels) into one
+ *  view of the whole run.
+ *
+ *  The times are cumulative wall clock nanoseconds. nsHeight and nsPublish are
+ *  part of nsAnalyze. In a sequential run the analyzer is called from within
+ *  the handover of the decoder, so nsAnalyze is part of nsHandover as well.
+ **/
+class PipelineStats
+{
+
+  public:
+    PipelineStats ();
+    void clear();
+    void add(const PipelineStats &other);
+    /* pulses which triggered but did not go into the histogram */
+    quint64 lost() const;
+    QJsonObject toJson() const;
+    /* the inverse of toJson(), missing values are 0 */
+    static PipelineStats fromJson(const QJsonObject &json);
+    /* one line for a status display */
+    QString summary() const;
+    /* decoder */
+    quint64 bytesDecoded;
+    quint64 framesDecoded;
+    quint64 blocksDecoded;
+    /* analyzer */
+    quint64 blocksAnalyzed;
+    quint64 samplesAnalyzed;
+    quint64 baselineUpdates;
+    quint64 quietSamples;     /* skipped by the trigger pre-scan */
+    quint64 triggers;
+    quint64 accepted;         /* passed the glitch filter */
+    quint64 counted;          /* went into the histogram */
+    quint64 glitchShort;      /* rejected: pulse width <= minGlitchFilter */
+    quint64 glitchLong;       /* rejected: pulse width >= maxGlitchFilter */
+    quint64 outOfRange;       /* rejected: height beyond the last bin */
+    quint64 outsideWindow;    /* triggered outside of the count window (segments) */
+    quint64 truncated;        /* pulses reaching beyond the end of the block */
+    /* cumulative time per stage */
+    qint64 nsDecode;          /* AudioInfo::decode() as a whole */
+    qint64 nsRead;            /* file reads, 0 if the file is mapped */
+    qint64 nsConvert;         /* pcm to double and deinterleaving */
+    qint64 nsHandover;        /* audioDataReady / block queue writes */
+    qint64 nsAnalyze;         /* Analyzer::doHistogram() */
+    qint64 nsHeight;          /* pulse height estimation */
+    qint64 nsPublish;         /* histogram snapshots */
+};
+
+
+/* hands a copy of the counters of a running stage to other threads (gui,
+ * cli). the owner publishes now and then, a lock per publish is negligible */
+class StatsBoard
+{
+
+  public:
+    void publish(const PipelineStats &stats);
+    PipelineStats read();
+  private:
+    QMutex mutex;
+    PipelineStats data;
+};
+
+
+#endif
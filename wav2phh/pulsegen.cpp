@@ -0,0 +1,193 @@
+/** \file pulsegen.cpp
+ * \brief Deterministic synthetic detector signal for benchmarks and tests
+ *
+ * \author Copyright (C) 2014 samplemaker
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1
+ * of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free
+ * Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA
+ *
+ * @{
+ */
+
+#include <cmath>
+#include <QFile>
+#include <QtCore/qendian.h>
+#include "pulsegen.h"
+
+/* samples converted per write in writeWav() */
+#define PULSEGEN_WAV_BLOCK 65536
+
+
+PulseGenParams::PulseGenParams () {
+  sampleRate = 48000.0;
+  rate = 1000.0;
+  peakingSamples = 3.0;
+  order = 4;
+  SpectrumLine low = {0.30, 1.0, 0.004};
+  SpectrumLine high = {0.62, 0.5, 0.006};
+  lines.append(low);
+  lines.append(high);
+  continuum = 0.3;
+  maxHeight = 0.9;
+  noise = 0.001;
+  driftAmplitude = 0.002;
+  driftPeriod = 10.0;
+  seed = 1;
+}
+
+
+PulseGenerator::PulseGenerator (const PulseGenParams &params) {
+  par = params;
+  rngState = par.seed;
+  pulseCount = 0;
+  sampleCount = 0;
+  totalWeight = 0.0;
+  for (int i = 0; i < par.lines.size(); i ++){
+    totalWeight += par.lines.at(i).weight;
+  }
+  /* rate 0: noise and drift only */
+  nextStart = (par.rate > 0.0) ? -log(1.0 - uniform()) * par.sampleRate / par.rate : HUGE_VAL;
+}
+
+
+/* splitmix64, uniform in [0, 1) with 53 bit */
+double PulseGenerator::uniform () {
+  rngState += Q_UINT64_C(0x9e3779b97f4a7c15);
+  quint64 z = rngState;
+  z = (z ^ (z >> 30)) * Q_UINT64_C(0xbf58476d1ce4e5b9);
+  z = (z ^ (z >> 27)) * Q_UINT64_C(0x94d049bb133111eb);
+  z = z ^ (z >> 31);
+  return((double)(z >> 11) * (1.0 / 9007199254740992.0));
+}
+
+
+/* box muller, one value per call */
+double PulseGenerator::gaussian () {
+  const double u1 = 1.0 - uniform();
+  const double u2 = uniform();
+  return(sqrt(-2.0 * log(u1)) * cos(2.0 * M_PI * u2));
+}
+
+
+double PulseGenerator::drawHeight () {
+  if ((par.lines.isEmpty()) || (uniform() < par.continuum)){
+    return(par.maxHeight * (1.0 - uniform()));
+  }
+  double pick = uniform() * totalWeight;
+  int i = 0;
+  while ((i + 1 < par.lines.size()) && (pick >= par.lines.at(i).weight)){
+    pick -= par.lines.at(i).weight;
+    i ++;
+  }
+  return(par.lines.at(i).height + par.lines.at(i).sigma * gaussian());
+}
+
+
+/* unit pulse, t in samples after the start */
+double PulseGenerator::shape (double t) {
+  if (t <= 0.0){
+    return(0.0);
+  }
+  const double x = t / par.peakingSamples;
+  return(pow(x, par.order) * exp(par.order * (1.0 - x)));
+}
+
+
+void PulseGenerator::generate (double *dst, size_t num) {
+  const double length = PULSEGEN_LENGTH_PEAKS * par.peakingSamples;
+  const double meanGap = par.sampleRate / par.rate;
+  const double driftOmega = 2.0 * M_PI / (par.driftPeriod * par.sampleRate);
+  for (size_t n = 0; n < num; n ++){
+    const double t = (double)(sampleCount);
+    /* start all pulses up to now */
+    while (nextStart <= t){
+      activeStart.append(nextStart);
+      activeHeight.append(drawHeight());
+      pulseCount ++;
+      nextStart += -log(1.0 - uniform()) * meanGap;
+    }
+    /* drop the pulses which have decayed (they are ordered by start) */
+    int numOld = 0;
+    while ((numOld < activeStart.size()) && (t - activeStart.at(numOld) > length)){
+      numOld ++;
+    }
+    if (numOld > 0){
+      activeStart.remove(0, numOld);
+      activeHeight.remove(0, numOld);
+    }
+    double value = par.driftAmplitude * sin(driftOmega * t) + par.noise * gaussian();
+    for (int i = 0; i < activeStart.size(); i ++){
+      value += activeHeight.at(i) * shape(t - activeStart.at(i));
+    }
+    dst[n] = value;
+    sampleCount ++;
+  }
+}
+
+
+void PulseGenerator::generatePcm16 (qint16 *dst, size_t num) {
+  double buf[256];
+  while (num > 0){
+    const size_t chunk = num < 256 ? num : 256;
+    generate(buf, chunk);
+    for (size_t n = 0; n < chunk; n ++){
+      const double v = floor(buf[n] * 32767.0 + 0.5);
+      dst[n] = (qint16)(v > 32767.0 ? 32767.0 : (v < -32767.0 ? -32767.0 : v));
+    }
+    dst += chunk;
+    num -= chunk;
+  }
+}
+
+
+/* canonical 44 byte header */
+bool PulseGenerator::writeWav (const QString &fileName, quint64 numSamples) {
+  QFile file(fileName);
+  if (!file.open(QIODevice::WriteOnly)){
+    return(false);
+  }
+  const quint32 rate = (quint32)(par.sampleRate);
+  const quint32 dataBytes = (quint32)(numSamples * 2);
+  uchar header[44];
+  memcpy(header, "RIFF", 4);
+  qToLittleEndian<quint32>(36 + dataBytes, header + 4);
+  memcpy(header + 8, "WAVEfmt ", 8);
+  qToLittleEndian<quint32>(16, header + 16);
+  qToLittleEndian<quint16>(1, header + 20);          /* pcm */
+  qToLittleEndian<quint16>(1, header + 22);          /* mono */
+  qToLittleEndian<quint32>(rate, header + 24);
+  qToLittleEndian<quint32>(rate * 2, header + 28);   /* bytes per second */
+  qToLittleEndian<quint16>(2, header + 32);          /* bytes per frame */
+  qToLittleEndian<quint16>(16, header + 34);
+  memcpy(header + 36, "data", 4);
+  qToLittleEndian<quint32>(dataBytes, header + 40);
+  if (file.write((const char *)(header), sizeof(header)) != sizeof(header)){
+    return(false);
+  }
+  QVector<qint16> pcm(PULSEGEN_WAV_BLOCK);
+  QVector<uchar> raw(2 * PULSEGEN_WAV_BLOCK);
+  while (numSamples > 0){
+    const size_t num = numSamples < PULSEGEN_WAV_BLOCK ? numSamples : PULSEGEN_WAV_BLOCK;
+    generatePcm16(pcm.data(), num);
+    for (size_t n = 0; n < num; n ++){
+      qToLittleEndian<qint16>(pcm[n], raw.data() + 2 * n);
+    }
+    if (file.write((const char *)(raw.data()), 2 * num) != (qint64)(2 * num)){
+      return(false);
+    }
+    numSamples -= num;
+  }
+  return(true);
+}
@@ -0,0 +1,109 @@
+/** \file pulsegen.h
+ * \brief Deterministic synthetic detector signal for benchmarks and tests
+ *
+ * \author Copyright (C) 2014 samplemaker
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1
+ * of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free
+ * Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA
+ *
+ * @{
+ */
+
+#ifndef PULSEGEN_H
+#define PULSEGEN_H
+
+#include <cstdlib>
+#include <QtGlobal>
+#include <QString>
+#include <QVector>
+
+/* the pulses are cut off this many peaking times after their start */
+#define PULSEGEN_LENGTH_PEAKS 8
+
+
+/* one line of the spectrum: pulse height (full scale = 1), relative number
+ * of pulses and the gaussian width (sigma) of the line */
+struct SpectrumLine
+{
+  double height;
+  double weight;
+  double sigma;
+};
+
+
+class PulseGenParams
+{
+  public:
+    double sampleRate;      /* samples per second */
+    double rate;            /* mean pulses per second (poisson arrivals), 0: none */
+    double peakingSamples;  /* samples from the start to the peak of a pulse */
+    int order;              /* n of the CR-RC^n shaper */
+    QVector<SpectrumLine> lines;
+    double continuum;       /* fraction of pulses with a flat height in (0, maxHeight] */
+    double maxHeight;
+    double noise;           /* sigma of the white gaussian noise */
+    double driftAmplitude;  /* sinusoidal baseline drift */
+    double driftPeriod;     /* seconds */
+    quint64 seed;
+    /* the defaults: 6 samples per pulse at 48 kHz, two lines on a continuum */
+    PulseGenParams ();
+};
+
+
+/**
+ *  Generates a detector signal as it comes out of a semi-gaussian shaper:
+ *  CR-RC^n pulses u(t) = a (t/tp)^n exp(n (1 - t/tp)) with the peak a at
+ *  t = tp, starting at poisson distributed times (piled up pulses add), plus
+ *  white gaussian noise and a slow sinusoidal baseline drift.
+ *
+ *  The sequence only depends on the parameters including the seed: a private
+ *  random generator (splitmix64) is used instead of the std distributions,
+ *  whose output differs between the standard libraries. Hence the same
+ *  signal is produced on every platform and by every build.
+ **/
+class PulseGenerator
+{
+
+  public:
+    /* constructor */
+    PulseGenerator (const PulseGenParams &params);
+    /* the next num samples of the stream */
+    void generate (double *dst, size_t num);
+    /* the same as 16 bit pcm (clipped to full range) */
+    void generatePcm16 (qint16 *dst, size_t num);
+    /* writes numSamples of the stream as a 16 bit mono wav file */
+    bool writeWav (const QString &fileName, quint64 numSamples);
+    /* pulses started so far */
+    inline quint64 numPulses () { return pulseCount; }
+    inline quint64 numSamples () { return sampleCount; }
+  private:
+    PulseGenParams par;
+    quint64 rngState;
+    quint64 pulseCount;
+    quint64 sampleCount;
+    /* start time (in samples) of the next pulse */
+    double nextStart;
+    /* pulses still contributing: start time and height */
+    QVector<double> activeStart;
+    QVector<double> activeHeight;
+    double totalWeight;
+    double uniform ();
+    double gaussian ();
+    double drawHeight ();
+    double shape (double t);
+};
+
+
+#endif
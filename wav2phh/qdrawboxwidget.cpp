@@ -22,17 +22,35 @@
  */
 
 #include <QPainter>
+#include <QWheelEvent>
+#include <QMouseEvent>
 
 #include "qdrawboxwidget.h"
 
 QDrawBoxWidget::QDrawBoxWidget(QWidget *parent) : QWidget(parent)
 {
     setMinimumSize(maxx, maxy);
-    pixmap = new QPixmap(maxx, maxy);
-    QPainter paintToMap(pixmap);
-    paintToMap.setPen(QColor("#ffffff"));
-    paintToMap.setBrush(QBrush("#ffffff"));
-    paintToMap.drawRect(0, 0, maxx, maxy);
+    frame = QImage(maxx, maxy, QImage::Format_RGB32);
+    frame.fill(Qt::white);
+    numBins = 0;
+    logScale = false;
+    viewFirst = 0;
+    viewLast = 0;
+
+    qRegisterMetaType<HistogramSnapshot*>("HistogramSnapshot*");
+    /* all drawing of histograms happens on the render thread */
+    renderer = new HistogramRenderer(maxx, maxy);
+    renderer->moveToThread(&renderThread);
+    connect(renderer, SIGNAL(frameReady(const QImage &)), this, SLOT(setFrame(const QImage &)), Qt::QueuedConnection);
+    renderThread.start();
+}
+
+
+QDrawBoxWidget::~QDrawBoxWidget()
+{
+    renderThread.quit();
+    renderThread.wait();
+    delete renderer;
 }
 
 //a paint event happens if repaint() or update() was invoked
@@ -40,92 +58,106 @@ void QDrawBoxWidget::paintEvent(QPaintEvent *event) {
     Q_UNUSED(event);
 
     QPainter painter(this);
-    painter.drawPixmap(QPoint(0,0), *pixmap);
+    painter.drawImage(QPoint(0,0), frame);
 }
 
 void QDrawBoxWidget::drawLine(int x1, int y1, int x2, int y2)
 {
-    QPainter paintToMap(pixmap);
+    QPainter paintToMap(&frame);
     paintToMap.setPen(QPen(Qt::red, 1));
     paintToMap.drawLine(x1, maxy - y1, x2, maxy - y2);
+    update();
 }
 
 
-void QDrawBoxWidget::drawHistogram(unsigned int * histogram, const unsigned int numBins, float percent)
+void QDrawBoxWidget::setSource(HistogramSnapshot * snapshot)
 {
-    const int xMargin = 20;
-    const int yMargin = 25;
+    numBins = snapshot != NULL ? snapshot->size() : 0;
+    viewFirst = 0;
+    viewLast = 0;
+    /* the renderer never waits for the gui, hence no dead lock */
+    QMetaObject::invokeMethod(renderer, "setSource", Qt::BlockingQueuedConnection,
+                              Q_ARG(HistogramSnapshot*, snapshot));
+}
 
-    QPainter paintToMap(pixmap);
-    /*paintToMap.setPen(QColor("#ffffff"));
-    paintToMap.setBrush(QBrush("#ffffff"));*/
-    paintToMap.setBrush(Qt::darkBlue);
-    paintToMap.drawRect(0, 0, maxx, maxy);
 
-    paintToMap.setPen(QPen(Qt::red, 1));
-    unsigned int binMaxY = 0;
-    unsigned int binMaxX = 0;
-    for (unsigned int i = 0; i < numBins; i ++){
-        if (histogram[i] > binMaxY) { binMaxY = histogram[i]; binMaxX = i;}
-    }
+void QDrawBoxWidget::refresh(void)
+{
+    renderer->schedule();
+}
+
+
+/* frames arrive from the render thread. several of them between two paint
+ * events are merged into one by update() */
+void QDrawBoxWidget::setFrame(const QImage &image)
+{
+    frame = image;
+    update();
+}
+
+
+void QDrawBoxWidget::updateView(void)
+{
+    QMetaObject::invokeMethod(renderer, "setView", Qt::QueuedConnection,
+                              Q_ARG(bool, logScale),
+                              Q_ARG(unsigned int, viewFirst),
+                              Q_ARG(unsigned int, viewLast));
+}
 
-    /* \TODO: Fixme: Draw the last point */
-    for (unsigned int i = 0; i < numBins - 1; i ++){
-        if (numBins < maxx){
-            /* histogram resolution less than display resolution */
-            unsigned int y1 = (unsigned int)((double)(maxy - 2*yMargin) * (double)(histogram[i]) / (double)(binMaxY) );
-            unsigned int x1 = (unsigned int)((double)(maxx - 3*xMargin) * (double)(i) / (double)(numBins) );
-            unsigned int x2 = (unsigned int)((double)(maxx - 3*xMargin) * (double)(i+1) / (double)(numBins) );
-            paintToMap.fillRect(x1 + xMargin, maxy - y1 - yMargin , x2 - x1, y1, Qt::red);
-        }
-        else{
-            /* histogram higher than display resolution */
-            unsigned int y = (unsigned int)((double)(maxy - 2*yMargin) * (double)(histogram[i]) / (double)(binMaxY) );
-            unsigned int x = (unsigned int)((double)(maxx - 3*xMargin) * (double)(i) / (double)(numBins) );
-            paintToMap.drawLine(x + xMargin, maxy - y - yMargin , x + xMargin, maxy - yMargin);
-        }
-    }
 
-    /* draw some graticule */
-    paintToMap.setPen(QPen(Qt::white, 2));
-    /* x-Axis */
-    paintToMap.drawLine(xMargin/2, maxy - yMargin , maxx - xMargin/2, maxy - yMargin);
-    /* y-Axis */
-    paintToMap.drawLine(xMargin, maxy - yMargin + yMargin/4, xMargin, yMargin/2);
-    /* draw some ticks */
-    const unsigned int xBinMax = maxx - 2*xMargin;
-    paintToMap.drawLine(xBinMax, maxy - yMargin + yMargin/4, xBinMax, maxy - yMargin - yMargin/4);
-
-    paintToMap.drawText(xBinMax - 15, maxy - 5, QString::number(numBins));
-    paintToMap.drawText(15, maxy - 5, "0");
-
-    if (percent == 100.0){
-        paintToMap.drawText(maxx/2 + maxx/4, 50, "Progress: Stopped");
+void QDrawBoxWidget::wheelEvent(QWheelEvent *event)
+{
+    if (numBins < 2){
+        return;
+    }
+    const int xMargin = 20;
+    const int plotWidth = maxx - 3*xMargin;
+    const unsigned int last = viewLast > 0 ? viewLast : numBins;
+    const unsigned int span = last - viewFirst;
+    int x = event->pos().x() - xMargin;
+    x = qBound(0, x, plotWidth);
+    /* the bin under the cursor stays in place */
+    const double center = (double)(viewFirst) + (double)(span) * (double)(x) / (double)(plotWidth);
+    double newSpan = event->angleDelta().y() > 0 ? span / 2.0 : span * 2.0;
+    newSpan = qBound(2.0, newSpan, (double)(numBins));
+    double first = center - newSpan * (double)(x) / (double)(plotWidth);
+    first = qBound(0.0, first, (double)(numBins) - newSpan);
+    viewFirst = (unsigned int)(first);
+    viewLast = viewFirst + (unsigned int)(newSpan);
+    if ((viewFirst == 0) && (viewLast >= numBins)){
+        viewLast = 0;
     }
-    else{
-        QString displayStr = QString::number(percent, 'f', 0);
-        paintToMap.drawText(maxx/2 + maxx/4, 50, "Progress: " + displayStr + '%');
+    updateView();
+    event->accept();
+}
+
+
+void QDrawBoxWidget::mousePressEvent(QMouseEvent *event)
+{
+    if (event->button() == Qt::RightButton){
+        logScale = !logScale;
+        updateView();
     }
+}
 
-    /* peak stats */
-    QString displayStr1 = QString::number(binMaxY);
-    QString displayStr2 = QString::number(binMaxX);
-    unsigned int xptr = (unsigned int)((double)(maxx - 3*xMargin) * (double)(binMaxX) / (double)(numBins) ) + xMargin;
-    paintToMap.setFont(QFont("times",10,QFont::Bold));
-    paintToMap.drawText(xptr, yMargin, displayStr2 + '/' + displayStr1);
 
-    repaint();
+void QDrawBoxWidget::mouseDoubleClickEvent(QMouseEvent *event)
+{
+    Q_UNUSED(event);
+    viewFirst = 0;
+    viewLast = 0;
+    updateView();
 }
 
 
 void QDrawBoxWidget::drawReadyToGo(void)
 {
-    QPainter paintToMap(pixmap);
+    QPainter paintToMap(&frame);
     paintToMap.setBrush(Qt::darkBlue);
     paintToMap.drawRect(0, 0, maxx, maxy);
     paintToMap.setPen(QPen(Qt::white));
     paintToMap.setFont(QFont("times",15,QFont::Bold));
     paintToMap.drawText(23, maxy/2, QString("To start or stop the calculation press/unpress the green button!"));
 
-    repaint();
+    update();
 }
@@ -28,6 +28,10 @@
 #include <QColor>
 #include <QDebug>
 #include <QWidget>
+#include <QImage>
+#include <QThread>
+
+#include "histrenderer.h"
 
 class QDrawBoxWidget : public QWidget
 {
@@ -35,21 +39,39 @@ class QDrawBoxWidget : public QWidget
 
     public:
         QDrawBoxWidget(QWidget *parent);
+        ~QDrawBoxWidget();
         void drawLine(int x1,int y1,int x2,int y2);
         void drawReadyToGo(void);
+        /* histograms are taken from this snapshot from now on. returns after
+         * the renderer has let go of the previous one */
+        void setSource(HistogramSnapshot * snapshot);
+        /* render the newest snapshot in the background, if there is one */
+        void refresh(void);
         // \todo: get the sizes from qtcreator over this->size() QSize
         // YOU HAVE TO ADJUST THESE SETTINGS IDENTICAL TO THOSE FROM QTCREATOR
         const static int maxx = 600;
         const static int maxy = 320;
 
-    public slots:
-        void drawHistogram(unsigned int * histogram, const unsigned int numBins, float percent);
+    private slots:
+        void setFrame(const QImage &image);
 
     protected:
         virtual void paintEvent (QPaintEvent *event);
+        /* wheel: zoom around the cursor, right click: log scale on/off,
+         * double click: show all bins */
+        virtual void wheelEvent (QWheelEvent *event);
+        virtual void mousePressEvent (QMouseEvent *event);
+        virtual void mouseDoubleClickEvent (QMouseEvent *event);
 
     private:
-        QPixmap *pixmap;
+        QImage frame;
+        QThread renderThread;
+        HistogramRenderer *renderer;
+        unsigned int numBins;
+        bool logScale;
+        unsigned int viewFirst;
+        unsigned int viewLast;
+        void updateView(void);
 
 };
 
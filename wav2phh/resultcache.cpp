@@ -0,0 +1,285 @@
+/** \file resultcache.cpp
+ * \brief On disk cache of finished histograms, keyed by file content and settings
+ *
+ * \author Copyright (C) 2014 samplemaker
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1
+ * of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free
+ * Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA
+ *
+ * @{
+ */
+
+#include <algorithm>
+#include <QCryptographicHash>
+#include <QDateTime>
+#include <QDebug>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QPair>
+#include <QSaveFile>
+#include <QStandardPaths>
+#include <QStringList>
+#include "contenthash.h"
+#include "resultcache.h"
+
+static QString toHex(quint64 value)
+{
+  return(QString("%1").arg(value, 16, 16, QChar('0')));
+}
+
+
+static double now()
+{
+  return((double)(QDateTime::currentDateTime().toMSecsSinceEpoch()));
+}
+
+
+ResultCache::ResultCache (const QString &dir) {
+  cacheDir = dir;
+  if (cacheDir.isEmpty()){
+    cacheDir = QDir(QStandardPaths::writableLocation(QStandardPaths::GenericCacheLocation)).filePath("wav2phh/results");
+  }
+  setLimits(RESULT_CACHE_MAX_BYTES, RESULT_CACHE_MAX_ENTRIES);
+}
+
+
+void ResultCache::setLimits(qint64 bytes, int entries){
+  maxBytes = bytes;
+  maxEntries = entries;
+}
+
+
+quint64 ResultCache::hash(const uchar *data, quint64 length){
+  ContentHash h;
+  h.add(data, length);
+  return(h.result());
+}
+
+
+/* everything the histogram depends on, one value per line. doubles with all
+ * 17 digits: settings which only look alike do not share an entry */
+QString ResultCache::parameters(const BaseLine &baseline, const PulseEvent &pulseEvent,
+                                double softGain, unsigned int numBins, int channel){
+  QStringList p;
+  p << QString("version=%1").arg(RESULT_CACHE_VERSION);
+  p << "diffThresh=" + QString::number(baseline.diffThresh, 'g', 17);
+  p << "relThresh=" + QString::number(baseline.relThresh, 'g', 17);
+  p << QString("numMAvrg=%1").arg(baseline.numMAvrg);
+  p << QString("estimator=%1").arg(baseline.estimator);
+  p << "trigThresh=" + QString::number(pulseEvent.trigThresh, 'g', 17);
+  p << QString("numPast=%1").arg((qint64)(pulseEvent.numPast));
+  p << QString("minGlitchFilter=%1").arg((qint64)(pulseEvent.minGlitchFilter));
+  p << QString("maxGlitchFilter=%1").arg((qint64)(pulseEvent.maxGlitchFilter));
+  p << QString("iplnFactor=%1").arg((qint64)(pulseEvent.iplnFactor));
+  p << QString("windowSize=%1").arg((qint64)(pulseEvent.windowSize));
+  p << QString("peakMode=%1").arg(pulseEvent.peakMode);
+  p << "softGain=" + QString::number(softGain, 'g', 17);
+  p << QString("numBins=%1").arg(numBins);
+  p << QString("channel=%1").arg(channel);
+  return(p.join("\n"));
+}
+
+
+/* the remembered content hash of the data region of a file, empty if the
+ * file is unknown or has changed since */
+static QString knownContent(const QJsonObject &memo, const QFileInfo &info, qint64 offset, quint64 length)
+{
+  if ((memo.value("size").toDouble() == (double)(info.size())) &&
+      (memo.value("modified").toDouble() == (double)(info.lastModified().toMSecsSinceEpoch())) &&
+      (memo.value("offset").toDouble() == (double)(offset)) && (memo.value("length").toDouble() == (double)(length))){
+    return(memo.value("hash").toString());
+  }
+  return(QString());
+}
+
+
+static QString makeKey(const QString &content, const QString &parameters)
+{
+  const QByteArray params = QCryptographicHash::hash(parameters.toUtf8(), QCryptographicHash::Sha1).toHex();
+  return(content + "-" + QString(params.left(16)));
+}
+
+
+QString ResultCache::knownKey(const QString &fileName, qint64 offset, quint64 length, const QString &parameters){
+  const QFileInfo info(fileName);
+  QJsonObject index = readIndex();
+  QJsonObject files = index.value("files").toObject();
+  QJsonObject memo = files.value(info.absoluteFilePath()).toObject();
+  const QString content = knownContent(memo, info, offset, length);
+  if (content.isEmpty()){
+    return(QString());
+  }
+  memo["used"] = now();
+  files[info.absoluteFilePath()] = memo;
+  index["files"] = files;
+  writeIndex(index);
+  return(makeKey(content, parameters));
+}
+
+
+QString ResultCache::remember(const QString &fileName, qint64 offset, quint64 length, quint64 contentHash,
+                              const QString &parameters){
+  const QFileInfo info(fileName);
+  const QString content = toHex(contentHash);
+  QJsonObject index = readIndex();
+  QJsonObject files = index.value("files").toObject();
+  QJsonObject memo;
+  memo["size"] = (double)(info.size());
+  memo["modified"] = (double)(info.lastModified().toMSecsSinceEpoch());
+  memo["offset"] = (double)(offset);
+  memo["length"] = (double)(length);
+  memo["hash"] = content;
+  memo["used"] = now();
+  files[info.absoluteFilePath()] = memo;
+  evict(files, -1, RESULT_CACHE_MAX_FILES);
+  index["files"] = files;
+  writeIndex(index);
+  return(makeKey(content, parameters));
+}
+
+
+bool ResultCache::lookup(const QString &key, unsigned int *histogram, unsigned int numBins, PipelineStats *stats,
+                         TimeSlices *slices){
+  if (key.isEmpty()){
+    return(false);
+  }
+  QFile file(QDir(cacheDir).filePath(key + ".json"));
+  if (!file.open(QIODevice::ReadOnly)){
+    return(false);
+  }
+  const QJsonObject entry = QJsonDocument::fromJson(file.readAll()).object();
+  file.close();
+  const QJsonArray bins = entry.value("bins").toArray();
+  if ((entry.value("version").toInt() != RESULT_CACHE_VERSION) || (bins.size() != (int)(numBins))){
+    return(false);
+  }
+  if ((slices != NULL) && !slices->fromJson(entry.value("slices").toObject())){
+    return(false);
+  }
+  for (unsigned int i = 0; i < numBins; i ++){
+    histogram[i] = (unsigned int)(bins.at(i).toDouble());
+  }
+  if (stats != NULL){
+    *stats = PipelineStats::fromJson(entry.value("stats").toObject());
+  }
+  QJsonObject index = readIndex();
+  QJsonObject entries = index.value("entries").toObject();
+  QJsonObject e = entries.value(key).toObject();
+  e["bytes"] = (double)(file.size());
+  e["used"] = now();
+  entries[key] = e;
+  index["entries"] = entries;
+  writeIndex(index);
+  return(true);
+}
+
+
+bool ResultCache::store(const QString &key, const unsigned int *histogram, unsigned int numBins, const PipelineStats &stats,
+                        const TimeSlices *slices){
+  if (key.isEmpty() || !QDir().mkpath(cacheDir)){
+    return(false);
+  }
+  QJsonArray bins;
+  for (unsigned int i = 0; i < numBins; i ++){
+    bins.append((double)(histogram[i]));
+  }
+  QJsonObject entry;
+  entry["version"] = RESULT_CACHE_VERSION;
+  entry["bins"] = bins;
+  entry["stats"] = stats.toJson();
+  if (slices != NULL){
+    entry["slices"] = slices->toJson();
+  }
+  const QByteArray bytes = QJsonDocument(entry).toJson(QJsonDocument::Compact);
+  QSaveFile file(QDir(cacheDir).filePath(key + ".json"));
+  if (!file.open(QIODevice::WriteOnly) || (file.write(bytes) != bytes.size()) || !file.commit()){
+    qWarning() << "result cache: cannot write to" << cacheDir;
+    return(false);
+  }
+  QJsonObject index = readIndex();
+  QJsonObject entries = index.value("entries").toObject();
+  QJsonObject e;
+  e["bytes"] = (double)(bytes.size());
+  e["used"] = now();
+  entries[key] = e;
+  /* entries whose index update got lost count with their file time */
+  const QFileInfoList found = QDir(cacheDir).entryInfoList(QStringList() << "*-*.json", QDir::Files);
+  for (int i = 0; i < found.size(); i ++){
+    const QString name = found.at(i).completeBaseName();
+    if (!entries.contains(name)){
+      QJsonObject orphan;
+      orphan["bytes"] = (double)(found.at(i).size());
+      orphan["used"] = (double)(found.at(i).lastModified().toMSecsSinceEpoch());
+      entries[name] = orphan;
+    }
+  }
+  evict(entries, maxBytes, maxEntries);
+  index["entries"] = entries;
+  return(writeIndex(index));
+}
+
+
+/* least recently used first, until both limits hold (limitBytes < 0: no
+ * limit). result files of removed entries are deleted */
+void ResultCache::evict(QJsonObject &entries, qint64 limitBytes, int limitEntries){
+  QVector<QPair<double, QString> > byUse;
+  double numBytes = 0.0;
+  const QStringList names = entries.keys();
+  for (int i = 0; i < names.size(); i ++){
+    const QJsonObject e = entries.value(names.at(i)).toObject();
+    byUse.append(qMakePair(e.value("used").toDouble(), names.at(i)));
+    numBytes += e.value("bytes").toDouble();
+  }
+  std::sort(byUse.begin(), byUse.end());
+  int numEntries = byUse.size();
+  for (int i = 0; i < byUse.size(); i ++){
+    if ((numEntries <= limitEntries) && ((limitBytes < 0) || (numBytes <= (double)(limitBytes)))){
+      break;
+    }
+    const QString &name = byUse.at(i).second;
+    numBytes -= entries.value(name).toObject().value("bytes").toDouble();
+    numEntries --;
+    entries.remove(name);
+    if (limitBytes >= 0){
+      QFile::remove(QDir(cacheDir).filePath(name + ".json"));
+    }
+  }
+}
+
+
+QJsonObject ResultCache::readIndex(){
+  QFile file(QDir(cacheDir).filePath("index.json"));
+  if (!file.open(QIODevice::ReadOnly)){
+    return(QJsonObject());
+  }
+  return(QJsonDocument::fromJson(file.readAll()).object());
+}
+
+
+bool ResultCache::writeIndex(const QJsonObject &index){
+  if (!QDir().mkpath(cacheDir)){
+    return(false);
+  }
+  QSaveFile file(QDir(cacheDir).filePath("index.json"));
+  const QByteArray bytes = QJsonDocument(index).toJson(QJsonDocument::Compact);
+  if (!file.open(QIODevice::WriteOnly) || (file.write(bytes) != bytes.size()) || !file.commit()){
+    qWarning() << "result cache: cannot write the index in" << cacheDir;
+    return(false);
+  }
+  return(true);
+}
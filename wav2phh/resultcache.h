@@ -0,0 +1,101 @@
+/** \file resultcache.h
+ * \brief On disk cache of finished histograms, keyed by file content and settings
+ *
+ * \author Copyright (C) 2014 samplemaker
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1
+ * of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free
+ * Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA
+ *
+ * @{
+ */
+
+#ifndef RESULTCACHE_H
+#define RESULTCACHE_H
+
+#include <QtGlobal>
+#include <QJsonObject>
+#include <QString>
+
+#include "analyzer.h"
+#include "pipelinestats.h"
+#include "timeslices.h"
+
+/* bump whenever a change of the analysis changes its results: older entries
+ * are no longer found */
+#define RESULT_CACHE_VERSION 1
+/* default limits of the cache directory */
+#define RESULT_CACHE_MAX_BYTES (64 * 1024 * 1024)
+#define RESULT_CACHE_MAX_ENTRIES 1000
+/* remembered content hashes of files (path, size, modification time) */
+#define RESULT_CACHE_MAX_FILES 1000
+
+
+/**
+ *  A result is stored under contentHash-parameterHash. The content hash is
+ *  the xxhash64 of the data region of the wav file only, so a copy or a
+ *  renamed file hits as well. It runs at memory speed, but a large file
+ *  still has to be read once: the hash is remembered per path together with
+ *  size and modification time, an unchanged file is not read again. Nobody
+ *  reads the file for the key alone: the gui and the cli look up knownKey()
+ *  only, the first run of a file hashes it while decoding and remember()s it. The
+ *  parameter hash is a sha1 of a canonical text of all settings which change
+ *  the histogram, including RESULT_CACHE_VERSION.
+ *
+ *  Every entry is a small json file in the cache directory (the histogram
+ *  and the statistics of the run, from the gui also the sparse time slices
+ *  of TimeSlices), index.json keeps the size and the last
+ *  use of each entry. Once a limit is exceeded the least recently used
+ *  entries are removed. Several processes may share the directory: files
+ *  are replaced atomically, at worst an update of the index gets lost and
+ *  an entry is evicted too early.
+ **/
+class ResultCache
+{
+
+  public:
+    /* constructor. dir empty: wav2phh/results in the generic cache location,
+     * shared by the gui and the cli */
+    ResultCache (const QString &dir = QString());
+    void setLimits(qint64 maxBytes, int maxEntries);
+    inline const QString & directory() { return cacheDir; }
+    /* canonical text of all settings a histogram depends on */
+    static QString parameters(const BaseLine &baseline, const PulseEvent &pulseEvent,
+                              double softGain, unsigned int numBins, int channel);
+    /* key of the data region [offset, offset + length) of a file, without
+     * reading the file: empty unless the content hash of the file is
+     * remembered */
+    QString knownKey(const QString &fileName, qint64 offset, quint64 length, const QString &parameters);
+    /* remembers contentHash (hash() of the data region, computed elsewhere,
+     * e.g. by AudioInfo while decoding) for the file and returns the key */
+    QString remember(const QString &fileName, qint64 offset, quint64 length, quint64 contentHash,
+                     const QString &parameters);
+    /* histogram has numBins entries. slices non NULL: the time slices of the
+     * run are wanted as well, an entry without them is not found */
+    bool lookup(const QString &key, unsigned int *histogram, unsigned int numBins, PipelineStats *stats,
+                TimeSlices *slices = NULL);
+    bool store(const QString &key, const unsigned int *histogram, unsigned int numBins, const PipelineStats &stats,
+               const TimeSlices *slices = NULL);
+    static quint64 hash(const uchar *data, quint64 length);
+  private:
+    QString cacheDir;
+    qint64 maxBytes;
+    int maxEntries;
+    QJsonObject readIndex();
+    bool writeIndex(const QJsonObject &index);
+    void evict(QJsonObject &entries, qint64 limitBytes, int limitEntries);
+};
+
+
+#endif
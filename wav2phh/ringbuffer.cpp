@@ -0,0 +1,97 @@
+/** \file ringbuffer.cpp
+ * \brief Ringbuffer which can be read linearly across the wrap around
+ *
+ * \author Copyright (C) 2014 samplemaker
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1
+ * of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free
+ * Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA
+ *
+ * @{
+ */
+
+#include <cstring>
+#include <QtGlobal>
+#include "ringbuffer.h"
+
+#ifdef Q_OS_LINUX
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#endif
+
+
+MirrorBuffer::MirrorBuffer (size_t numElements) {
+  numData = numElements;
+  numBytes = numElements * sizeof(double);
+  mirrored = mapMirror();
+  if (!mirrored){
+    ringData = new double[2 * numData]();
+  }
+}
+
+
+/* destructor */
+MirrorBuffer::~MirrorBuffer () {
+#ifdef Q_OS_LINUX
+  if (mirrored){
+    munmap(ringData, 2 * numBytes);
+    return;
+  }
+#endif
+  delete[] ringData;
+}
+
+
+void MirrorBuffer::clear(){
+  memset(ringData, 0, mirrored ? numBytes : 2 * numBytes);
+}
+
+
+/* map one anonymous file twice, directly behind each other. the size has to
+ * be a multiple of the page size (4096 doubles are 8 pages of 4k) */
+bool MirrorBuffer::mapMirror(){
+#if defined(Q_OS_LINUX) && defined(SYS_memfd_create)
+  const size_t pageSize = sysconf(_SC_PAGESIZE);
+  if ((numBytes == 0) || (numBytes % pageSize != 0)){
+    return(false);
+  }
+  const int fd = syscall(SYS_memfd_create, "wav2phh-ring", 0);
+  if (fd < 0){
+    return(false);
+  }
+  if (ftruncate(fd, numBytes) != 0){
+    close(fd);
+    return(false);
+  }
+  /* reserve the address range for both halves first, then replace it */
+  char * base = (char *)(mmap(NULL, 2 * numBytes, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0));
+  if (base == MAP_FAILED){
+    close(fd);
+    return(false);
+  }
+  void * lower = mmap(base, numBytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd, 0);
+  void * upper = mmap(base + numBytes, numBytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd, 0);
+  close(fd);
+  if ((lower == MAP_FAILED) || (upper == MAP_FAILED)){
+    munmap(base, 2 * numBytes);
+    return(false);
+  }
+  ringData = (double *)(base);
+  /* a fresh memfd reads as zeros */
+  return(true);
+#else
+  return(false);
+#endif
+}
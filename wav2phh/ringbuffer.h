@@ -0,0 +1,66 @@
+/** \file ringbuffer.h
+ * \brief Ringbuffer which can be read linearly across the wrap around
+ *
+ * \author Copyright (C) 2014 samplemaker
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1
+ * of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free
+ * Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA
+ *
+ * @{
+ */
+
+#ifndef RINGBUFFER_H
+#define RINGBUFFER_H
+
+#include <cstdlib>
+
+
+/**
+ *  data()[n] and data()[n + size()] address the same element for all
+ *  n < size(). Therefore every window of up to size() elements starting at
+ *  any position in the ring is a plain linear array - no copy and no modulo.
+ *
+ *  If possible the same memory is mapped twice back to back into the address
+ *  space (linux: memfd + double mmap). Otherwise a buffer of twice the size is
+ *  allocated and each write goes to both halves.
+ **/
+class MirrorBuffer
+{
+
+  public:
+    /* constructor */
+    MirrorBuffer (size_t numElements);
+    /* destructor */
+    ~MirrorBuffer ();
+    void clear();
+    inline void write(size_t pos, double value){
+      ringData[pos] = value;
+      if (!mirrored){
+        ringData[pos + numData] = value;
+      }
+    }
+    inline const double * data() { return ringData; }
+    inline size_t size() { return numData; }
+    inline bool isMirrored() { return mirrored; }
+  private:
+    double * ringData;
+    size_t numData;
+    size_t numBytes;
+    bool mirrored;
+    bool mapMirror();
+};
+
+
+#endif
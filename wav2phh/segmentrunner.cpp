@@ -0,0 +1,115 @@
+/** \file segmentrunner.cpp
+ * \brief Parallel analysis of one wav file split into segments
+ *
+ * \author Copyright (C) 2014 samplemaker
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1
+ * of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free
+ * Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA
+ *
+ * @{
+ */
+
+#include <cstring>
+#include <QObject>
+#include <QElapsedTimer>
+
+#include "audioinput.h"
+#include "segmentrunner.h"
+
+
+SegmentRunner::SegmentRunner (const Segment &segment, const BaseLine &baseline,
+                              const PulseEvent &pulseEvent, double softGain,
+                              unsigned int numBinsHist) {
+  mSegment = segment;
+  /* private copies: the analyzer writes the actual baseline value back */
+  mBaseline = baseline;
+  mPulseEvent = pulseEvent;
+  mSoftGain = softGain;
+  numBins = numBinsHist;
+  histogram = new unsigned int[numBins + 1]();
+  numSamples = 0;
+  nsecs = 0;
+  ok = false;
+  /* the caller collects the results */
+  setAutoDelete(false);
+}
+
+
+/* destructor */
+SegmentRunner::~SegmentRunner () {
+  delete[] histogram;
+}
+
+
+void SegmentRunner::run() {
+  QElapsedTimer timer;
+  timer.start();
+  AudioInfo audioInfo(NUM_ELEMENTS_RINGBUF, NUM_FUTUREPAST_RINGBUF);
+  if (!(audioInfo.open(mSegment.fileName) && audioInfo.selectChannel(mSegment.channel))){
+    return;
+  }
+  const quint64 leadIn = mSegment.leadIn < mSegment.first ? mSegment.leadIn : mSegment.first;
+  const quint64 decodeFirst = mSegment.first - leadIn;
+  /* one more block behind the end, so that every sample of the segment is
+   * scanned and the pulses triggered at the very end are complete */
+  audioInfo.setRange(decodeFirst, leadIn + mSegment.count + NUM_ELEMENTS_RINGBUF);
+  audioInfo.resetSoftGain(mSoftGain);
+
+  mBaseline.value = 0;
+  Analyzer analyzer(numBins, NUM_FUTUREPAST_RINGBUF, NUM_ELEMENTS_RINGBUF, &mBaseline, &mPulseEvent);
+  analyzer.setCountWindow(decodeFirst, mSegment.first, mSegment.first + mSegment.count);
+  QObject::connect(&audioInfo,
+                   SIGNAL( audioDataReady(const double *, size_t, float) ),
+                   &analyzer,
+                   SLOT( doHistogram(const double *, size_t, float)),
+                   Qt::DirectConnection);
+  audioInfo.decode();
+
+  memcpy(histogram, analyzer.histogram, sizeof(histogram[0]) * (numBins + 1));
+  analyzer.publishStatistics();
+  stats = audioInfo.statistics();
+  stats.add(analyzer.statistics());
+  numSamples = mSegment.count;
+  nsecs = timer.nsecsElapsed();
+  ok = true;
+}
+
+
+QList<Segment> SegmentRunner::split(const QString &fileName, quint64 totalSamples,
+                                    int numSegments, quint64 leadIn) {
+  QList<Segment> segments;
+  if (numSegments < 1){
+    numSegments = 1;
+  }
+  /* segments much shorter than the lead-in are pointless */
+  const quint64 maxSegments = totalSamples / (leadIn + NUM_ELEMENTS_RINGBUF) + 1;
+  if ((quint64)(numSegments) > maxSegments){
+    numSegments = maxSegments;
+  }
+  quint64 first = 0;
+  for (int i = 0; i < numSegments; i++){
+    const quint64 next = totalSamples * (i + 1) / numSegments;
+    Segment s;
+    s.fileName = fileName;
+    s.fileIndex = 0;
+    s.channel = 0;
+    s.first = first;
+    s.count = next - first;
+    s.leadIn = leadIn;
+    segments.append(s);
+    first = next;
+  }
+  return(segments);
+}
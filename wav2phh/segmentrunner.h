@@ -0,0 +1,95 @@
+/** \file segmentrunner.h
+ * \brief Parallel analysis of one wav file split into segments
+ *
+ * \author Copyright (C) 2014 samplemaker
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1
+ * of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free
+ * Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA
+ *
+ * @{
+ */
+
+#ifndef SEGMENTRUNNER_H
+#define SEGMENTRUNNER_H
+
+#include <QRunnable>
+#include <QString>
+#include <QList>
+
+#include "analyzer.h"
+
+/* samples decoded in front of each segment to warm up the baseline */
+#define SEGMENT_LEAD_IN_DEFAULT 65536
+
+
+/* one piece of the file: pulses triggered in [first, first + count) of the
+ * given channel are counted, decoding starts leadIn samples earlier */
+struct Segment
+{
+    QString fileName;
+    int fileIndex;
+    int channel;
+    quint64 first;
+    quint64 count;
+    quint64 leadIn;
+};
+
+
+/**
+ *  Runs AudioInfo::decode() and an Analyzer of its own for one segment on a
+ *  pool thread. Both are created inside run(), nothing is shared between the
+ *  runners except the read only file.
+ *
+ *  Segments are cut without looking at the data. A pulse is owned by the
+ *  segment in which it triggers, its samples may reach into the next one
+ *  (decoding runs one ringbuffer length beyond the end). The lead-in lets the
+ *  moving average settle, but the legacy average never forgets the start of
+ *  the stream, so the baseline of a segment is close to the sequential one,
+ *  not equal. Pulses close to the trigger or baseline thresholds may therefore
+ *  be judged differently, and a pulse straddling a cut may in rare cases be
+ *  counted twice or not at all. The merged histogram matches the sequential
+ *  one up to these pulses: compare with --threads 1 on the data at hand.
+ **/
+class SegmentRunner : public QRunnable
+{
+
+  public:
+    SegmentRunner (const Segment &segment, const BaseLine &baseline,
+                   const PulseEvent &pulseEvent, double softGain,
+                   unsigned int numBinsHist);
+    ~SegmentRunner ();
+    void run();
+    /* split the whole file into numSegments pieces of about the same size */
+    static QList<Segment> split(const QString &fileName, quint64 totalSamples,
+                                int numSegments, quint64 leadIn);
+    const Segment &segment() { return mSegment; }
+    /* result, valid after run() */
+    bool ok;
+    unsigned int * histogram;
+    unsigned int numBins;
+    quint64 numSamples;
+    /* wall clock time of run() */
+    qint64 nsecs;
+    /* decoder and analyzer counters of the segment incl. its lead-in */
+    PipelineStats stats;
+  private:
+    Segment mSegment;
+    BaseLine mBaseline;
+    PulseEvent mPulseEvent;
+    double mSoftGain;
+};
+
+
+#endif
@@ -0,0 +1,172 @@
+/** \file sidecar.cpp
+ * \brief Normalized float32 copy of the samples of one channel
+ *
+ * \author Copyright (C) 2014 samplemaker
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1
+ * of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free
+ * Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA
+ *
+ * @{
+ */
+
+#include <cstddef>
+#include <cstring>
+#include <QDebug>
+#include "sidecar.h"
+
+
+SampleSidecar::SampleSidecar () {
+  memset(&info, 0, sizeof(info));
+  out = NULL;
+  map = NULL;
+  memory = NULL;
+  samples = NULL;
+  fill = 0;
+  recording = false;
+  ok = false;
+}
+
+
+/* destructor */
+SampleSidecar::~SampleSidecar () {
+  clear();
+}
+
+
+QString SampleSidecar::fileNameFor(const QString &wavName, int channel){
+  return(wavName + QString(".%1").arg(channel) + SIDECAR_SUFFIX);
+}
+
+
+void SampleSidecar::clear(){
+  cancel();
+  if (map != NULL){
+    file.unmap(map);
+    map = NULL;
+  }
+  file.close();
+  delete[] memory;
+  memory = NULL;
+  samples = NULL;
+  memset(&info, 0, sizeof(info));
+}
+
+
+bool SampleSidecar::open(const QString &fileName, const SidecarHeader &expect){
+  clear();
+  file.setFileName(fileName);
+  if (!file.open(QIODevice::ReadOnly) ||
+      (file.read((char *)(&info), sizeof(info)) != sizeof(info))){
+    file.close();
+    return(false);
+  }
+  /* written for another version of the wav file (or of this format) */
+  const size_t compared = sizeof(info) - sizeof(info.reserved) - offsetof(SidecarHeader, channel);
+  if ((memcmp(info.magic, SIDECAR_MAGIC, sizeof(info.magic)) != 0) ||
+      (info.version != SIDECAR_VERSION) ||
+      (memcmp(&info.channel, &expect.channel, compared) != 0) ||
+      (file.size() != (qint64)(sizeof(info) + info.numSamples * sizeof(float)))){
+    qWarning() << fileName << "is outdated, decoding again";
+    clear();
+    return(false);
+  }
+  map = file.map(0, file.size());
+  if (map == NULL){
+    qWarning() << "cannot map" << fileName;
+    clear();
+    return(false);
+  }
+  samples = (const float *)(map + sizeof(info));
+  return(true);
+}
+
+
+bool SampleSidecar::begin(const QString &fileName, const SidecarHeader &header){
+  clear();
+  info = header;
+  memcpy(info.magic, SIDECAR_MAGIC, sizeof(info.magic));
+  info.version = SIDECAR_VERSION;
+  memset(info.reserved, 0, sizeof(info.reserved));
+  fill = 0;
+  if (fileName.isEmpty()){
+    if (info.numSamples * sizeof(float) > (quint64)(SIDECAR_MEMORY_MAX_BYTES)){
+      return(false);
+    }
+    memory = new float[info.numSamples];
+    ok = true;
+  }
+  else{
+    out = new QSaveFile(fileName);
+    ok = out->open(QIODevice::WriteOnly) &&
+         (out->write((const char *)(&info), sizeof(info)) == sizeof(info));
+    if (!ok){
+      qWarning() << "cannot write sidecar" << fileName;
+      delete out;
+      out = NULL;
+      return(false);
+    }
+  }
+  recording = true;
+  return(true);
+}
+
+
+bool SampleSidecar::commit(){
+  if (!recording){
+    return(false);
+  }
+  recording = false;
+  ok = ok && (fill == info.numSamples);
+  if (memory != NULL){
+    if (!ok){
+      clear();
+      return(false);
+    }
+    samples = memory;
+    return(true);
+  }
+  const QString fileName = out->fileName();
+  if (ok){
+    ok = out->commit();
+  }
+  else{
+    out->cancelWriting();
+  }
+  delete out;
+  out = NULL;
+  if (!ok){
+    qWarning() << "sidecar not written:" << fileName;
+    clear();
+    return(false);
+  }
+  /* from now on read through the mapping, the samples are in the page cache */
+  const SidecarHeader expect = info;
+  return(open(fileName, expect));
+}
+
+
+void SampleSidecar::cancel(){
+  if (out != NULL){
+    out->cancelWriting();
+    delete out;
+    out = NULL;
+  }
+  if (recording && (memory != NULL)){
+    delete[] memory;
+    memory = NULL;
+  }
+  recording = false;
+  fill = 0;
+}
@@ -0,0 +1,122 @@
+/** \file sidecar.h
+ * \brief Normalized float32 copy of the samples of one channel
+ *
+ * \author Copyright (C) 2014 samplemaker
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1
+ * of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free
+ * Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA
+ *
+ * @{
+ */
+
+#ifndef SIDECAR_H
+#define SIDECAR_H
+
+#include <cstdlib>
+#include <cstring>
+#include <QtGlobal>
+#include <QFile>
+#include <QSaveFile>
+#include <QString>
+
+#define SIDECAR_MAGIC "W2PHSMP1"
+#define SIDECAR_VERSION 1
+/* appended to the name of the wav file, together with the channel */
+#define SIDECAR_SUFFIX ".f32"
+/* a sidecar in memory is only kept up to this size */
+#define SIDECAR_MEMORY_MAX_BYTES (Q_INT64_C(1) << 30)
+
+enum SIDECAR_MODES {
+    SIDECAR_OFF,        /* always decode the wav file */
+    SIDECAR_MEMORY,     /* keep the samples in memory while the file is open */
+    SIDECAR_FILE        /* file next to the wav file, memory if it cannot be written */
+};
+
+
+/* the first 64 bytes of the file, host byte order. a sidecar belongs to
+ * the wav file with this size, modification time and data chunk */
+struct SidecarHeader
+{
+    char magic[8];
+    quint32 version;
+    qint32 channel;
+    quint64 numSamples;
+    quint64 sourceSize;
+    qint64 sourceModified;      /* ms since the epoch */
+    quint64 dataOffset;
+    quint64 dataLength;
+    quint32 sampleBits;
+    quint8 reserved[4];
+};
+
+
+/**
+ *  The samples of one channel as float32, independent of the soft gain:
+ *  integers x of up to 24 bit are stored as x * 2^-(bits - 1), float
+ *  samples as they are. Both are exact in float32, and the gain is applied
+ *  by one multiply per sample when the samples are read back (see
+ *  PcmConverter::convertNormalized), so a run from the sidecar gives the
+ *  same doubles as a run from the wav file. 32 bit integers do not fit.
+ *
+ *  The header is followed by numSamples floats, the file is mapped as is.
+ *  It is written through a QSaveFile and only appears once all samples are
+ *  in, an aborted run leaves nothing behind.
+ **/
+class SampleSidecar
+{
+
+  public:
+    /* constructor */
+    SampleSidecar ();
+    /* destructor */
+    ~SampleSidecar ();
+    static QString fileNameFor(const QString &wavName, int channel);
+    /* drops the samples (another wav file was opened) */
+    void clear();
+    /* maps fileName if it matches expect in everything but the magic and version */
+    bool open(const QString &fileName, const SidecarHeader &expect);
+    /* recording: into fileName, or into memory if fileName is empty */
+    bool begin(const QString &fileName, const SidecarHeader &header);
+    inline void append(const float *x, size_t num){
+      if (memory != NULL){
+        memcpy(memory + fill, x, num * sizeof(float));
+      }
+      else if (ok){
+        ok = (out->write((const char *)(x), num * sizeof(float)) == (qint64)(num * sizeof(float)));
+      }
+      fill += num;
+    }
+    /* true if all samples came in, the sidecar is readable afterwards */
+    bool commit();
+    void cancel();
+    inline bool isRecording() { return recording; }
+    inline bool isValid() { return samples != NULL; }
+    inline const float * data() { return samples; }
+    inline quint64 size() { return info.numSamples; }
+    inline const SidecarHeader & header() { return info; }
+  private:
+    SidecarHeader info;
+    QFile file;
+    QSaveFile * out;
+    uchar * map;
+    float * memory;
+    const float * samples;
+    quint64 fill;
+    bool recording;
+    bool ok;
+};
+
+
+#endif
@@ -0,0 +1,346 @@
+/** \file sweeper.cpp
+ * \brief Many analyzer configurations on the blocks of one decode
+ *
+ * \author Copyright (C) 2014 samplemaker
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1
+ * of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free
+ * Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA
+ *
+ * @{
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <QMap>
+
+#include "sweeper.h"
+
+
+Sweeper::Sweeper(unsigned int numBinsHist, size_t extraSamples, size_t bufLen,
+                 const BaseLine &baseline, QObject *parent) : QObject(parent)
+{
+    mNumBins = numBinsHist;
+    mExtra = extraSamples;
+    mBufLen = bufLen;
+    mBaseline = baseline;
+    mNumGroups = 0;
+}
+
+
+Sweeper::~Sweeper()
+{
+    clear();
+}
+
+
+void Sweeper::clear()
+{
+    for (int l = 0; l < consumers.size(); l++){
+        delete consumers.at(l);
+        delete queues.at(l);
+    }
+    consumers.clear();
+    queues.clear();
+    for (int n = 0; n < analyzers.size(); n++){
+        delete analyzers.at(n);
+    }
+    analyzers.clear();
+    leaders.clear();
+    points.clear();
+    baselines.clear();
+    labels.clear();
+    mNumGroups = 0;
+}
+
+
+bool Sweeper::setParameter(PulseEvent &p, const QString &name, const QString &value)
+{
+    bool ok = true;
+    if (name == "trig-thresh")
+        p.trigThresh = value.toDouble(&ok);
+    /* the samples in front of a trigger come from the past part of the block */
+    else if (name == "num-past"){
+        p.numPast = value.toUInt(&ok);
+        ok = ok && (p.numPast < NUM_FUTUREPAST_RINGBUF / 2);
+    }
+    else if (name == "min-glitch")
+        p.minGlitchFilter = value.toUInt(&ok);
+    else if (name == "max-glitch")
+        p.maxGlitchFilter = value.toUInt(&ok);
+    /* the interpolator needs at least one point and one window sample */
+    else if (name == "ipln-factor"){
+        p.iplnFactor = value.toUInt(&ok);
+        ok = ok && (p.iplnFactor >= 1);
+    }
+    else if (name == "window-size"){
+        p.windowSize = value.toUInt(&ok);
+        ok = ok && (p.windowSize >= 1);
+    }
+    else if (name == "peak-mode"){
+        if (value == "upsample")
+            p.peakMode = PEAK_UPSAMPLE;
+        else if (value == "lazy")
+            p.peakMode = PEAK_LAZY;
+        else
+            ok = false;
+    }
+    else
+        ok = false;
+    return ok;
+}
+
+
+/* "v,v,..." or "lo:hi:step" into single values */
+bool Sweeper::expandValues(const QString &name, const QString &values, QStringList &list)
+{
+    const QStringList range = values.split(':');
+    if (range.size() == 3){
+        bool okLow, okHigh, okStep;
+        const double low = range.at(0).toDouble(&okLow);
+        const double high = range.at(1).toDouble(&okHigh);
+        const double step = range.at(2).toDouble(&okStep);
+        if (!okLow || !okHigh || !okStep || !(step > 0.0) || (high < low))
+            return false;
+        /* the end is included, up to rounding of the steps */
+        const long num = (long)(floor((high - low) / step + 1e-9)) + 1;
+        if (num > SWEEP_MAX_POINTS)
+            return false;
+        for (long k = 0; k < num; k++){
+            list.append(QString::number(low + (double)(k) * step, 'g', 12));
+        }
+    }
+    else if (range.size() == 1){
+        list = values.split(',');
+    }
+    else
+        return false;
+    PulseEvent test;
+    for (int k = 0; k < list.size(); k++){
+        if (!setParameter(test, name, list.at(k)))
+            return false;
+    }
+    return !list.isEmpty();
+}
+
+
+bool Sweeper::setup(const QString &spec, const PulseEvent &base, int numThreads, QString *error)
+{
+    clear();
+    QStringList names;
+    QVector<QStringList> values;
+    const QStringList dims = spec.split(';', QString::SkipEmptyParts);
+    long numPoints = 1;
+    for (int d = 0; d < dims.size(); d++){
+        const int eq = dims.at(d).indexOf('=');
+        const QString name = dims.at(d).left(eq).trimmed();
+        QStringList list;
+        if ((eq < 0) || !expandValues(name, dims.at(d).mid(eq + 1).trimmed(), list)){
+            *error = QString("cannot sweep '%1'").arg(dims.at(d));
+            return false;
+        }
+        names.append(name);
+        values.append(list);
+        numPoints *= list.size();
+        if (numPoints > SWEEP_MAX_POINTS){
+            *error = QString("more than %1 configurations").arg(SWEEP_MAX_POINTS);
+            return false;
+        }
+    }
+    if (names.isEmpty()){
+        *error = "nothing to sweep";
+        return false;
+    }
+
+    /* cartesian product, the last parameter varies fastest */
+    points.fill(base, (int)(numPoints));
+    baselines.fill(mBaseline, (int)(numPoints));
+    for (int n = 0; n < numPoints; n++){
+        QString text;
+        long index = n;
+        for (int d = names.size() - 1; d >= 0; d--){
+            const QString &value = values.at(d).at(index % values.at(d).size());
+            index /= values.at(d).size();
+            setParameter(points[n], names.at(d), value);
+            text.prepend(QString("%1%2=%3").arg(d > 0 ? " " : "").arg(names.at(d)).arg(value));
+        }
+        labels.append(text);
+    }
+
+    /* groups of configurations which trigger alike, first one leads */
+    QMap<QString, int> groupOf;
+    QVector<int> groupSize;
+    for (int n = 0; n < numPoints; n++){
+        const PulseEvent &p = points.at(n);
+        analyzers.append(new Analyzer(mNumBins, mExtra, mBufLen, &baselines[n], &points[n]));
+        const QString key = QString("%1 %2 %3").arg(p.trigThresh, 0, 'g', 17)
+                                               .arg(p.minGlitchFilter).arg(p.maxGlitchFilter);
+        if (!groupOf.contains(key)){
+            groupOf.insert(key, leaders.size());
+            leaders.append(analyzers.last());
+            groupSize.append(1);
+        }
+        else{
+            leaders.at(groupOf.value(key))->addFollower(analyzers.last());
+            groupSize[groupOf.value(key)] ++;
+        }
+    }
+    mNumGroups = leaders.size();
+
+    /* the largest groups first, each onto the lane with the least work */
+    const int numLanes = qMax(1, qMin(numThreads, mNumGroups));
+    if (numLanes > 1){
+        QVector<int> order;
+        for (int g = 0; g < mNumGroups; g++){
+            order.append(g);
+        }
+        std::stable_sort(order.begin(), order.end(),
+                         [&](int a, int b){ return groupSize.at(a) > groupSize.at(b); });
+        QVector<int> load(numLanes, 0);
+        for (int l = 0; l < numLanes; l++){
+            queues.append(new BlockQueue(mBufLen));
+            consumers.append(new BlockConsumer(queues.last()));
+        }
+        for (int k = 0; k < order.size(); k++){
+            const int lane = (int)(std::min_element(load.begin(), load.end()) - load.begin());
+            load[lane] += groupSize.at(order.at(k));
+            QObject::connect(consumers.at(lane),
+                             SIGNAL( blockReady(const double *, size_t, float) ),
+                             leaders.at(order.at(k)),
+                             SLOT( doHistogram(const double *, size_t, float)),
+                             Qt::DirectConnection);
+        }
+    }
+    return true;
+}
+
+
+int Sweeper::size()
+{
+    return analyzers.size();
+}
+
+
+int Sweeper::numGroups()
+{
+    return mNumGroups;
+}
+
+
+int Sweeper::numLanes()
+{
+    return qMax(1, consumers.size());
+}
+
+
+Analyzer * Sweeper::analyzer(int n)
+{
+    return analyzers.at(n);
+}
+
+
+QString Sweeper::label(int n)
+{
+    return labels.at(n);
+}
+
+
+void Sweeper::start()
+{
+    for (int l = 0; l < consumers.size(); l++){
+        queues.at(l)->clear();
+        consumers.at(l)->start();
+    }
+}
+
+
+void Sweeper::finish()
+{
+    for (int l = 0; l < consumers.size(); l++){
+        queues.at(l)->close();
+    }
+    for (int l = 0; l < consumers.size(); l++){
+        consumers.at(l)->wait();
+    }
+}
+
+
+void Sweeper::doBlock(const double *data, size_t len, float percent)
+{
+    if (queues.isEmpty()){
+        for (int g = 0; g < leaders.size(); g++){
+            leaders.at(g)->doHistogram(data, len, percent);
+        }
+        return;
+    }
+    for (int l = 0; l < queues.size(); l++){
+        double * block = queues.at(l)->beginWrite();
+        memcpy(block, data, len * sizeof(double));
+        queues.at(l)->endWrite(len, percent);
+    }
+}
+
+
+/**
+ *  The maximum is the highest bin, the half maximum is searched to both
+ *  sides from there and interpolated linearly between the two bins around
+ *  it. The histogram is taken as is: with few counts per bin the peak is as
+ *  noisy as the bins.
+ **/
+SweepFom Sweeper::figureOfMerit(const unsigned int *histogram, unsigned int first, unsigned int last)
+{
+    SweepFom fom;
+    memset(&fom, 0, sizeof(fom));
+    if (last <= first)
+        return fom;
+    fom.peakBin = first;
+    for (unsigned int k = first; k < last; k++){
+        fom.counts += histogram[k];
+        if (histogram[k] > histogram[fom.peakBin])
+            fom.peakBin = k;
+    }
+    fom.peakCounts = histogram[fom.peakBin];
+    if (fom.peakCounts == 0)
+        return fom;
+    const double half = 0.5 * (double)(fom.peakCounts);
+    unsigned int left = fom.peakBin;
+    while ((left > first) && ((double)(histogram[left - 1]) > half)){
+        left--;
+    }
+    unsigned int right = fom.peakBin;
+    while ((right + 1 < last) && ((double)(histogram[right + 1]) > half)){
+        right++;
+    }
+    for (unsigned int k = left; k <= right; k++){
+        fom.peakArea += histogram[k];
+    }
+    /* fractional positions where the flanks cross half maximum */
+    double lo = (double)(left) - 0.5;
+    if (left > first){
+        const double a = (double)(histogram[left - 1]);
+        const double b = (double)(histogram[left]);
+        lo = (double)(left) - (b - half) / (b - a);
+    }
+    double hi = (double)(right) + 0.5;
+    if (right + 1 < last){
+        const double a = (double)(histogram[right]);
+        const double b = (double)(histogram[right + 1]);
+        hi = (double)(right) + (a - half) / (a - b);
+    }
+    fom.fwhm = hi - lo;
+    if (fom.peakBin > 0)
+        fom.resolution = 100.0 * fom.fwhm / (double)(fom.peakBin);
+    return fom;
+}
@@ -0,0 +1,118 @@
+/** \file sweeper.h
+ * \brief Many analyzer configurations on the blocks of one decode
+ *
+ * \author Copyright (C) 2014 samplemaker
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1
+ * of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free
+ * Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA
+ *
+ * @{
+ */
+
+#ifndef SWEEPER_H
+#define SWEEPER_H
+
+#include <QObject>
+#include <QString>
+#include <QStringList>
+#include <QVector>
+
+#include "analyzer.h"
+#include "blockqueue.h"
+
+/* upper limit of the number of configurations of one sweep */
+#define SWEEP_MAX_POINTS 1024
+
+
+/* figure of merit of one histogram, see Sweeper::figureOfMerit() */
+struct SweepFom
+{
+    unsigned int peakBin;   /* highest bin in the search range */
+    unsigned int peakCounts;
+    double fwhm;            /* in bins, linear interpolation at half maximum */
+    double resolution;      /* fwhm / peakBin in percent */
+    quint64 peakArea;       /* counts within the full width at half maximum */
+    quint64 counts;         /* counts in the search range */
+};
+
+
+/**
+ *  Runs many pulse settings over the blocks of a single decode: connect
+ *  audioDataReady to doBlock() (Qt::DirectConnection). The settings are the
+ *  cartesian product of a spec like "trig-thresh=0.01,0.015;ipln-factor=4:16:4",
+ *  each parameter a list of values or a range lo:hi:step. Parameters are
+ *  trig-thresh, num-past, min-glitch, max-glitch, ipln-factor, window-size
+ *  and peak-mode, the others are taken from the base settings.
+ *
+ *  Configurations with the same trigger threshold and glitch filter find the
+ *  very same pulses at the same baseline: the first one of such a group scans
+ *  the samples and hands every pulse to the others (Analyzer::addFollower),
+ *  which only compute the height. Each histogram is exactly the one of a run
+ *  with these settings alone. The scan of every group runs once per block.
+ *
+ *  The groups are spread over numThreads lanes. Each lane gets a copy of the
+ *  blocks through a BlockQueue and runs its groups on a consumer thread of
+ *  its own, the decoder does not wait for the analysis. With one lane the
+ *  groups run directly on the decoder thread. The histograms are the same
+ *  as in a direct run: the scan keeps the samples in front of every pulse
+ *  within the block (Analyzer::doHistogram).
+ **/
+class Sweeper : public QObject
+{
+    Q_OBJECT
+
+public:
+   explicit Sweeper(unsigned int numBinsHist, size_t extraSamples, size_t bufLen,
+                    const BaseLine &baseline, QObject *parent = 0);
+   ~Sweeper();
+   /* builds the configurations, false with a message in error if the spec
+    * is not understood */
+   bool setup(const QString &spec, const PulseEvent &base, int numThreads, QString *error);
+   int size();
+   int numGroups();
+   int numLanes();
+   Analyzer * analyzer(int n);
+   /* "name=value ..." of the swept parameters of configuration n */
+   QString label(int n);
+   /* around the decode: start the lanes, wait until they are done */
+   void start();
+   void finish();
+   /* peak search in the bins [first, last) */
+   static SweepFom figureOfMerit(const unsigned int *histogram, unsigned int first, unsigned int last);
+
+public slots:
+   void doBlock(const double *data, size_t len, float percent);
+
+private:
+   unsigned int mNumBins;
+   size_t mExtra;
+   size_t mBufLen;
+   BaseLine mBaseline;
+   /* filled once by setup(), the analyzers point into them */
+   QVector<PulseEvent> points;
+   QVector<BaseLine> baselines;
+   QStringList labels;
+   QVector<Analyzer *> analyzers;
+   QVector<Analyzer *> leaders;
+   int mNumGroups;
+   QVector<BlockQueue *> queues;
+   QVector<BlockConsumer *> consumers;
+   static bool setParameter(PulseEvent &p, const QString &name, const QString &value);
+   static bool expandValues(const QString &name, const QString &values, QStringList &list);
+   void clear();
+};
+
+
+#endif
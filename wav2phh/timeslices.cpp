@@ -0,0 +1,163 @@
+/** \file timeslices.cpp
+ * \brief Time sliced pulse height histograms of long recordings
+ *
+ * \author Copyright (C) 2014 samplemaker
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1
+ * of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free
+ * Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA
+ *
+ * @{
+ */
+
+#include <QDebug>
+#include <QFile>
+#include <QJsonArray>
+#include <QTextStream>
+#include "timeslices.h"
+
+
+TimeSlices::TimeSlices () {
+  reset(1, 1);
+}
+
+
+void TimeSlices::reset(unsigned int numBins, quint64 sliceLength){
+  bins = numBins;
+  length = (sliceLength > 0) ? sliceLength : 1;
+  sliceEnd = (qint64)(length);
+  current.fill(0, (int)(bins));
+  rowStart.clear();
+  rowStart.append(0);
+  entryBin.clear();
+  entryCount.clear();
+}
+
+
+/* the slice in progress goes into the sparse store and is cleared */
+void TimeSlices::closeSlice(){
+  unsigned int *slice = current.data();
+  for (unsigned int i = 0; i < bins; i++){
+    if (slice[i] != 0){
+      entryBin.append(i);
+      entryCount.append(slice[i]);
+      slice[i] = 0;
+    }
+  }
+  rowStart.append((quint32)(entryBin.size()));
+  sliceEnd += (qint64)(length);
+}
+
+
+/* slices without a pulse in between are closed empty */
+void TimeSlices::advance(qint64 trigPos){
+  while (trigPos >= sliceEnd){
+    closeSlice();
+  }
+}
+
+
+void TimeSlices::finish(quint64 numSamples){
+  closeSlice();
+  while (sliceEnd - (qint64)(length) < (qint64)(numSamples)){
+    closeSlice();
+  }
+}
+
+
+void TimeSlices::sum(size_t first, size_t num, unsigned int *histogram){
+  const size_t last = qMin(first + num, size());
+  for (size_t n = first; n < last; n++){
+    for (quint32 e = rowStart[(int)(n)]; e < rowStart[(int)(n) + 1]; e++){
+      histogram[entryBin[(int)(e)]] += entryCount[(int)(e)];
+    }
+  }
+}
+
+
+bool TimeSlices::save(const QString &fileName, double sampleRate){
+  QFile file(fileName);
+  if (!file.open(QIODevice::WriteOnly | QIODevice::Text)){
+    qWarning() << "cannot write time slices" << fileName;
+    return(false);
+  }
+  QTextStream outPut(&file);
+  outPut << "# " << size() << " slices of " << length << " samples, " << bins << " bins" << endl;
+  outPut << "# slice\tstart\tbin\tcount" << endl;
+  for (size_t n = 0; n < size(); n++){
+    const double start = (sampleRate > 0.0) ? (double)(n * length) / sampleRate : (double)(n * length);
+    for (quint32 e = rowStart[(int)(n)]; e < rowStart[(int)(n) + 1]; e++){
+      outPut << n << "\t" << start << "\t" << entryBin[(int)(e)] << "\t" << entryCount[(int)(e)] << endl;
+    }
+    outPut << endl;
+  }
+  outPut.flush();
+  return(file.error() == QFile::NoError);
+}
+
+
+QJsonObject TimeSlices::toJson() const{
+  QJsonArray rows;
+  QJsonArray bin;
+  QJsonArray num;
+  for (int n = 0; n < rowStart.size(); n++){
+    rows.append((double)(rowStart[n]));
+  }
+  for (int e = 0; e < entryBin.size(); e++){
+    bin.append((double)(entryBin[e]));
+    num.append((double)(entryCount[e]));
+  }
+  QJsonObject all;
+  all["bins"] = (double)(bins);
+  all["length"] = (double)(length);
+  all["rows"] = rows;
+  all["bin"] = bin;
+  all["count"] = num;
+  return(all);
+}
+
+
+bool TimeSlices::fromJson(const QJsonObject &json){
+  const QJsonArray rows = json.value("rows").toArray();
+  const QJsonArray bin = json.value("bin").toArray();
+  const QJsonArray num = json.value("count").toArray();
+  const unsigned int numBins = (unsigned int)(json.value("bins").toDouble());
+  const quint64 sliceLength = (quint64)(json.value("length").toDouble());
+  if ((numBins == 0) || (sliceLength == 0) || (rows.size() == 0) || (bin.size() != num.size()) ||
+      ((int)(rows.at(rows.size() - 1).toDouble()) != bin.size())){
+    return(false);
+  }
+  QVector<quint32> newRows(rows.size());
+  QVector<quint32> newBins(bin.size());
+  QVector<quint32> newCounts(num.size());
+  for (int n = 0; n < rows.size(); n++){
+    newRows[n] = (quint32)(rows.at(n).toDouble());
+    if ((n == 0) ? (newRows[n] != 0) : (newRows[n] < newRows[n - 1])){
+      return(false);
+    }
+  }
+  for (int e = 0; e < bin.size(); e++){
+    newBins[e] = (quint32)(bin.at(e).toDouble());
+    newCounts[e] = (quint32)(num.at(e).toDouble());
+    if (newBins[e] >= numBins){
+      return(false);
+    }
+  }
+  reset(numBins, sliceLength);
+  rowStart = newRows;
+  entryBin = newBins;
+  entryCount = newCounts;
+  sliceEnd = (qint64)(size() + 1) * (qint64)(length);
+  return(true);
+}
@@ -0,0 +1,101 @@
+/** \file timeslices.h
+ * \brief Time sliced pulse height histograms of long recordings
+ *
+ * \author Copyright (C) 2014 samplemaker
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1
+ * of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free
+ * Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA
+ *
+ * @{
+ */
+
+#ifndef TIMESLICES_H
+#define TIMESLICES_H
+
+#include <cstdlib>
+#include <QtGlobal>
+#include <QJsonObject>
+#include <QString>
+#include <QVector>
+
+/* default slice length in seconds (gui and cli) */
+#define TIMESLICES_SECONDS_DEFAULT 60
+
+
+/**
+ *  A histogram per slice of sliceLength samples: slice n holds the pulses
+ *  triggered in [n * sliceLength, (n + 1) * sliceLength).
+ *
+ *  Only the slice in progress is kept as a plain array, so counting a pulse
+ *  is one increment (plus a compare with the end of the slice). Once a pulse
+ *  of a later slice comes in the dense slice is squeezed into the sparse
+ *  store, which keeps (bin, count) of the non empty bins only, one row per
+ *  slice. Empty slices cost one row offset. Short slices, in which most
+ *  bins stay empty, take a fraction of the 4 bytes per bin of a dense
+ *  matrix.
+ *
+ *  Pulses have to come in the order of their trigger, as from one analyzer.
+ *  The analyzer thread fills the slices, everybody else reads them after
+ *  the run has finished.
+ **/
+class TimeSlices
+{
+
+  public:
+    /* constructor */
+    TimeSlices ();
+    /* drops all slices. sliceLength in samples, 0 is taken as 1 */
+    void reset(unsigned int numBins, quint64 sliceLength);
+    inline void count(qint64 trigPos, int bin){
+      if (trigPos >= sliceEnd){
+        advance(trigPos);
+      }
+      current[bin] ++;
+    }
+    /* closes the slice in progress and adds empty ones up to numSamples */
+    void finish(quint64 numSamples);
+    /* number of closed slices */
+    inline size_t size() { return (size_t)(rowStart.size() - 1); }
+    inline unsigned int numBins() { return bins; }
+    inline quint64 sliceLength() { return length; }
+    /* non empty (slice, bin) pairs in the sparse store */
+    inline size_t numEntries() { return (size_t)(entryBin.size()); }
+    /* adds the slices [first, first + num) to histogram[0 .. numBins()) */
+    void sum(size_t first, size_t num, unsigned int *histogram);
+    /* text file: slice, start of the slice in seconds (in samples if the
+     * sample rate is 0), bin and count of the non empty bins. the slices are
+     * separated by an empty line */
+    bool save(const QString &fileName, double sampleRate);
+    /* the closed slices, as kept by the result cache */
+    QJsonObject toJson() const;
+    /* the inverse of toJson(). false (and the slices unchanged) if json does
+     * not hold consistent slices */
+    bool fromJson(const QJsonObject &json);
+  private:
+    unsigned int bins;
+    quint64 length;
+    /* first sample after the slice in progress */
+    qint64 sliceEnd;
+    QVector<unsigned int> current;
+    /* entries of slice n: [rowStart[n], rowStart[n + 1]) */
+    QVector<quint32> rowStart;
+    QVector<quint32> entryBin;
+    QVector<quint32> entryCount;
+    void closeSlice();
+    void advance(qint64 trigPos);
+};
+
+
+#endif
@@ -0,0 +1,137 @@
+/** \file verifier.cpp
+ * \brief Runs the legacy and a fast analyzer engine side by side
+ *
+ * \author Copyright (C) 2014 samplemaker
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1
+ * of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free
+ * Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA
+ *
+ * @{
+ */
+
+#include <cmath>
+#include <QElapsedTimer>
+
+#include "verifier.h"
+
+/* initial capacity of the pulse lists (they are emptied after each block) */
+#define VERIFY_PULSES_PER_BLOCK 1024
+
+
+Verifier::Verifier(unsigned int numBinsHist, size_t extraSamples, size_t bufLen,
+                   const BaseLine &baseline, const PulseEvent &pulseEvent,
+                   int fastEngine, QObject *parent) : QObject(parent)
+{
+    /* private copies: each analyzer writes its baseline value back */
+    legacyBaseline = baseline;
+    fastBaseline = baseline;
+    mPulseEvent = pulseEvent;
+    legacy = new Analyzer(numBinsHist, extraSamples, bufLen, &legacyBaseline, &mPulseEvent);
+    fast = new Analyzer(numBinsHist, extraSamples, bufLen, &fastBaseline, &mPulseEvent);
+    legacy->setEngine(ENGINE_LEGACY);
+    fast->setEngine(fastEngine);
+    legacyPulses.reserve(VERIFY_PULSES_PER_BLOCK);
+    fastPulses.reserve(VERIFY_PULSES_PER_BLOCK);
+    legacy->setPulseSink(&legacyPulses);
+    fast->setPulseSink(&fastPulses);
+    numPulses = 0;
+    numMismatches = 0;
+    maxHeightDiff = 0.0;
+    legacyNsecs = 0;
+    fastNsecs = 0;
+}
+
+
+Verifier::~Verifier()
+{
+    delete legacy;
+    delete fast;
+}
+
+
+int Verifier::engineByName(const QString &name)
+{
+    if (name == "default")
+        return ENGINE_DEFAULT;
+    if (name == "polyphase")
+        return ENGINE_POLYPHASE;
+    if (name == "fixed")
+        return ENGINE_FIXED;
+    if (name == "lazy")
+        return ENGINE_LAZY;
+    return -1;
+}
+
+
+void Verifier::doBlock(const double *data, size_t len, float percent)
+{
+    QElapsedTimer timer;
+    timer.start();
+    legacy->doHistogram(data, len, percent);
+    legacyNsecs += timer.nsecsElapsed();
+    timer.restart();
+    fast->doHistogram(data, len, percent);
+    fastNsecs += timer.nsecsElapsed();
+    comparePulses();
+}
+
+
+void Verifier::addMismatch(qint64 trigPos, int legacyBin, int fastBin, double legacyHeight, double fastHeight)
+{
+    numMismatches ++;
+    if (mismatches.size() < VERIFY_MAX_LISTED){
+        const PulseMismatch mismatch = {trigPos, legacyBin, fastBin, legacyHeight, fastHeight};
+        mismatches.append(mismatch);
+    }
+}
+
+
+/* both lists are ordered by the trigger position */
+void Verifier::comparePulses()
+{
+    const int numBins = (int)(legacy->histResolution);
+    int i = 0;
+    int j = 0;
+    while ((i < legacyPulses.size()) || (j < fastPulses.size())){
+        if ((j >= fastPulses.size()) ||
+            ((i < legacyPulses.size()) && (legacyPulses[i].trigPos < fastPulses[j].trigPos))){
+            addMismatch(legacyPulses[i].trigPos, legacyPulses[i].bin, VERIFY_NO_PULSE, legacyPulses[i].height, 0.0);
+            numPulses ++;
+            i ++;
+        }
+        else if ((i >= legacyPulses.size()) || (fastPulses[j].trigPos < legacyPulses[i].trigPos)){
+            addMismatch(fastPulses[j].trigPos, VERIFY_NO_PULSE, fastPulses[j].bin, 0.0, fastPulses[j].height);
+            numPulses ++;
+            j ++;
+        }
+        else{
+            const PulseRecord &a = legacyPulses[i];
+            const PulseRecord &b = fastPulses[j];
+            const bool outside = (a.bin >= numBins) && (b.bin >= numBins);
+            if ((a.bin != b.bin) && !outside){
+                addMismatch(a.trigPos, a.bin, b.bin, a.height, b.height);
+            }
+            /* the lazy engine does not interpolate pulses out of range */
+            if (!outside){
+                maxHeightDiff = fmax(maxHeightDiff, fabs(a.height - b.height));
+            }
+            numPulses ++;
+            i ++;
+            j ++;
+        }
+    }
+    legacyPulses.clear();
+    fastPulses.clear();
+}
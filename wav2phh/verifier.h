@@ -0,0 +1,95 @@
+/** \file verifier.h
+ * \brief Runs the legacy and a fast analyzer engine side by side
+ *
+ * \author Copyright (C) 2014 samplemaker
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1
+ * of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free
+ * Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA
+ *
+ * @{
+ */
+
+#ifndef VERIFIER_H
+#define VERIFIER_H
+
+#include <QObject>
+#include <QString>
+#include <QVector>
+
+#include "analyzer.h"
+
+/* number of pulse disagreements kept for the report */
+#define VERIFY_MAX_LISTED 20
+/* bin of a pulse which one of the engines did not find */
+#define VERIFY_NO_PULSE -1
+
+
+struct PulseMismatch
+{
+    qint64 trigPos;
+    int legacyBin;
+    int fastBin;
+    double legacyHeight;
+    double fastHeight;
+};
+
+
+/**
+ *  Both engines are fed with the same blocks in one pass over the input:
+ *  connect audioDataReady to doBlock() (Qt::DirectConnection). Each engine is
+ *  a complete Analyzer with a baseline of its own, so the comparison includes
+ *  everything from the trigger down to the binning with its (float) cast.
+ *
+ *  The pulses of both engines are matched by their trigger position after
+ *  every block. A pulse disagrees if it lands in another bin (pulses outside
+ *  of the histogram in both engines agree) or if only one engine found it.
+ *  The time spent in each engine is measured separately.
+ **/
+class Verifier : public QObject
+{
+    Q_OBJECT
+
+public:
+   explicit Verifier(unsigned int numBinsHist, size_t extraSamples, size_t bufLen,
+                     const BaseLine &baseline, const PulseEvent &pulseEvent,
+                     int fastEngine, QObject *parent = 0);
+   ~Verifier();
+   /* "default", "polyphase", "fixed" or "lazy", -1 if unknown */
+   static int engineByName(const QString &name);
+   Analyzer * legacy;
+   Analyzer * fast;
+   /* results, valid after the input was processed */
+   quint64 numPulses;
+   quint64 numMismatches;
+   double maxHeightDiff;
+   QVector<PulseMismatch> mismatches;
+   qint64 legacyNsecs;
+   qint64 fastNsecs;
+
+public slots:
+   void doBlock(const double *data, size_t len, float percent);
+
+private:
+   BaseLine legacyBaseline;
+   BaseLine fastBaseline;
+   PulseEvent mPulseEvent;
+   QVector<PulseRecord> legacyPulses;
+   QVector<PulseRecord> fastPulses;
+   void addMismatch(qint64 trigPos, int legacyBin, int fastBin, double legacyHeight, double fastHeight);
+   void comparePulses();
+};
+
+
+#endif
@@ -0,0 +1,160 @@
+/** \file waterfallview.cpp
+ * \brief Waterfall view of the time sliced histograms
+ *
+ * \author Copyright (C) 2014 samplemaker
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1
+ * of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free
+ * Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA
+ *
+ * @{
+ */
+
+#include <cmath>
+#include <QPainter>
+#include <QMouseEvent>
+#include <QVector>
+
+#include "waterfallview.h"
+
+#define X_MARGIN 20
+#define Y_MARGIN 25
+
+
+/* 0 .. 1 to dark blue, red, yellow */
+static QRgb heatColor(double f)
+{
+    if (f <= 0.0){
+        return qRgb(0, 0, 64);
+    }
+    if (f < 0.5){
+        const double g = 2.0 * f;
+        return qRgb((int)(255 * g), 0, (int)(64 * (1.0 - g)));
+    }
+    const double g = qMin(2.0 * f - 1.0, 1.0);
+    return qRgb(255, (int)(255 * g), 0);
+}
+
+
+WaterfallView::WaterfallView(QWidget *parent) : QWidget(parent)
+{
+    setWindowFlags(Qt::Window);
+    setWindowTitle("Waterfall");
+    setMinimumSize(320, 240);
+    resize(640, 480);
+    mSlices = NULL;
+    sliceSecs = 0.0;
+    logScale = true;
+}
+
+
+void WaterfallView::setSlices(TimeSlices * slices, double secs)
+{
+    mSlices = slices;
+    sliceSecs = secs;
+    if (mSlices != NULL){
+        setWindowTitle(QString("Waterfall: %1 slices of %2")
+                       .arg(mSlices->size())
+                       .arg(secs > 0.0 ? QString("%1 s").arg(secs)
+                                       : QString("%1 samples").arg(mSlices->sliceLength())));
+    }
+    render();
+}
+
+
+void WaterfallView::render(void)
+{
+    frame = QImage(size(), QImage::Format_RGB32);
+    frame.fill(QColor(Qt::darkBlue));
+    const int plotWidth = width() - 2 * X_MARGIN;
+    const int plotHeight = height() - 2 * Y_MARGIN;
+    if ((mSlices == NULL) || (mSlices->size() == 0) || (plotWidth < 1) || (plotHeight < 1)){
+        update();
+        return;
+    }
+    const size_t numSlices = mSlices->size();
+    const unsigned int numBins = mSlices->numBins();
+    const int numRows = (int)(qMin(numSlices, (size_t)(plotHeight)));
+    const int numCols = (int)(qMin(numBins, (unsigned int)(plotWidth)));
+
+    /* a row holds the sum of its slices, a column the largest of its bins */
+    QVector<unsigned int> cells(numRows * numCols, 0);
+    QVector<unsigned int> bins(numBins);
+    unsigned int cellMax = 0;
+    for (int r = 0; r < numRows; r ++){
+        const size_t a = numSlices * r / numRows;
+        const size_t b = numSlices * (r + 1) / numRows;
+        bins.fill(0);
+        mSlices->sum(a, b - a, bins.data());
+        for (int c = 0; c < numCols; c ++){
+            const unsigned int first = (unsigned int)((quint64)(numBins) * c / numCols);
+            const unsigned int last = (unsigned int)((quint64)(numBins) * (c + 1) / numCols);
+            unsigned int v = 0;
+            for (unsigned int i = first; i < last; i ++){
+                v = qMax(v, bins[i]);
+            }
+            cells[r * numCols + c] = v;
+            cellMax = qMax(cellMax, v);
+        }
+    }
+
+    const double scale = logScale ? log10(1.0 + cellMax) : (double)(cellMax);
+    QImage plot(numCols, numRows, QImage::Format_RGB32);
+    for (int r = 0; r < numRows; r ++){
+        QRgb * line = (QRgb *)(plot.scanLine(r));
+        for (int c = 0; c < numCols; c ++){
+            const unsigned int v = cells[r * numCols + c];
+            const double f = logScale ? log10(1.0 + v) : (double)(v);
+            line[c] = heatColor(scale > 0.0 ? f / scale : 0.0);
+        }
+    }
+
+    QPainter paintToMap(&frame);
+    paintToMap.drawImage(QRect(X_MARGIN, Y_MARGIN, plotWidth, plotHeight), plot);
+    paintToMap.setPen(QPen(Qt::white));
+    /* bins along the top, time along the left edge */
+    paintToMap.drawText(X_MARGIN, Y_MARGIN - 8, "0");
+    paintToMap.drawText(width() - X_MARGIN - 40, Y_MARGIN - 8, QString::number(numBins));
+    const double total = (double)(numSlices) * (sliceSecs > 0.0 ? sliceSecs : (double)(mSlices->sliceLength()));
+    paintToMap.drawText(X_MARGIN, height() - 8,
+                        QString("%1 %2").arg(total).arg(sliceSecs > 0.0 ? "s" : "samples"));
+    if (logScale){
+        paintToMap.drawText(width() / 2, Y_MARGIN - 8, "log");
+    }
+    update();
+}
+
+
+void WaterfallView::paintEvent(QPaintEvent *event)
+{
+    Q_UNUSED(event);
+    QPainter painter(this);
+    painter.drawImage(QPoint(0,0), frame);
+}
+
+
+void WaterfallView::resizeEvent(QResizeEvent *event)
+{
+    Q_UNUSED(event);
+    render();
+}
+
+
+void WaterfallView::mousePressEvent(QMouseEvent *event)
+{
+    if (event->button() == Qt::RightButton){
+        logScale = !logScale;
+        render();
+    }
+}
@@ -0,0 +1,63 @@
+/** \file waterfallview.h
+ * \brief Waterfall view of the time sliced histograms
+ *
+ * \author Copyright (C) 2014 samplemaker
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1
+ * of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free
+ * Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA
+ *
+ * @{
+ */
+
+#ifndef WATERFALLVIEW_H
+#define WATERFALLVIEW_H
+
+#include <QWidget>
+#include <QImage>
+
+#include "timeslices.h"
+
+
+/**
+ *  One row per time slice, time running downwards, the bins from left to
+ *  right and the counts as colors from dark blue over red to yellow. If
+ *  there are more slices or bins than pixels a pixel shows the sum of its
+ *  slices and the largest of its bins, as the histogram view does.
+ *  Right click toggles the logarithmic color scale.
+ **/
+class WaterfallView : public QWidget
+{
+    Q_OBJECT
+
+    public:
+        WaterfallView(QWidget *parent);
+        /* the slices have to stay untouched while they are shown. secs is the
+         * length of a slice in seconds (0: unknown) */
+        void setSlices(TimeSlices * slices, double secs);
+
+    protected:
+        virtual void paintEvent (QPaintEvent *event);
+        virtual void resizeEvent (QResizeEvent *event);
+        virtual void mousePressEvent (QMouseEvent *event);
+
+    private:
+        TimeSlices * mSlices;
+        double sliceSecs;
+        bool logScale;
+        QImage frame;
+        void render(void);
+};
+
+#endif // WATERFALLVIEW_H
@@ -0,0 +1,52 @@
+######################################################################
+# Microbenchmarks of the processing stages (console, no gui)
+######################################################################
+
+TEMPLATE = app
+TARGET = wav2phh-bench
+INCLUDEPATH += .
+CONFIG += console release
+CONFIG -= app_bundle
+# constexpr tables of the preset interpolation kernels (interpolate.cpp)
+CONFIG += c++14
+
+QT -= gui
+QT += multimedia
+
+# keep the objects apart from the gui build in the same directory
+OBJECTS_DIR = .obj-bench
+MOC_DIR = .obj-bench
+
+# Input
+HEADERS += analyzer.h \
+           audioinput.h \
+           baselineestimator.h \
+           blockqueue.h \
+           contenthash.h \
+           eventlist.h \
+           histsnapshot.h \
+           interpolate.h \
+           latencystats.h \
+           pcmconvert.h \
+           pipelinestats.h \
+           pulsegen.h \
+           ringbuffer.h \
+           sidecar.h \
+           sweeper.h \
+           timeslices.h
+SOURCES += analyzer.cpp \
+           audioinput.cpp \
+           baselineestimator.cpp \
+           bench.cpp \
+           blockqueue.cpp \
+           eventlist.cpp \
+           histsnapshot.cpp \
+           interpolate.cpp \
+           latencystats.cpp \
+           pcmconvert.cpp \
+           pipelinestats.cpp \
+           pulsegen.cpp \
+           ringbuffer.cpp \
+           sidecar.cpp \
+           sweeper.cpp \
+           timeslices.cpp
@@ -0,0 +1,63 @@
+######################################################################
+# Headless batch converter: no QtWidgets, no event loop
+######################################################################
+
+TEMPLATE = app
+TARGET = wav2phh-cli
+INCLUDEPATH += .
+CONFIG += console
+CONFIG -= app_bundle
+# constexpr tables of the preset interpolation kernels (interpolate.cpp)
+CONFIG += c++14
+
+QT -= gui
+QT += multimedia
+
+# keep the objects apart from the gui build in the same directory
+OBJECTS_DIR = .obj-cli
+MOC_DIR = .obj-cli
+
+# Input
+HEADERS += alloccount.h \
+           analyzer.h \
+           audioinput.h \
+           baselineestimator.h \
+           blockqueue.h \
+           contenthash.h \
+           eventlist.h \
+           histsnapshot.h \
+           interpolate.h \
+           latencystats.h \
+           pcmconvert.h \
+           pipelinestats.h \
+           resultcache.h \
+           ringbuffer.h \
+           segmentrunner.h \
+           sidecar.h \
+           sweeper.h \
+           timeslices.h \
+           verifier.h
+SOURCES += alloccount.cpp \
+           analyzer.cpp \
+           audioinput.cpp \
+           baselineestimator.cpp \
+           blockqueue.cpp \
+           cli.cpp \
+           eventlist.cpp \
+           histsnapshot.cpp \
+           interpolate.cpp \
+           latencystats.cpp \
+           pcmconvert.cpp \
+           pipelinestats.cpp \
+           resultcache.cpp \
+           ringbuffer.cpp \
+           segmentrunner.cpp \
+           sidecar.cpp \
+           sweeper.cpp \
+           timeslices.cpp \
+           verifier.cpp
+
+# qmake CONFIG+=alloccount: count the heap allocations (see alloccount.h)
+alloccount {
+    DEFINES += WAV2PHH_COUNT_ALLOCS
+}
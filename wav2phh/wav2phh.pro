@@ -5,6 +5,8 @@
 TEMPLATE = app
 TARGET = wav2phh
 INCLUDEPATH += .
+# constexpr tables of the preset interpolation kernels (interpolate.cpp)
+CONFIG += c++14
 
 QT += widgets
 QT += multimedia
@@ -13,16 +15,43 @@ QT += multimedia
 HEADERS += analyzer.h \
            analyzersettings.h \
            audioinput.h \
+           baselineestimator.h \
+           blockqueue.h \
+           contenthash.h \
+           eventlist.h \
+           histrenderer.h \
+           histsnapshot.h \
            interpolate.h \
+           latencystats.h \
            mainwindow.h \
+           pcmconvert.h \
+           pipelinestats.h \
            qdrawboxwidget.h \
-           qledindicator.h
+           qledindicator.h \
+           resultcache.h \
+           ringbuffer.h \
+           sidecar.h \
+           timeslices.h \
+           waterfallview.h
 FORMS += analyzersettings.ui mainwindow.ui
 SOURCES += analyzer.cpp \
            analyzersettings.cpp \
            audioinput.cpp \
+           baselineestimator.cpp \
+           blockqueue.cpp \
+           eventlist.cpp \
+           histrenderer.cpp \
+           histsnapshot.cpp \
            interpolate.cpp \
+           latencystats.cpp \
            main.cpp \
            mainwindow.cpp \
+           pcmconvert.cpp \
+           pipelinestats.cpp \
            qdrawboxwidget.cpp \
-           qledindicator.cpp
+           qledindicator.cpp \
+           resultcache.cpp \
+           ringbuffer.cpp \
+           sidecar.cpp \
+           timeslices.cpp \
+           waterfallview.cpp